@@ -0,0 +1,99 @@
+/**
+ * codecBench - Encoding and Decoding Costs of Large Requests
+ * ------------------------------------------------------------
+ *
+ * Measures the time the broker spends turning large requests into Modbus frames, the path every
+ * client request takes before reaching the device queue, and turning the device's answers back into
+ * the client's response.
+ *
+ * Cases:
+ * - **Coil List Write**: 2000 coils written through a shuffled list.
+ * - **Register List Write**: 1000 registers written through a shuffled list.
+ * - **Register Range Read**: 10000 registers read through a range.
+ * - **List Read Responses**: 10000 registers, and 10000 coils, read through shuffled lists, decoded
+ *   from the answers of a simulated device.
+ *
+ * Before the decoding cases, a read answered with a response one register short must fail as a whole.
+ *
+ * Usage:
+ *   npm run bench
+ */
+
+require('module-alias/register');
+const assert                        = require('assert')
+const ModbusPacketConstructor       = require('@parser/modbusRequestEncoder')
+const ModbusPacketBufferizer        = require('@parser/modbusPacketBufferizer')
+const ClientRequest                 = require('@core/clientRequest.js')
+const measure                       = require('./measure')
+
+/**
+ * Lists addresses from `start` on, in a shuffled order.
+ * @param {number} start - First address.
+ * @param {number} length - Number of addresses.
+ * @returns {Array} - Shuffled addresses.
+ */
+function shuffledAddresses(start, length) {
+    const addresses = Array.from({ length }, (_, i) => start + i);
+    for (let i = addresses.length - 1; i > 0; i--) {
+        const j = Math.floor(Math.random() * (i + 1));
+        [addresses[i], addresses[j]] = [addresses[j], addresses[i]];
+    }
+    return addresses;
+}
+
+/**
+ * Encodes and buffers a request, as `ClientRequest` does.
+ * @param {Object} request - Unified request.
+ */
+function encode(request) {
+    ModbusPacketBufferizer.toBuffers(ModbusPacketConstructor.parse(request), request);
+}
+
+/**
+ * Answers every frame of a read as a device would, each point holding its address.
+ * @param {ClientRequest} request - Read request.
+ */
+function answer(request) {
+    request.bufferResponses = request.parsedRequests.map(([id, mbFunction, start, count]) => {
+        const isBit = mbFunction === 0x01 || mbFunction === 0x02;
+        const data = Buffer.alloc(isBit ? Math.ceil(count / 8) : 2 * count);
+        for (let i = 0; i < count; i++) {
+            if (isBit) {
+                data[i >> 3] |= ((start + i) & 1) << (i & 7);
+            }
+            else {
+                data.writeUInt16BE((start + i) & 0xFFFF, 2 * i);
+            }
+        }
+        return Buffer.concat([Buffer.from([id, mbFunction, data.length]), data]);
+    });
+}
+
+const coilWrite = { id: 1, fn: 'w', dt: 'bo', ls: shuffledAddresses(0, 2000) };
+coilWrite.dv = coilWrite.ls.map((address) => address & 1);
+
+const registerWrite = { id: 1, fn: 'w', dt: 'no', ls: shuffledAddresses(100, 1000) };
+registerWrite.dv = registerWrite.ls.map((address) => address * 3 & 0xFFFF);
+
+const registerRead = { id: 1, fn: 'r', dt: 'ni', rg: [0, 9999] };
+
+console.log('Encoding');
+measure('2000-coil list write', () => encode(coilWrite));
+measure('1000-register list write', () => encode(registerWrite));
+measure('10000-register range read', () => encode(registerRead));
+
+const registerListRead = new ClientRequest({ id: 1, fn: 'r', dt: 'no', ls: shuffledAddresses(0, 10000) }, 'terse', 'bench', 'bench');
+const coilListRead = new ClientRequest({ id: 1, fn: 'r', dt: 'bo', ls: shuffledAddresses(0, 10000) }, 'terse', 'bench', 'bench');
+answer(registerListRead);
+answer(coilListRead);
+
+// A response one register short must fail the request, not answer it with missing values
+const shortRead = new ClientRequest({ id: 1, fn: 'r', dt: 'no', rg: [0, 3] }, 'terse', 'bench', 'bench');
+shortRead.bufferResponses = [Buffer.from([0x01, 0x03, 0x08, 0x00, 0x05])];
+shortRead.processClientResponse(false);
+assert.strictEqual(shortRead.succeeded, false);
+assert.strictEqual(shortRead.fetchedData, null);
+
+console.log('Decoding');
+measure('10000-register list read response', () => registerListRead.processClientResponse(false));
+measure('10000-coil list read response', () => coilListRead.processClientResponse(false));
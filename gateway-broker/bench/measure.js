@@ -0,0 +1,38 @@
+/**
+ * measure - Timing Loop Shared by the Benchmarks
+ * -----------------------------------------------
+ *
+ * Runs a case until it has taken about a second, after a warm up of up to 200 runs or 200 ms, and
+ * prints its mean cost per run.
+ *
+ * Example:
+ * ----------------
+ * const measure = require('./measure');
+ * measure('valid terse read', () => validator.validate(terseRead));
+ */
+
+/**
+ * Runs a case until it has taken about a second, after a warm up, and prints its mean cost.
+ * @param {string} name - Case name.
+ * @param {Function} run - The measured operation.
+ */
+function measure(name, run) {
+    const warmUp = process.hrtime.bigint();
+    for (let i = 0; i < 200 && process.hrtime.bigint() - warmUp < 200_000_000n; i++) {
+        run();
+    }
+
+    let iterations = 0;
+    const start = process.hrtime.bigint();
+    let elapsed_ns = 0n;
+    while (elapsed_ns < 1_000_000_000n) {
+        run();
+        iterations++;
+        elapsed_ns = process.hrtime.bigint() - start;
+    }
+
+    const mean_us = Number(elapsed_ns) / iterations / 1000;
+    console.log(`${name.padEnd(40)} ${mean_us.toFixed(2).padStart(10)} us/op  (${iterations} runs)`);
+}
+
+module.exports = measure;
@@ -0,0 +1,121 @@
+/**
+ * sessionBench - Session Registry Costs with Large Fleets
+ * ---------------------------------------------------------
+ *
+ * Measures the time the broker spends on the session bookkeeping of every login, subscription and
+ * disconnection, with a small fleet and with 10000 simulated sessions, half users and half devices.
+ * Costs should not grow with the number of sessions.
+ *
+ * Cases:
+ * - **Login and Logout**: A device logging in, subscribing to its topics, and leaving.
+ * - **Subscription Check**: The lookups authorizing a user's subscription to a device's responses.
+ * - **Former Subscription Check**: The same check as the broker made it before the registry, listing
+ *   every logged in identifier through `getIds` and searching the list, as a baseline.
+ * - **Device Address Lookup**: Finding the client of a device, as for its remote address.
+ *
+ * Before the cases, a client id logging in again under another identifier must leave nothing of its
+ * previous session behind.
+ *
+ * Usage:
+ *   npm run bench
+ */
+
+require('module-alias/register');
+const assert = require('assert');
+const SessionRegistry = require('@core/sessionRegistry.js');
+const measure = require('./measure');
+
+/**
+ * Fills a registry with users and devices, each user subscribed to the responses of one device.
+ * @param {number} count - Number of sessions.
+ * @returns {SessionRegistry} - The registry.
+ */
+function fleet(count) {
+    const sessions = new SessionRegistry();
+    const devices = count / 2;
+
+    for (let i = 0; i < devices; i++) {
+        sessions.login(`device-client-${i}`, `plc-${i}@acme`, undefined, true);
+        sessions.subscribe(`device-client-${i}`, `plc-${i}@acme`, `+/plc-${i}@acme/request`);
+    }
+    for (let i = 0; i < count - devices; i++) {
+        sessions.login(`user-client-${i}`, `user-${i}.acme`, [`plc-${i}@acme`], false);
+        sessions.subscribe(`user-client-${i}`, `plc-${i}@acme`, `user-${i}.acme/plc-${i}@acme/response`);
+    }
+
+    return sessions;
+}
+
+/**
+ * Fills the session objects the broker kept before the registry, client id to identifier and devices.
+ * @param {number} count - Number of sessions.
+ * @returns {Object} - Logged in users and devices.
+ */
+function formerFleet(count) {
+    const loggedInUsers = {};
+    const loggedInDevices = {};
+    const devices = count / 2;
+
+    for (let i = 0; i < devices; i++) {
+        loggedInDevices[`device-client-${i}`] = [`plc-${i}@acme`];
+    }
+    for (let i = 0; i < count - devices; i++) {
+        loggedInUsers[`user-client-${i}`] = [`user-${i}.acme`, [`plc-${i}@acme`]];
+    }
+
+    return { loggedInUsers, loggedInDevices };
+}
+
+/**
+ * Lists the identifiers of logged in sessions, as the broker did on every check before the registry.
+ * @param {Object} loggedObject - Logged in users or devices.
+ * @returns {string[]} - Their identifiers.
+ */
+function getIds(loggedObject) {
+    return Object.keys(loggedObject).map(key => loggedObject[key][0]);
+}
+
+// A client id logging in again replaces its session, the former identifier and subscriptions are gone
+const relogin = new SessionRegistry();
+relogin.login('client-1', 'plc-1@acme', undefined, true);
+relogin.subscribe('client-1', 'plc-1@acme', '+/plc-1@acme/request');
+const previous = relogin.login('client-1', 'plc-2@acme', undefined, true);
+assert.strictEqual(previous.identifier, 'plc-1@acme');
+assert.strictEqual(previous.lastOfIdentifier, true);
+assert.strictEqual(relogin.isDevice('plc-1@acme'), false);
+assert.strictEqual(relogin.clientOfDevice('plc-2@acme'), 'client-1');
+assert.deepStrictEqual(relogin.subscribersOf('plc-1@acme'), []);
+assert.strictEqual(relogin.size, 1);
+relogin.logout('client-1');
+assert.strictEqual(relogin.isDevice('plc-2@acme'), false);
+
+for (const count of [100, 10000]) {
+    const sessions = fleet(count);
+    const former = formerFleet(count);
+    const last = count / 2 - 1;
+    let i = 0;
+    let client = 0;
+
+    console.log(`${count} Sessions`);
+    measure('login and logout', () => {
+        // A different device each time, as when a fleet reconnects
+        const clientId = `bench-client-${client}`;
+        const device = `bench-plc-${client++}@acme`;
+        sessions.login(clientId, device, undefined, true);
+        sessions.subscribe(clientId, device, `+/${device}/request`);
+        sessions.subscribe(clientId, device, `gateway/${device}/mbnet`);
+        sessions.logout(clientId);
+    });
+    measure('subscription check', () => {
+        i = i === last ? 0 : i + 1;
+        sessions.isUser(`user-${i}.acme`) && sessions.isDevice(`plc-${i}@acme`);
+    });
+    measure('former subscription check', () => {
+        i = i === last ? 0 : i + 1;
+        getIds(former.loggedInUsers).includes(`user-${i}.acme`) && getIds(former.loggedInDevices).includes(`plc-${i}@acme`);
+    });
+    measure('device address lookup', () => {
+        i = i === last ? 0 : i + 1;
+        sessions.clientOfDevice(`plc-${i}@acme`);
+    });
+}
@@ -0,0 +1,41 @@
+/**
+ * validatorBench - Request Validation Costs
+ * -------------------------------------------
+ *
+ * Measures the time the broker spends validating client requests, the first step of every message
+ * it receives, and loading its validators at start up.
+ *
+ * Cases:
+ * - **Start Up**: Generating the validators of both formats, as the broker does when it starts.
+ * - **Valid Terse Read**: A read through a range.
+ * - **Valid Verbose Write**: 100 registers written through a list.
+ * - **Invalid Request**: A read through both a range and a list.
+ *
+ * Usage:
+ *   npm run bench
+ */
+
+require('module-alias/register');
+const schemaTemplate        = require('@schemas/requestSchema');
+const { Validator }         = require('@validator/requestValidator');
+const measure               = require('./measure');
+
+console.log('Start Up');
+measure('validator generation', () => new Validator(schemaTemplate));
+
+const validator = new Validator(schemaTemplate);
+
+const terseRead = { id: 1, fn: 'r', dt: 'ni', rg: [0, 9] };
+const verboseWrite = {
+    identifier: 1,
+    function: 'write',
+    datatype: 'numeric-output',
+    list: Array.from({ length: 100 }, (_, i) => 2 * i),
+    values: Array.from({ length: 100 }, (_, i) => i),
+};
+const invalidRead = { id: 1, fn: 'r', dt: 'ni', rg: [0, 9], ls: [1, 2] };
+
+console.log('Validation');
+measure('valid terse read', () => validator.validate(terseRead));
+measure('valid verbose 100-register write', () => validator.validate(verboseWrite));
+measure('invalid read', () => validator.validate(invalidRead));
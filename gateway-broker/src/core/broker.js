@@ -16,15 +16,23 @@
  * Core Functionalities:
  * - **Authentication and Authorization**: Uses `DbAccess` to authenticate and authorize connections.
  * - **Session Timeout Management**: Logs out clients exceeding session timeout, ensuring only active
- *   clients are maintained.
+ *   clients are maintained. Deadlines are kept in an `InactivityWheel`, so each check only visits the
+ *   clients that expired.
  * - **Client Disconnection Management**: Handles client disconnects, including clean unsubscription
  *   and session data cleanup.
+ * - **Session Registry**: Sessions are kept in a `SessionRegistry`, indexed by client id and by
+ *   identifier, along with the subscribers of each device, so authorization checks are map lookups.
  * - **Graceful Shutdown**: Ensures no lingering sessions or unclosed connections upon broker shutdown.
+ * - **TLS Transport**: Optionally listens over TLS, with session resumption through tickets and a
+ *   session ID cache so that reconnecting devices skip the full handshake.
  *
  * Key Dependencies:
  * - `aedes`: MQTT broker framework for handling MQTT protocol operations.
  * - `bcrypt`: Provides password hashing for secure client authentication.
+ * - `tls`: Node's TLS server, used when TLS options are given.
  * - `@database/dataBaseAccess`: Manages MongoDB-based authentication for users and devices.
+ * - `@core/sessionRegistry`: Holds the logged in users and devices, and the subscribers of each device.
+ * - `@core/inactivityWheel`: Tracks the inactivity deadline of each logged in client.
  *
  * Example Usage:
  * ----------------
@@ -39,7 +47,13 @@
 require('module-alias/register');
 const Aedes = require('aedes');
 const net = require('net');
+const tls = require('tls');
+const fs = require('fs');
+const crypto = require('crypto');
 const DbAccess = require('@database/dataBaseAccess');
+const SessionRegistry = require('@core/sessionRegistry.js');
+const InactivityWheel = require('@core/inactivityWheel.js');
+const { mbnet } = require('@core/mbnet.js');
 
 class MQTTBroker {
 
@@ -49,10 +63,11 @@ class MQTTBroker {
      * @param {string} dbUri - URI for connecting to the MongoDB database.
      * @param {number} [defaultPort=1883] - Port for the MQTT broker.
      * @param {number} [sessionTimeOut_min=5] - Session timeout in minutes.
+     * @param {Object} [tlsOptions=null] - TLS listener options, see `createTlsServer`. Plain TCP if omitted.
      */
-    constructor(dbUri, defaultPort = 1883, sessionTimeOut_min = 5) {
+    constructor(dbUri, defaultPort = 1883, sessionTimeOut_min = 5, tlsOptions = null) {
         this.aedes = Aedes();  // Create an instance of Aedes
-        this.server = net.createServer(this.aedes.handle);
+        this.server = tlsOptions ? this.createTlsServer(tlsOptions) : net.createServer(this.aedes.handle);
         this.port = defaultPort;
 
         this.dbAccess = new DbAccess(dbUri);
@@ -68,12 +83,82 @@ class MQTTBroker {
         this.aedes.on('clientError', this.onClientError.bind(this));
 
         // Store sessions
-        this.loggedInUsers = {};
-        this.loggedInDevices = {};
-        this.lastActivity = {};
+        this.sessions = new SessionRegistry();
+        this.deviceSessionCallback = null;
+        this.userSessionCallback = null;
 
         // Start periodic timeout check
-        this.startTimeoutCheck(sessionTimeOut_min * 60000, 60000); // Refreshes every 60s
+        this.startTimeoutCheck(sessionTimeOut_min * 60000, 1000); // Refreshes every second
+    }
+
+    /**
+     * Creates a TLS listener whose sessions can be resumed with an abbreviated handshake.
+     * Tickets are encrypted with `ticketKeys`, which should be shared across broker restarts so
+     * tickets issued before a restart stay valid. Clients resuming by session ID are served from
+     * a bounded in-memory cache.
+     * @param {Object} options - TLS options.
+     * @param {Buffer} options.key - Private key in PEM format.
+     * @param {Buffer} options.cert - Certificate chain in PEM format.
+     * @param {Buffer} [options.ca] - CA certificates in PEM format.
+     * @param {Buffer} [options.ticketKeys] - 48 bytes of session ticket keys, see `loadTicketKeys`.
+     * @param {number} [options.sessionTimeout_s=86400] - Lifetime of a resumable session in seconds.
+     * @param {number} [options.sessionCacheSize=1024] - Sessions kept for session ID resumption.
+     * @returns {tls.Server} The TLS server handing connections to Aedes.
+     */
+    createTlsServer(options) {
+        const server = tls.createServer({
+            key: options.key,
+            cert: options.cert,
+            ca: options.ca,
+            ticketKeys: options.ticketKeys,
+            sessionTimeout: options.sessionTimeout_s ?? 86400,
+        }, this.aedes.handle);
+
+        // Session ID cache, evicting the oldest session first
+        const sessions = new Map();
+        const sessionCacheSize = options.sessionCacheSize ?? 1024;
+
+        server.on('newSession', (id, data, done) => {
+            sessions.set(id.toString('hex'), data);
+            if (sessions.size > sessionCacheSize) {
+                sessions.delete(sessions.keys().next().value);
+            }
+            done();
+        });
+
+        server.on('resumeSession', (id, done) => {
+            done(null, sessions.get(id.toString('hex')) ?? null);
+        });
+
+        server.on('secureConnection', (socket) => {
+            const handshake = socket.isSessionReused() ? 'resumed' : 'full handshake';
+            console.log('\x1b[32m%s\x1b[0m', '[TLS Connection]', `${socket.remoteAddress} - ${handshake}`);
+        });
+
+        server.on('tlsClientError', (err, socket) => {
+            console.log('\x1b[31m%s\x1b[0m', '[TLS Error]', `${socket.remoteAddress} - ${err.message}`);
+        });
+
+        return server;
+    }
+
+    /**
+     * Loads the session ticket keys from a file, creating it with random keys if missing.
+     * @param {string} path - File holding the 48 bytes of ticket keys.
+     * @returns {Buffer} The ticket keys.
+     */
+    static loadTicketKeys(path) {
+        if (fs.existsSync(path)) {
+            const keys = fs.readFileSync(path);
+            if (keys.length !== 48) {
+                throw new Error(`Ticket keys file must hold 48 bytes: ${path}`);
+            }
+            return keys;
+        }
+
+        const keys = crypto.randomBytes(48);
+        fs.writeFileSync(path, keys, { mode: 0o600 });
+        return keys;
     }
 
     /**
@@ -101,32 +186,30 @@ class MQTTBroker {
     }
 
     /**
-     * Periodically checks session activity and logs out clients that have
-     * exceeded the session timeout threshold.
+     * Periodically logs out clients that have exceeded the session timeout threshold.
+     * Only the clients whose deadline has passed are visited.
      * @param {number} sessionTimeOut_ms - Session timeout in milliseconds.
-     * @param {number} refreshPeriod_ms - Period in milliseconds between timeout checks.
+     * @param {number} refreshPeriod_ms - Period in milliseconds between timeout checks, and their precision.
      */
     startTimeoutCheck(sessionTimeOut_ms, refreshPeriod_ms) {
+        this.inactivity = new InactivityWheel(sessionTimeOut_ms, refreshPeriod_ms);
+
         setInterval(() => {
-            const now = Date.now();
-
-            const compoundLoggedList = { ...this.loggedInUsers, ...this.loggedInDevices }
-            for (const clientId in compoundLoggedList) {
-                const lastActive = this.lastActivity[clientId] || 0;
-                if (now - lastActive > sessionTimeOut_ms) {
-                    console.log('\x1b[33m%s\x1b[0m', '[Inactivity Time Out]', `${compoundLoggedList[clientId][0]}`);
-                    this.logout(clientId);
-                }
+            for (const clientId of this.inactivity.expire()) {
+                console.log('\x1b[33m%s\x1b[0m', '[Inactivity Time Out]', `${this.sessions.get(clientId)?.identifier}`);
+                this.logout(clientId);
             }
         }, refreshPeriod_ms);
     }
 
     /**
-     * Updates the last activity timestamp for a specified client.
+     * Postpones the inactivity deadline of a logged in client.
      * @param {string} clientId - The ID of the client whose activity is being updated.
      */
     updateLastActivity(clientId) {
-        this.lastActivity[clientId] = Date.now();
+        if (this.sessions.get(clientId)) {
+            this.inactivity.touch(clientId);
+        }
     }
 
     /**
@@ -140,14 +223,15 @@ class MQTTBroker {
 
         console.log('\x1b[34m%s\x1b[0m', '[Authentication Attempt]', `${identifier}`);
 
-        const [authenticator, loggedInList] = identifier.includes(".")
-            ? [this.dbAccess.authenticateUser.bind(this.dbAccess), this.loggedInUsers]
-            : [this.dbAccess.authenticateDevice.bind(this.dbAccess), this.loggedInDevices];
+        const isDevice = !identifier.includes(".");
+        const authenticator = isDevice
+            ? this.dbAccess.authenticateDevice.bind(this.dbAccess)
+            : this.dbAccess.authenticateUser.bind(this.dbAccess);
 
         let result;
 
         try {
-            if (this.getIds(loggedInList).includes(identifier)) {
+            if (isDevice ? this.sessions.isDevice(identifier) : this.sessions.isUser(identifier)) {
                 throw new Error(`"${identifier}" already logged in`);
             }
 
@@ -163,9 +247,52 @@ class MQTTBroker {
         }
 
         console.log('\x1b[32m%s\x1b[0m', '[Authentication Successful]', `"${client.id}" as "${identifier}"`);
-        loggedInList[client.id] = [result.identifier, result.devices];
+        const previous = this.sessions.login(client.id, result.identifier, result.devices, isDevice);
         this.updateLastActivity(client.id);
         callback(null, true);
+
+        // A client logging in again under another identifier ends the session of the former one
+        const previousCallback = previous?.isDevice ? this.deviceSessionCallback : this.userSessionCallback;
+        if (previous?.lastOfIdentifier && previous.identifier !== result.identifier && previousCallback) {
+            previousCallback(previous.identifier, false);
+        }
+
+        const sessionCallback = isDevice ? this.deviceSessionCallback : this.userSessionCallback;
+        if (sessionCallback) {
+            sessionCallback(result.identifier, true);
+        }
+    }
+
+    /**
+     * Registers a callback for device sessions starting and ending.
+     * @param {Function} callback - Called with the device name and true on login, false on logout.
+     */
+    onDeviceSession(callback) {
+        this.deviceSessionCallback = callback;
+    }
+
+    /**
+     * Registers a callback for user sessions starting and ending.
+     * @param {Function} callback - Called with the user identifier and true on login, false on logout.
+     */
+    onUserSession(callback) {
+        this.userSessionCallback = callback;
+    }
+
+    /**
+     * Forgets a logged in client and its inactivity deadline, notifying the session callbacks of a
+     * device's or user's session ending.
+     * @param {string} clientId - The ID of the client.
+     */
+    endSession(clientId) {
+        const session = this.sessions.logout(clientId);
+        this.inactivity.remove(clientId);
+
+        // A device reconnecting before its previous connection was closed keeps its session
+        const sessionCallback = session?.isDevice ? this.deviceSessionCallback : this.userSessionCallback;
+        if (session?.lastOfIdentifier && sessionCallback) {
+            sessionCallback(session.identifier, false);
+        }
     }
 
     /**
@@ -180,17 +307,47 @@ class MQTTBroker {
 
         try {
             let [identifier, device, operator] = sub.topic.split("/");
+            const session = this.sessions.get(client.id);
 
-            if (['mbnet'].includes(operator)) {
-                if (!this.getIds(this.loggedInDevices).includes(device)) {
+            if (operator === 'mbnet') {
+                if (!this.sessions.isDevice(device)) {
+                    throw new Error(`Unavailable Device: ${device}`)
+                }
+            }
+            else if (operator === 'control') {
+                // Trace dumps, counters, bus scans and session tokens are for the device and the broker only
+                if (!this.ownsControlTopic(session, device)) {
+                    throw new Error(`Not the Device: ${device}`);
+                }
+            }
+            else if (operator === 'diagnostics') {
+                if (!this.mayDiagnose(session, identifier, device)) {
+                    throw new Error(`Device Not Allowed: ${device}`);
+                }
+                else if (!this.sessions.isDevice(device)) {
                     throw new Error(`Unavailable Device: ${device}`)
                 }
             }
-            else if (["request", "response"].includes(operator)) {
-                if (!this.getIds(this.loggedInUsers).includes(identifier)) {
+            else if (operator === 'edge') {
+                // Requests the broker hands to a device running the edge codec, for that device alone
+                if (!this.ownsControlTopic(session, device)) {
+                    throw new Error(`Not the Device: ${device}`);
+                }
+            }
+            else if (["request", "response", "stream"].includes(operator)) {
+                if (!this.sessions.isUser(identifier)) {
                     throw new Error(`Unknown User: ${identifier}`);
                 }
-                else if (!this.getIds(this.loggedInDevices).includes(device)) {
+                else if (!this.sessions.isDevice(device)) {
+                    throw new Error(`Unavailable Device: ${device}`)
+                }
+            }
+            else if (['data', 'capability'].includes(operator)) {
+                // Records published by a device on its own topics, open to any logged in user
+                if (!session || session.isDevice) {
+                    throw new Error(`Unknown User: ${clientName}`);
+                }
+                else if (!this.sessions.isDevice(device)) {
                     throw new Error(`Unavailable Device: ${device}`)
                 }
             }
@@ -205,6 +362,7 @@ class MQTTBroker {
         }
 
         console.log('\x1b[32m%s\x1b[0m', `[Subscription Allowed]`, `${clientName} ---> ${sub.topic}`);
+        this.sessions.subscribe(client.id, sub.topic.split("/")[1], sub.topic);
         this.updateLastActivity(client.id);
         callback(null, sub);
     }
@@ -217,13 +375,49 @@ class MQTTBroker {
      */
     authorizePublish(client, packet, callback) {
         const clientName = client._parser.settings.username;
+        const [identifier, device, operator] = packet.topic.split("/");
+        const session = this.sessions.get(client.id);
+
+        // Only the broker hands requests to the edge codec, so each request is executed once
+        if ((operator === 'control' && !this.ownsControlTopic(session, device))
+            || (operator === 'diagnostics' && !this.mayDiagnose(session, identifier, device))
+            || operator === 'edge') {
+            console.error('\x1b[31m%s\x1b[0m', '[Publication Denied]', `${clientName} ---> ${packet.topic}`);
+            callback(new Error('Unauthorized'));
+            return;
+        }
+
         console.log('\x1b[36m%s\x1b[0m', '[Message Published]', `${clientName} ---> ${packet.topic}`);
         this.updateLastActivity(client.id);
         callback(null, packet);
     }
 
     /**
-     * Registers a callback for incoming messages.
+     * Tells whether a client is the device owning a control topic. The broker publishes there without
+     * authorization, users reach the device's commands through the diagnostics topic it relays.
+     * @param {Object} [session] - Session of the client.
+     * @param {string} device - Device of the topic.
+     * @returns {boolean}
+     */
+    ownsControlTopic(session, device) {
+        return !!session?.isDevice && session.identifier === device;
+    }
+
+    /**
+     * Tells whether a client may use a diagnostics topic: a user on its own topic, for a device it is allowed.
+     * @param {Object} [session] - Session of the client.
+     * @param {string} identifier - User of the topic.
+     * @param {string} device - Device of the topic.
+     * @returns {boolean}
+     */
+    mayDiagnose(session, identifier, device) {
+        return !!session && !session.isDevice && session.identifier === identifier
+            && Array.isArray(session.devices) && session.devices.includes(device);
+    }
+
+    /**
+     * Registers a callback for incoming messages. Payloads are handed over as received, binary
+     * mbnet frames must not go through a string conversion.
      * @param {Function} callback - Function to handle incoming messages.
      */
     onMessage(callback) {
@@ -235,7 +429,7 @@ class MQTTBroker {
             if (packet.hasOwnProperty('broker'))
                 return;
 
-            await callback(packet.topic, packet.payload.toString(), client.id);
+            await callback(packet.topic, packet.payload, client.id);
         });
     }
 
@@ -243,15 +437,20 @@ class MQTTBroker {
      * Publishes a message to a specified topic.
      * @param {string} topic - The topic to publish to.
      * @param {Object|Buffer|string} __payload - The payload to be published.
+     * @param {number|Buffer|null} [header=mbnet.ORIGIN_BROKER] - Tag byte or sequenced mbnet header prepended to Buffer payloads,
+     * null to publish them as they are.
      */
-    publish(topic, __payload) {
+    publish(topic, __payload, header = mbnet.ORIGIN_BROKER) {
         
         let payload;
         if (typeof __payload === 'object' && !Buffer.isBuffer(__payload)) {
             payload = JSON.stringify(__payload);
         } 
+        else if (Buffer.isBuffer(__payload) && header === null) {
+            payload = __payload;
+        }
         else if (Buffer.isBuffer(__payload)) {
-            payload = Buffer.concat([Buffer.from([0x00]), __payload]);
+            payload = Buffer.concat([Buffer.isBuffer(header) ? header : Buffer.from([header]), __payload]);
         }
 
         const packet = {
@@ -273,6 +472,17 @@ class MQTTBroker {
         });
     }
 
+    /**
+     * Returns the IPv4 address a logged in device connected from.
+     * @param {string} device - Device name.
+     * @returns {string|null} - The address, or null if the device is not connected.
+     */
+    remoteAddressOf(device) {
+        const clientId = this.sessions.clientOfDevice(device);
+        const address = this.aedes.clients[clientId]?.conn?.remoteAddress;
+        return address ? address.replace(/^::ffff:/, '') : null;
+    }
+
     /**
      * Logs out a client by removing subscriptions and disconnecting.
      * @param {string} clientId - The ID of the client to log out.
@@ -287,16 +497,7 @@ class MQTTBroker {
             client.close(() => {});
         }
 
-        if (this.loggedInUsers[clientId]) {
-            delete this.loggedInUsers[clientId];
-        }
-        if (this.loggedInDevices[clientId]) {
-            delete this.loggedInDevices[clientId];
-        }
-
-        if (this.lastActivity[clientId]) {
-            delete this.lastActivity[clientId];
-        }
+        this.endSession(clientId);
     }
 
     /**
@@ -310,7 +511,7 @@ class MQTTBroker {
     }
 
     /**
-     * Logs unsubscription events to the console.
+     * Logs unsubscription events to the console, and forgets the subscriptions.
      * @param {string[]} topics - Topics from which the client unsubscribed.
      * @param {Object} client - The client object that unsubscribed.
      */
@@ -318,6 +519,7 @@ class MQTTBroker {
         const clientName = client._parser.settings.username;
         topics.forEach((topic) => {
             console.log('\x1b[33m%s\x1b[0m', '[Unsubscription]', `${clientName} -X-> ${topic}`);
+            this.sessions.unsubscribe(client.id, topic.split("/")[1], topic);
         });
     }
 
@@ -331,23 +533,16 @@ class MQTTBroker {
 
         console.log('\x1b[33m%s\x1b[0m', '[Client Disconnected]', `${clientName}`);
 
-        if (this.loggedInUsers[clientId]) {
-            delete this.loggedInUsers[clientId];
-        }
-        if (this.loggedInDevices[clientId]) {
-            delete this.loggedInDevices[clientId];
-        }
+        this.endSession(clientId);
     }
 
     /**
-     * Retrieves a list of IDs from logged sessions for user or device authorization checks.
-     * @param {Object} loggedObject - Object containing logged-in clients or devices.
-     * @param {number} [id=0] - Index to access the desired client or device ID.
-     * @returns {string[]} - List of client or device IDs.
+     * Lists the clients subscribed to a device's topics.
+     * @param {string} device - Device name.
+     * @returns {string[]} - Their client IDs.
      */
-    getIds(loggedObject, id = 0) {
-        const firstPositions = Object.keys(loggedObject).map(key => loggedObject[key][id]);
-        return firstPositions;
+    subscribersOf(device) {
+        return this.sessions.subscribersOf(device);
     }
 }
 
@@ -13,6 +13,8 @@
  *   and handles the debuffering of responses for client readability.
  * - **Error Handling and Response Management**: Identifies and manages errors, timeouts, and validation issues,
  *   providing structured feedback to the client.
+ * - **Priority Classification**: Tags writes as control traffic and everything else as interactive, so the
+ *   queue and the device's bus scheduler can serve commands ahead of bulk reads.
  *
  * Dependencies:
  * - `@validator/requestFormatter`: Parses and validates incoming client JSON requests for Modbus compatibility.
@@ -20,10 +22,12 @@
  * - `@parser/modbusPacketBufferizer` and `@parser/modbusResponseDebufferizer`: Bufferize and debufferize packets
  *   to meet Modbus format requirements.
  * - `@maps/keywordsMap`: Provides standard fields (`mb.STATUS`, `mb.MESSAGE`) for response structure.
+ * - `@core/mbnet`: Priority classes carried in the mbnet tag byte.
  *
  * Usage in TCC System:
  * 1. `ClientRequest` instances are created when a validated client request is received.
- * 2. Methods like `pushResponse`, `errorResponse`, and `processClientResponse` manage Modbus response handling.
+ * 2. Methods like `pushResponse`, `errorResponse`, `processClientResponse`, `processClientError` and
+ *    `processCachedResponse` manage Modbus response handling.
  *
  * Example:
  * -----------
@@ -42,10 +46,19 @@ const ModbusPacketBufferizer        = require('@parser/modbusPacketBufferizer')
 const ModbusResponseDebufferizer    = require('@parser/modbusResponseDebufferizer')
 const ModbusResponseDecoder         = require('@parser/modbusResponseDecoder')
 const { mb }                        = require('@maps/keywordsMap');
+const { mbnet }                     = require('@core/mbnet.js');
 
 class ClientRequest {
 
-    constructor(content, format, client, device) {
+    /**
+     * Formats and encodes a validated client request.
+     * @param {Object} content - The validated request.
+     * @param {string} format - Format of the request, verbose, terse or binary.
+     * @param {string} client - Client name.
+     * @param {string} device - Device name.
+     * @param {Function} [transactionProfile] - Returns the transaction profile of a slave, protocol limits if omitted.
+     */
+    constructor(content, format, client, device, transactionProfile = null) {
 
         this.originalContent = content
         this.originalformat = format
@@ -53,20 +66,50 @@ class ClientRequest {
         this.content = requestFormatter.parse(content, format);
         this.client = client;
         this.device = device;
+        this.priority = ClientRequest.priorityOf(this.content);
+        this.bypassed = 0;
 
-        this.parsedRequests = ModbusPacketConstructor.parse(this.content);
-        this.bufferRequests = this.parsedRequests.map((parsedPacket) => ModbusPacketBufferizer.toBuffer(parsedPacket, this.content))
+        this.parsedRequests = transactionProfile
+            ? ModbusPacketConstructor.parse(this.content, transactionProfile(this.content[mb.ID_PROPERTY]))
+            : ModbusPacketConstructor.parse(this.content);
+        this.bufferRequests = ModbusPacketBufferizer.toBuffers(this.parsedRequests, this.content)
 
         this.bufferResponses = [];
         this.responseObject = null;
+        this.sentPackets = 0;
+        this.answeredPackets = 0;
+        this.succeeded = false;
+        this.fetchedData = null;
     }
 
-    pushResponse(response) {
-        this.bufferResponses.push(response.slice(1));
+    /**
+     * Determines the priority class of a request: writes are control traffic, the rest is interactive.
+     * @param {Object} content - The parsed request.
+     * @returns {number} - The mbnet priority class.
+     */
+    static priorityOf(content) {
+        return content[mb.FUNCTION_PROPERTY] === mb.WRITE
+            ? mbnet.CLASS_CONTROL
+            : mbnet.CLASS_INTERACTIVE;
     }
 
+    /**
+     * Stores the device's answer to one of the request's frames.
+     * @param {Buffer} response - Modbus ADU without CRC, or the "Null" error payload.
+     * @param {number} index - Position of the answered frame in `bufferRequests`.
+     */
+    pushResponse(response, index) {
+        this.bufferResponses[index] = response;
+        this.answeredPackets++;
+    }
+
+    /**
+     * Builds an error response, a shallow copy of the request sharing its arrays.
+     * @param {string} [message] - Error reported to the client.
+     * @returns {Object} - Unified response with a false status.
+     */
     errorResponse(message = null) {
-        const responseObject = JSON.parse(JSON.stringify(this.content));
+        const responseObject = { ...this.content };
         responseObject[mb.STATUS] = false;
         if (message) {
             responseObject[mb.MESSAGE] = message;
@@ -75,9 +118,17 @@ class ClientRequest {
         return responseObject;
     }
 
+    /**
+     * Answers the client with an error, in the format of the original request.
+     * @param {string} message - Error reported to the client.
+     */
+    processClientError(message) {
+        this.responseObject = RequestFormatter.correctFormat(this.errorResponse(message), this.originalContent, this.originalformat);
+    }
+
     processClientResponse(hasTimedOut) {
         if (hasTimedOut) {
-            this.errorResponse('Timed Out');
+            this.processClientError('Timed Out');
             return;
         }
 
@@ -89,8 +140,22 @@ class ClientRequest {
             ? this.errorResponse('Error Retrieving Data')
             : ModbusResponseDecoder.createClientResponse(this, parsedResponses);
 
+        this.succeeded = this.responseObject[mb.STATUS] === true;
+        this.fetchedData = this.responseObject[mb.FETCHED_DATA] ?? null;
         this.responseObject = RequestFormatter.correctFormat(this.responseObject, this.originalContent, this.originalformat);
     }
+
+    /**
+     * Answers a read with values served from the register cache, as the device would have.
+     * @param {Array} values - Values in the order of the requested addresses.
+     */
+    processCachedResponse(values) {
+        const responseObject = { ...this.content };
+        responseObject[mb.FETCHED_DATA] = values;
+        responseObject[mb.STATUS] = true;
+
+        this.responseObject = RequestFormatter.correctFormat(responseObject, this.originalContent, this.originalformat);
+    }
 }
 
 module.exports = ClientRequest
@@ -0,0 +1,186 @@
+/**
+ * CoalescedRead - Reads of Several Clients Served by One Set of Bus Transactions
+ * -------------------------------------------------------------------------------
+ *
+ * Dashboards watching the same device tend to ask for the same registers at the same moment. Rather
+ * than running one set of transactions per client, the request queue merges pending reads addressed
+ * to the same slave with the same function into a `CoalescedRead`. It issues the fewest frames
+ * covering every member's addresses, as planned by the request encoder, and once answered rebuilds
+ * for each member the responses its own frames would have received, so every client gets exactly
+ * the response it would have had on its own.
+ *
+ * A `CoalescedRead` stands in for a `ClientRequest` in the queue: it exposes the same frame and
+ * response bookkeeping, and `members` lists the requests to answer once it completes.
+ *
+ * Key Functionalities:
+ * - **Coalescing Key**: `keyOf()` tells which requests may share frames, reads only.
+ * - **Planning**: `join()` adds a member and replans the covering frames, as long as none was sent.
+ * - **Fan Out**: `processClientResponse()` and `processClientError()` answer every member.
+ *
+ * Dependencies:
+ * - `@parser/modbusRequestEncoder` and `@parser/modbusPacketBufferizer`: Plan and buffer the covering frames.
+ * - `@parser/modbusResponseDebufferizer`: Marker of the "Null" error payload.
+ * - `@maps/keywordsMap`: Fields of the parsed requests.
+ *
+ * Example:
+ * ----------------
+ * const carrier = new CoalescedRead(waitingRequest, profile);
+ * carrier.join(clientRequest, profile);
+ */
+
+require('module-alias/register');
+const ModbusPacketConstructor       = require('@parser/modbusRequestEncoder')
+const ModbusPacketBufferizer        = require('@parser/modbusPacketBufferizer')
+const ModbusResponseDebufferizer    = require('@parser/modbusResponseDebufferizer')
+const { mb }                        = require('@maps/keywordsMap');
+
+class CoalescedRead {
+
+    /**
+     * Starts a coalesced read from a waiting request.
+     * @param {ClientRequest} request - First member, not yet sent.
+     * @param {Object} profile - Transaction profile of the target slave.
+     */
+    constructor(request, profile) {
+        this.members = [request];
+        this.key = CoalescedRead.keyOf(request);
+        this.client = request.client;
+        this.device = request.device;
+        this.priority = request.priority;
+        this.bypassed = request.bypassed;
+        this.holdUntil = request.holdUntil;
+
+        this.sentPackets = 0;
+        this.answeredPackets = 0;
+        this.plan(profile);
+    }
+
+    /**
+     * Tells which requests may share frames: reads of the same slave with the same function.
+     * @param {ClientRequest|CoalescedRead} request - Queued or incoming request.
+     * @returns {string|null} - Coalescing key, null if the request cannot be coalesced.
+     */
+    static keyOf(request) {
+        if (request instanceof CoalescedRead) {
+            return request.key;
+        }
+        if (request.content[mb.FUNCTION_PROPERTY] !== mb.READ || request.parsedRequests.length === 0) {
+            return null;
+        }
+
+        const [id, mbFunction] = request.parsedRequests[0];
+        return `${id}:${mbFunction}`;
+    }
+
+    /**
+     * Adds a member and replans the covering frames.
+     * @param {ClientRequest} request - Read with the same coalescing key.
+     * @param {Object} profile - Transaction profile of the target slave.
+     */
+    join(request, profile) {
+        this.members.push(request);
+        this.priority = Math.min(this.priority, request.priority);
+        this.plan(profile);
+    }
+
+    /**
+     * Plans the fewest frames covering the addresses of every member.
+     * @param {Object} profile - Transaction profile of the target slave.
+     */
+    plan(profile) {
+        const addresses = [];
+        for (const member of this.members) {
+            for (const [, , start, length] of member.parsedRequests) {
+                for (let i = 0; i < length; i++) {
+                    addresses.push(start + i);
+                }
+            }
+        }
+
+        this.content = Object.assign({}, this.members[0].content, { [mb.LIST_PROPERTY]: addresses });
+        delete this.content[mb.RANGE_PROPERTY];
+
+        this.parsedRequests = ModbusPacketConstructor.parse(this.content, profile);
+        this.bufferRequests = ModbusPacketBufferizer.toBuffers(this.parsedRequests, this.content);
+        this.bufferResponses = [];
+    }
+
+    /**
+     * Stores the device's answer to one of the covering frames.
+     * @param {Buffer} response - Modbus ADU without CRC, or the "Null" error payload.
+     * @param {number} index - Position of the answered frame in `bufferRequests`.
+     */
+    pushResponse(response, index) {
+        this.bufferResponses[index] = response;
+        this.answeredPackets++;
+    }
+
+    /**
+     * Answers every member with an error.
+     * @param {string} message - Error reported to the clients.
+     */
+    processClientError(message) {
+        this.members.forEach((member) => member.processClientError(message));
+    }
+
+    /**
+     * Answers every member from the responses to the covering frames.
+     * @param {boolean} hasTimedOut - True if a covering frame was not answered in time.
+     */
+    processClientResponse(hasTimedOut) {
+        for (const member of this.members) {
+            if (!hasTimedOut) {
+                member.bufferResponses = member.parsedRequests.map((parsedPacket) => this.responseTo(parsedPacket));
+            }
+            member.processClientResponse(hasTimedOut);
+        }
+    }
+
+    /**
+     * Rebuilds the response a member's frame would have received from the responses to the covering
+     * frames. A failed covering response is handed over as is, so the member fails the same way.
+     * @param {Array} parsedPacket - Member frame: id, function, start address and quantity.
+     * @returns {Buffer} - Modbus ADU without CRC.
+     */
+    responseTo([id, mbFunction, start, length]) {
+        const isBit = mbFunction === 0x01 || mbFunction === 0x02;
+        const data = Buffer.alloc(isBit ? Math.ceil(length / 8) : 2 * length);
+
+        for (let i = 0; i < length; i++) {
+            const address = start + i;
+            const index = this.parsedRequests.findIndex(([, , from, count]) => address >= from && address < from + count);
+            const response = this.bufferResponses[index];
+            const [, , from, count] = this.parsedRequests[index];
+
+            if (!response || !this.isValidResponse(response, mbFunction, count, isBit)) {
+                return response ?? ModbusResponseDebufferizer.nullBuffer;
+            }
+
+            const offset = address - from;
+            if (isBit) {
+                const bit = (response[3 + (offset >> 3)] >> (offset & 7)) & 1;
+                data[i >> 3] |= bit << (i & 7);
+            }
+            else {
+                response.copy(data, 2 * i, 3 + 2 * offset, 5 + 2 * offset);
+            }
+        }
+
+        return Buffer.concat([Buffer.from([id, mbFunction, data.length]), data]);
+    }
+
+    /**
+     * Checks that a covering response carries all the data its frame asked for.
+     * @param {Buffer} response - Modbus ADU without CRC.
+     * @param {number} mbFunction - Function of the frame.
+     * @param {number} count - Quantity the frame asked for.
+     * @param {boolean} isBit - True for coils and discrete inputs.
+     * @returns {boolean} - True if the response can be sliced.
+     */
+    isValidResponse(response, mbFunction, count, isBit) {
+        const byteCount = isBit ? Math.ceil(count / 8) : 2 * count;
+        return response.length >= 3 + byteCount && response[1] === mbFunction && response[2] === byteCount;
+    }
+}
+
+module.exports = CoalescedRead;
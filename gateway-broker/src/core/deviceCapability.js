@@ -0,0 +1,181 @@
+/**
+ * DeviceCapability - Capabilities Announced by a Gateway Device
+ * --------------------------------------------------------------
+ *
+ * Gateway devices publish a retained JSON record on `gateway/<device>/capability` every time they
+ * connect and after each bus discovery scan. It describes the device's bus line settings, its frame
+ * and queue limits, and the turnaround measured for each discovered slave. This class wraps the
+ * record and derives from it the time the broker should wait for each frame, replacing the single
+ * worst-case wait used for devices that have not announced themselves.
+ *
+ * Key Functionalities:
+ * - **Response Timeouts**: Sums the slave's response timeout, the time the request and its expected
+ *   response spend on the serial line, and a margin for the MQTT round trip.
+ * - **Device Limits**: Exposes the largest frame the device relays (`maxBundle`) and the depth of
+ *   its scheduler queues (`queueDepth`).
+ * - **Transports**: Exposes the UDP port the device accepts frames on (`udpPort`), 0 if none.
+ * - **Window**: Devices echoing the sequenced mbnet header (`mbnetVersion`) accept several frames in
+ *   flight, up to `window`; the others are served one frame at a time.
+ * - **Transaction Profiles**: Describes what a transaction to a slave costs and carries, so the
+ *   request encoder can plan the fewest, cheapest transactions (`transactionProfile`). Slave entries
+ *   may bound their transactions with `maxRegisters` and `maxBits`, on top of the protocol limits.
+ * - **Edge Codec**: Tells which client requests the device encodes and answers itself, so the broker
+ *   hands them over on the device's edge topic instead of encoding them (`encodesRequest`).
+ *
+ * Example:
+ * ----------------
+ * const capability = DeviceCapability.parse(payload) ?? DeviceCapability.fallback;
+ * const timeout = capability.responseTimeout(packet);
+ */
+
+require('module-alias/register');
+const { mb } = require('@maps/keywordsMap.js');
+
+class DeviceCapability {
+
+    static defaultTimeout_ms = 3000;    // Wait for devices that have not announced themselves
+    static networkMargin_ms = 1000;     // Allowance for the MQTT round trip and the device's queue
+    static maxWindow = 4;               // Frames kept in flight on devices echoing sequence numbers
+    static defaultRoundTrip_ms = 20;    // Round trip to the device until one is measured
+    static frameOverhead = 5 + 8 + 7;   // Response and request framing plus the inter-frame silences, in characters
+
+    /**
+     * Builds the capability from a device record, filling missing fields with conservative values.
+     * @param {Object} record - Parsed capability record.
+     */
+    constructor(record = {}) {
+        const bus = (record.buses ?? [])[0] ?? {};
+
+        this.firmware = record.firmware ?? null;
+        this.baud = bus.baud ?? 9600;
+        this.bitsPerCharacter = 1 + 8 + (bus.parity && bus.parity !== 'none' ? 1 : 0) + (bus.stopBits ?? 1);
+        this.listenOnly = bus.listenOnly ?? false;
+        this.maxBundle = record.maxBundle ?? 254;
+        this.functions = new Set(record.functions ?? []);
+        this.queueDepth = record.queueDepth ?? [1, 1, 1];
+        this.busTimeout_ms = record.timeout ?? 500;
+        this.udpPort = record.udp ?? 0;
+        this.mbnetVersion = record.mbnet ?? 0;
+        this.window = this.mbnetVersion >= 1 ? Math.max(1, Math.min(DeviceCapability.maxWindow, ...this.queueDepth)) : 1;
+        this.codecPoints = record.codec?.maxPoints ?? 0;
+        this.codecRequestSize = record.codec?.maxRequest ?? 0;
+        this.codecTopicSize = record.codec?.maxTopic ?? 0;
+        this.slaves = new Map((record.slaves ?? []).map((slave) => [slave.id, slave]));
+    }
+
+    /**
+     * Parses a capability record published by a device.
+     * @param {string|Buffer} payload - JSON record.
+     * @returns {DeviceCapability|null} - The capability, or null if the record is malformed.
+     */
+    static parse(payload) {
+        try {
+            return new DeviceCapability(JSON.parse(payload));
+        }
+        catch (error) {
+            return null;
+        }
+    }
+
+    /**
+     * Time a character takes on the device's serial line.
+     * @returns {number} - Character time in milliseconds.
+     */
+    characterTime_ms() {
+        return this.bitsPerCharacter * 1000 / this.baud;
+    }
+
+    /**
+     * Response timeout of a slave, as seeded by the device's discovery scan.
+     * @param {number} id - Slave address.
+     * @returns {number} - Timeout in milliseconds.
+     */
+    slaveTimeout_ms(id) {
+        return this.slaves.get(id)?.timeout ?? this.busTimeout_ms;
+    }
+
+    /**
+     * Describes transactions to a slave for the request encoder: the most points each may carry and
+     * what one costs, framing, slave turnaround and round trip to the device included.
+     * @param {number} id - Slave address.
+     * @param {number|null} roundTrip_ms - Round trip measured to the device, null if none yet.
+     * @returns {Object} - Transaction profile, see `IORequestEncoder.defaultProfile`.
+     */
+    transactionProfile(id, roundTrip_ms) {
+        const slave = this.slaves.get(id) ?? {};
+        const maxRegisters = slave.maxRegisters ?? Infinity;
+        const maxBits = slave.maxBits ?? Infinity;
+
+        return {
+            maxReadBits: Math.min(2000, maxBits, 8 * (this.maxBundle - 3)),
+            maxReadRegisters: Math.min(125, maxRegisters, Math.floor((this.maxBundle - 3) / 2)),
+            maxWriteBits: Math.min(1968, maxBits, 8 * (this.maxBundle - 7)),
+            maxWriteRegisters: Math.min(123, maxRegisters, Math.floor((this.maxBundle - 7) / 2)),
+            characterTime_ms: this.characterTime_ms(),
+            transactionCost_ms: DeviceCapability.frameOverhead * this.characterTime_ms()
+                + (slave.turnaround ?? 0) / 1000
+                + (roundTrip_ms ?? DeviceCapability.defaultRoundTrip_ms),
+        };
+    }
+
+    /**
+     * Checks whether the device encodes and answers a client request itself: terse reads and writes
+     * within the limits it announced. Devices that do not announce the longest topic they accept
+     * never receive requests.
+     * @param {Object} request - Parsed client request.
+     * @param {number} size - Size of the request as published, in bytes.
+     * @param {string} topic - Topic the request would be handed over on.
+     * @returns {boolean} - True if the broker must hand the request to the device.
+     */
+    encodesRequest(request, size, topic) {
+        if (!this.codecPoints || size > this.codecRequestSize || Buffer.byteLength(topic) > this.codecTopicSize) {
+            return false;
+        }
+        if (request === null || typeof request !== 'object' || Buffer.isBuffer(request)) {
+            return false;
+        }
+        if (!request.hasOwnProperty(mb.ID_PROPERTY) || ![mb.READ, mb.WRITE].includes(request[mb.FUNCTION_PROPERTY])) {
+            return false;
+        }
+
+        const range = request[mb.RANGE_PROPERTY];
+        const list = request[mb.LIST_PROPERTY];
+        const points = Array.isArray(range) ? range[1] - range[0] + 1 : Array.isArray(list) ? list.length : 0;
+        return points <= this.codecPoints;
+    }
+
+    /**
+     * Length of the response expected for a Modbus frame, CRC included.
+     * @param {Buffer} packet - Modbus ADU without CRC.
+     * @returns {number} - Response length in bytes, the largest frame if unknown.
+     */
+    static expectedResponseLength(packet) {
+        const quantity = packet.length >= 6 ? packet.readUInt16BE(4) : 0;
+
+        switch (packet[1]) {
+            case 0x01: case 0x02: return 5 + Math.ceil(quantity / 8);
+            case 0x03: case 0x04: return 5 + 2 * quantity;
+            case 0x05: case 0x06: case 0x0F: case 0x10: return 8;
+            default: return 256;
+        }
+    }
+
+    /**
+     * Time to wait for the device's answer to a frame.
+     * @param {Buffer} packet - Modbus ADU without CRC.
+     * @returns {number} - Timeout in milliseconds.
+     */
+    responseTimeout(packet) {
+        const lineBytes = packet.length + 2 + DeviceCapability.expectedResponseLength(packet);
+        return Math.ceil(this.slaveTimeout_ms(packet[0]) + lineBytes * this.characterTime_ms() + DeviceCapability.networkMargin_ms);
+    }
+}
+
+/**
+ * Capability assumed for devices that have not announced themselves, waiting the historical fixed time.
+ */
+DeviceCapability.fallback = Object.freeze(Object.assign(new DeviceCapability(), {
+    responseTimeout: () => DeviceCapability.defaultTimeout_ms,
+}));
+
+module.exports = DeviceCapability;
@@ -8,8 +8,9 @@
  *
  * Key Components:
  * - **MQTT Broker**: Utilizes `MQTTBroker` to handle MQTT communications and manage client connections.
- * - **Request Queue**: Manages `ClientRequest` objects, including validation and buffering for Modbus requests
- *   and debuffering responses back to the client.
+ * - **Request Queues**: One per logged in device, created and torn down with the device session. Each manages
+ *   `ClientRequest` objects, including validation and buffering for Modbus requests and debuffering responses
+ *   back to the client, independently of the other devices.
  * - **Client Request Handling**: Validates client requests, parses them to Modbus-compatible packets, and buffers
  *   them for device transmission; collects responses for each request, handling errors and timeouts as needed.
  *
@@ -19,17 +20,26 @@
  * - **start**: Initializes the MQTT broker and prepares the system for client and device interactions.
  * - **Error Handling & Feedback**: Responds to clients with error messages if validation fails and logs device
  *   responses for monitoring.
+ * - **Diagnostics Relay**: Relays the control commands users publish on `<user>/<device>/diagnostics` to the
+ *   device's control topic, which only the device and the broker may use, and the device's replies back.
  *
  * Dependencies:
  * - `@core/broker.js`: MQTT broker for managing client subscriptions, publishing responses, and session handling.
- * - `@core/queue.js`: Queue manager for ordered processing of client requests and Modbus responses.
+ * - `@core/queue.js`: Per-device queue manager for ordered processing of client requests and Modbus responses.
  * - `@core/clientRequest.js`: Encapsulates client request information and processes responses from devices.
+ * - `@core/deviceCapability.js`: Capabilities announced by devices, used to size timeouts per device.
+ * - `@core/udpEndpoint.js`: Datagram transport to devices announcing a UDP port, MQTT stays the fallback.
+ * - `@core/registerCache.js`: Recently read and written values, answering reads within their staleness bound.
+ * - `@core/streamScheduler.js`: Periodic reads of subscribe requests, streaming changed values to clients.
+ * - `@core/requestBatch.js`: Responses of the requests published together as an array.
  * - `@validator/requestValidator.js`: Validates requests against a predefined schema for format and content.
+ * - `@validator/binaryFormat.js`: Binary client format, next to terse and verbose JSON.
  * - `@maps/keywordsMap.js`: Map of standard field names (e.g., `mb.MESSAGE`, `mb.ALLOWED_VALUES`) for consistent
  *   message structures across the system.
  *
  * Usage:
- * 1. Instantiate `Gateway` with database URI and optionally, the MQTT port.
+ * 1. Instantiate `Gateway` with database URI and optionally, the MQTT port, TLS options, UDP port,
+ *    read coalescing window and register cache policy.
  * 2. Call `start()` to launch the MQTT broker and begin handling requests.
  * 
  * Example:
@@ -48,16 +58,33 @@ const RequestQueue      = require('@core/queue.js');
 const ClientRequest     = require('@core/clientRequest.js');
 const { validator }     = require('@validator/requestValidator.js');
 const { mb, getKey }    = require('@maps/keywordsMap.js');
+const { mbnet }         = require('@core/mbnet.js');
+const DeviceCapability  = require('@core/deviceCapability.js');
+const UdpEndpoint       = require('@core/udpEndpoint.js');
+const RegisterCache     = require('@core/registerCache.js');
+const StreamScheduler   = require('@core/streamScheduler.js');
+const RequestBatch      = require('@core/requestBatch.js');
+const { requestFormatter, RequestFormatter } = require('@validator/requestFormatter');
+const BinaryFormat      = require('@validator/binaryFormat');
 
 class Gateway {
     /**
-     * Initializes the Gateway class, setting up the MQTT broker and request queue.
+     * Initializes the Gateway class, setting up the MQTT broker and the per-device request queues.
      * @param {string} dbUri - URI for connecting to the MongoDB database.
      * @param {number} [mqttPort=1883] - Port to use for the MQTT broker.
+     * @param {Object} [tlsOptions=null] - TLS listener options, plain TCP if omitted.
+     * @param {number} [udpPort=null] - Local port of the datagram transport, disabled if omitted.
+     * @param {number} [coalesceWindow_ms=0] - Time reads are held so simultaneous ones share frames.
+     * @param {number} [cacheMaxAge_ms=0] - Age up to which cached values answer reads that set no bound.
+     * @param {Array} [cachePolicy=[]] - Per-device and per-range maximum ages, see `RegisterCache`.
      */
-    constructor(dbUri, mqttPort=1883) {
-        this.broker = new MQTTBroker(dbUri, mqttPort);
-        this.requestQueue = new RequestQueue();
+    constructor(dbUri, mqttPort=1883, tlsOptions=null, udpPort=null, coalesceWindow_ms=0, cacheMaxAge_ms=0, cachePolicy=[]) {
+        this.broker = new MQTTBroker(dbUri, mqttPort, undefined, tlsOptions);
+        this.requestQueues = new Map();     // Device name -> RequestQueue
+        this.coalesceWindow_ms = coalesceWindow_ms;
+        this.registerCache = new RegisterCache(cacheMaxAge_ms, cachePolicy);
+        this.streams = new StreamScheduler();
+        this.udp = udpPort !== null ? new UdpEndpoint(udpPort) : null;
         this.setupCallbacks();
     }
 
@@ -68,43 +95,343 @@ class Gateway {
      * - Device response handling for processing Modbus responses.
      */
     setupCallbacks() {
+        this.broker.onDeviceSession((device, loggedIn) => {
+            if (loggedIn) {
+                this.openQueue(device);
+            }
+            else {
+                this.closeQueue(device);
+            }
+        });
+
+        // Subscriptions of users who left would keep polling the bus until they expire
+        this.broker.onUserSession((user, loggedIn) => {
+            if (!loggedIn) {
+                this.streams.unsubscribeClient(user);
+            }
+        });
+
         this.broker.onMessage((topic, payload) => {
             let [client, device, operator] = topic.split("/");
 
             if (operator === 'request') {
+                const published = payload;
+                const size = payload.length;
                 try { 
-                    payload = JSON.parse(payload); 
+                    payload = BinaryFormat.isBinary(payload) ? payload : JSON.parse(payload); 
                 } catch (error) { 
                     payload = {}; 
                 }
 
-                if (validator.validate(payload)) {
-                    const clientRequest = new ClientRequest(payload, validator.result.format, client, device); 
-                    console.log('\x1b[34m%s\x1b[0m', '[Client Request]', `${client} ---> ${device}`, JSON.stringify(clientRequest.content));
-                    this.requestQueue.enqueue(clientRequest);
-                } 
-                else {                    
-                    payload[getKey(mb.MESSAGE, validator.result.format)] = validator.result.msg;
-                    if (validator.result.hasOwnProperty('allowedValues')) {
-                        payload[getKey(mb.ALLOWED_VALUES, validator.result.format)] = validator.result.allowedValues;    
+                // Arrays are batches of requests, answered together
+                if (Array.isArray(payload)) {
+                    this.processBatch(client, device, payload);
+                    return;
+                }
+
+                const queue = this.requestQueues.get(device);
+
+                // Devices running the edge codec receive the requests they encode on their edge topic,
+                // and answer them directly
+                const edgeTopic = `${client}/${device}/edge`;
+                if (queue?.capability.encodesRequest(payload, size, edgeTopic)) {
+                    console.log('\x1b[34m%s\x1b[0m', '[Edge Request]', `${client} ---> ${device}`);
+                    this.broker.publish(edgeTopic, Buffer.from(published), null);
+                    if (payload[mb.FUNCTION_PROPERTY] === mb.WRITE) {
+                        this.registerCache.invalidate(device, payload[mb.ID_PROPERTY]);
                     }
+                    return;
+                }
 
-                    this.broker.publish(`${client}/${device}/response`, payload);
+                const request = this.prepare(client, device, payload, (response) => {
+                    this.publishToClient(`${client}/${device}/response`, response);
+                });
+                if (request && !queue.enqueue(request)) {
+                    request.processClientError('Queue Full');
+                    this.publishToClient(`${client}/${device}/response`, request.responseObject);
                 }
             } 
+            else if (operator === 'capability') {
+                const capability = DeviceCapability.parse(payload);
+                console.log('\x1b[35m%s\x1b[0m', '[Device Capability]', `${device}`, capability ? payload.toString() : 'malformed');
+                this.requestQueues.get(device)?.setCapability(capability);
+                this.openUdpSession(device, capability);
+            }
+            else if (operator === 'control' && client === 'gateway') {
+                // The device acknowledged the datagram session token
+                if (this.udp && payload[0] === mbnet.ORIGIN_DEVICE && payload[1] === UdpEndpoint.CONTROL_SESSION) {
+                    this.udp.activate(device);
+                }
+            }
+            else if (operator === 'control') {
+                // The device answered a user's command, relayed back on the user's diagnostics topic
+                if (payload[0] === mbnet.ORIGIN_DEVICE) {
+                    this.broker.publish(`${client}/${device}/diagnostics`, Buffer.from(payload), null);
+                }
+            }
+            else if (operator === 'diagnostics') {
+                // Users never reach the control topic, their commands are relayed to the device. Datagram
+                // session tokens are the broker's alone, a user setting one could take over the session
+                if (payload[0] === mbnet.ORIGIN_BROKER && payload[1] !== UdpEndpoint.CONTROL_SESSION) {
+                    this.broker.publish(`${client}/${device}/control`, Buffer.from(payload), null);
+                }
+            }
             else if (operator === 'mbnet') {
-                console.log('\x1b[35m%s\x1b[0m', '[Device Echo]', `${device}`, Buffer.from(payload).slice(1));
-                this.requestQueue.items[0].pushResponse(Buffer.from(payload));
+                this.onDeviceResponse(device, Buffer.from(payload));
+            }
+        });
+
+        this.udp?.onResponse((device, response) => this.onDeviceResponse(device, response));
+
+        this.streams.pollCallback = (poll) => {
+            const queue = this.requestQueues.get(poll.device);
+            if (!queue) {
+                return false;
+            }
+
+            const request = new ClientRequest(poll.content, 'terse', 'gateway', poll.device, (id) => queue.transactionProfile(id));
+            request.priority = mbnet.CLASS_BACKGROUND;
+            request.poll = poll;
+            return queue.enqueue(request);
+        };
+
+        this.streams.publishCallback = (client, device, message) => {
+            this.publishToClient(`${client}/${device}/stream`, message);
+        };
+    }
+
+    /**
+     * Validates a request and answers it right away when it needs no transaction with the device:
+     * invalid requests, subscriptions, reads served from the register cache and requests to devices
+     * that are not logged in.
+     * @param {string} client - Client name.
+     * @param {string} device - Device name.
+     * @param {Object|Buffer} payload - Request as published, parsed from JSON or binary.
+     * @param {Function} respond - Delivers an immediate response, in the request's format.
+     * @returns {ClientRequest|null} - The request to queue, null if it was answered.
+     */
+    prepare(client, device, payload, respond) {
+        const queue = this.requestQueues.get(device);
+        const isValid = validator.validate(payload);
+        const format = validator.result.format;
+
+        // Binary requests go on in their decoded, terse, form
+        payload = validator.result.request ?? payload;
+
+        if (!isValid) {
+            payload[getKey(mb.MESSAGE, format)] = validator.result.msg;
+            if (validator.result.hasOwnProperty('allowedValues')) {
+                payload[getKey(mb.ALLOWED_VALUES, format)] = validator.result.allowedValues;
+            }
+
+            respond(format === 'binary' ? BinaryFormat.encode(payload) : payload);
+            return null;
+        }
+
+        const content = requestFormatter.parse(payload, format);
+        if (content[mb.FUNCTION_PROPERTY] === mb.SUBSCRIBE) {
+            respond(this.subscribe(client, device, content, payload, format));
+            return null;
+        }
+
+        const clientRequest = new ClientRequest(payload, format, client, device, queue && ((id) => queue.transactionProfile(id)));
+        console.log('\x1b[34m%s\x1b[0m', '[Client Request]', `${client} ---> ${device}`, JSON.stringify(clientRequest.content));
+
+        const cached = queue && clientRequest.content[mb.FUNCTION_PROPERTY] === mb.READ
+            ? this.registerCache.lookup(device, clientRequest.content)
+            : null;
+
+        if (cached) {
+            console.log('\x1b[34m%s\x1b[0m', '[Cache Hit]', `${client} <--- ${device}`);
+            clientRequest.processCachedResponse(cached);
+            respond(clientRequest.responseObject);
+            return null;
+        }
+        if (!queue) {
+            clientRequest.processClientError('Unavailable Device');
+            respond(clientRequest.responseObject);
+            return null;
+        }
+
+        return clientRequest;
+    }
+
+    /**
+     * Handles a batch of requests published as one array. Every request is prepared, those needing
+     * the device are queued together, so reads of the same slave and function share frames, and
+     * the responses are published as one array, in the order of the requests.
+     * @param {string} client - Client name.
+     * @param {string} device - Device name.
+     * @param {Array} payloads - Requests as published.
+     */
+    processBatch(client, device, payloads) {
+        const topic = `${client}/${device}/response`;
+
+        if (payloads.length === 0) {
+            this.publishToClient(topic, []);
+            return;
+        }
+
+        // Oversize batches are refused as a whole, still answering every request in its own format
+        if (payloads.length > RequestBatch.maxSize) {
+            const message = `Batch exceeds ${RequestBatch.maxSize} requests`;
+            this.publishToClient(topic, payloads.map((payload) => {
+                const element = payload !== null && typeof payload === 'object' && !Array.isArray(payload) ? payload : {};
+                const format = Object.hasOwn(element, getKey(mb.ID_PROPERTY, 'verbose')) ? 'verbose' : 'terse';
+                return { ...element, [getKey(mb.STATUS, format)]: false, [getKey(mb.MESSAGE, format)]: message };
+            }));
+            return;
+        }
+
+        console.log('\x1b[34m%s\x1b[0m', '[Client Batch]', `${client} ---> ${device}`, `${payloads.length} requests`);
+        const batch = new RequestBatch(payloads.length, (responses) => this.publishToClient(topic, responses));
+        const requests = [];
+
+        payloads.forEach((payload, index) => {
+            // Anything but an object is answered as an unidentified request
+            const element = payload !== null && typeof payload === 'object' && !Array.isArray(payload) ? payload : {};
+            const request = this.prepare(client, device, element, (response) => batch.answer(index, response));
+            if (request) {
+                request.batch = batch;
+                request.batchIndex = index;
+                requests.push(request);
+            }
+        });
+
+        if (requests.length === 0) {
+            return;
+        }
+
+        this.requestQueues.get(device).enqueueAll(requests).forEach((accepted, i) => {
+            if (!accepted) {
+                requests[i].processClientError('Queue Full');
+                batch.answer(requests[i].batchIndex, requests[i].responseObject);
             }
         });
+    }
+
+    /**
+     * Registers, renews or cancels a subscription.
+     * @param {string} client - Client name.
+     * @param {string} device - Device name.
+     * @param {Object} content - Unified subscribe request.
+     * @param {Object} payload - Request as published.
+     * @param {string} format - Format of the request, verbose, terse or binary.
+     * @returns {Object|Buffer} - Acknowledgement, in the format of the request.
+     */
+    subscribe(client, device, content, payload, format) {
+        const response = { ...content };
+        response[mb.STATUS] = this.requestQueues.has(device);
+
+        if (response[mb.STATUS]) {
+            console.log('\x1b[34m%s\x1b[0m', '[Stream Subscription]', `${client} ---> ${device}`, JSON.stringify(content));
+            this.streams.subscribe(client, device, content, payload, format);
+        }
+        else {
+            response[mb.MESSAGE] = 'Unavailable Device';
+        }
+
+        return RequestFormatter.correctFormat(response, payload, format);
+    }
 
-        this.requestQueue.postToDeviceCallback = (client, device, bufferizedPacket) => {
-            this.broker.publish(`${client}/${device}/mbnet`, bufferizedPacket);
+    /**
+     * Publishes a response or stream message to a client, binary messages as they are, with no mbnet tag.
+     * @param {string} topic - Client topic.
+     * @param {Object|Buffer} message - Message in the client's format.
+     */
+    publishToClient(topic, message) {
+        this.broker.publish(topic, message, null);
+    }
+
+    /**
+     * Creates the request queue of a device whose session started.
+     * @param {string} device - Device name.
+     */
+    openQueue(device) {
+        if (this.requestQueues.has(device)) {
+            return;
+        }
+
+        const queue = new RequestQueue(device);
+        queue.coalesceWindow_ms = this.coalesceWindow_ms;
+
+        queue.postToDeviceCallback = (client, device, bufferizedPacket, priority, sequence) => {
+            if (this.udp?.isActive(device)) {
+                const deadline = queue.capability.responseTimeout(bufferizedPacket);
+                this.udp.send(device, bufferizedPacket, mbnet.tag(priority), deadline);
+            }
+            else if (queue.capability.mbnetVersion >= 1) {
+                this.broker.publish(`${client}/${device}/mbnet`, bufferizedPacket, mbnet.header(priority, sequence));
+            }
+            else {
+                this.broker.publish(`${client}/${device}/mbnet`, bufferizedPacket, mbnet.tag(priority));
+            }
         };
 
-        this.requestQueue.postToClientCallback = (request) => {
-            this.broker.publish(`${request.client}/${request.device}/response`, request.responseObject);
+        // Datagram sessions track a single pending frame
+        queue.windowCallback = () => this.udp?.isActive(device) ? 1 : queue.capability.window;
+
+        queue.postToClientCallback = (request) => {
+            this.registerCache.record(request.device, request);
+            if (request.poll) {
+                this.streams.onPollResult(request.poll, request.succeeded ? request.fetchedData : null, request.responseObject[mb.MESSAGE]);
+                return;
+            }
+            if (request.batch) {
+                request.batch.answer(request.batchIndex, request.responseObject);
+                return;
+            }
+            this.publishToClient(`${request.client}/${request.device}/response`, request.responseObject);
         };
+
+        this.requestQueues.set(device, queue);
+    }
+
+    /**
+     * Tears down the request queue of a device whose session ended, answering the requests still waiting.
+     * @param {string} device - Device name.
+     */
+    closeQueue(device) {
+        const queue = this.requestQueues.get(device);
+        if (!queue) {
+            return;
+        }
+
+        this.requestQueues.delete(device);
+        queue.drain('Device Disconnected');
+        this.udp?.closeSession(device);
+        this.registerCache.invalidate(device);
+    }
+
+    /**
+     * Hands a device response to that device's queue, whichever transport carried it.
+     * @param {string} device - Device name.
+     * @param {Buffer} response - mbnet payload, header followed by the Modbus ADU.
+     */
+    onDeviceResponse(device, response) {
+        console.log('\x1b[35m%s\x1b[0m', '[Device Echo]', `${device}`, response.subarray(mbnet.headerLength(response[0])));
+        this.requestQueues.get(device)?.pushResponse(response);
+    }
+
+    /**
+     * Opens a datagram session with a device announcing a UDP port and hands it the token over the
+     * control topic. The session carries frames once the device acknowledges the token.
+     * @param {string} device - Device name.
+     * @param {DeviceCapability|null} capability - Capabilities just announced by the device.
+     */
+    openUdpSession(device, capability) {
+        if (!this.udp) {
+            return;
+        }
+
+        const address = this.broker.remoteAddressOf(device);
+        if (!capability?.udpPort || !address) {
+            this.udp.closeSession(device);
+            return;
+        }
+
+        const token = this.udp.openSession(device, address, capability.udpPort);
+        this.broker.publish(`gateway/${device}/control`, Buffer.concat([Buffer.from([UdpEndpoint.CONTROL_SESSION]), token]));
     }
 
     /**
@@ -112,6 +439,23 @@ class Gateway {
      */
     start() {
         this.broker.start();
+        this.udp?.start();
+        this.startCacheReport(60000);
+    }
+
+    /**
+     * Periodically logs the register cache metrics, while it is being used.
+     * @param {number} period_ms - Report period in milliseconds.
+     */
+    startCacheReport(period_ms) {
+        let lookups = 0;
+        setInterval(() => {
+            const metrics = this.registerCache.metrics();
+            if (metrics.hits + metrics.misses !== lookups) {
+                lookups = metrics.hits + metrics.misses;
+                console.log('\x1b[35m%s\x1b[0m', '[Register Cache]', JSON.stringify(metrics));
+            }
+        }, period_ms);
     }
 }
 
@@ -0,0 +1,106 @@
+/**
+ * InactivityWheel - Hashed Timer Wheel of Session Deadlines
+ * ----------------------------------------------------------
+ *
+ * Tracks when each logged in client goes past the session timeout without activity, so that the broker
+ * only ever looks at the clients that have expired, instead of walking every session on each check.
+ *
+ * The wheel holds one slot per tick of the timeout, plus two so that a deadline never lands in a slot
+ * still to be processed for an earlier turn. A client sits in the slot of its deadline, its last activity
+ * plus the timeout. Activity moves it to the slot of its new deadline, two set operations, or nothing
+ * when the deadline falls in the same tick, as for bursts of messages. On each tick the slots whose
+ * whole span has passed are emptied, and every client found there has expired. Deadlines are met within
+ * one tick.
+ *
+ * Example:
+ * ----------------
+ * const wheel = new InactivityWheel(300000, 1000);
+ * wheel.touch('client-1');
+ * setInterval(() => wheel.expire().forEach(logout), 1000);
+ */
+
+class InactivityWheel {
+
+    /**
+     * Creates an empty wheel.
+     * @param {number} timeout_ms - Inactivity after which a client expires.
+     * @param {number} tick_ms - Span of a slot, and the precision of the deadlines.
+     * @param {number} [now=Date.now()] - Current time.
+     */
+    constructor(timeout_ms, tick_ms, now = Date.now()) {
+        this.timeout_ms = timeout_ms;
+        this.tick_ms = tick_ms;
+        this.slots = Array.from({ length: Math.ceil(timeout_ms / tick_ms) + 2 }, () => new Set());
+        this.ticks = new Map();                                 // Client id -> tick of its deadline
+        this.nextTick = Math.floor(now / tick_ms);              // First tick not yet processed
+    }
+
+    /**
+     * Records activity of a client, postponing its deadline.
+     * @param {string} clientId - The ID of the client.
+     * @param {number} [now=Date.now()] - Time of the activity.
+     */
+    touch(clientId, now = Date.now()) {
+        const tick = Math.max(Math.floor((now + this.timeout_ms) / this.tick_ms), this.nextTick);
+        const current = this.ticks.get(clientId);
+        if (current === tick) {
+            return;
+        }
+
+        if (current !== undefined) {
+            this.slots[current % this.slots.length].delete(clientId);
+        }
+        this.slots[tick % this.slots.length].add(clientId);
+        this.ticks.set(clientId, tick);
+    }
+
+    /**
+     * Forgets a client, as when it disconnects.
+     * @param {string} clientId - The ID of the client.
+     */
+    remove(clientId) {
+        const current = this.ticks.get(clientId);
+        if (current === undefined) {
+            return;
+        }
+
+        this.slots[current % this.slots.length].delete(clientId);
+        this.ticks.delete(clientId);
+    }
+
+    /**
+     * Empties the slots whose span has passed, forgetting their clients.
+     * @param {number} [now=Date.now()] - Current time.
+     * @returns {string[]} - IDs of the clients that expired.
+     */
+    expire(now = Date.now()) {
+        const expired = [];
+        const lastTick = Math.floor(now / this.tick_ms) - 1;     // Last tick whose span has passed
+
+        // After a long stall, every slot is visited once
+        const firstTick = Math.max(this.nextTick, lastTick - this.slots.length + 1);
+        for (let tick = firstTick; tick <= lastTick; tick++) {
+            const slot = this.slots[tick % this.slots.length];
+            for (const clientId of slot) {
+                if (this.ticks.get(clientId) <= lastTick) {
+                    slot.delete(clientId);
+                    this.ticks.delete(clientId);
+                    expired.push(clientId);
+                }
+            }
+        }
+
+        this.nextTick = Math.max(this.nextTick, lastTick + 1);
+        return expired;
+    }
+
+    /**
+     * Number of clients tracked.
+     * @returns {number}
+     */
+    get size() {
+        return this.ticks.size;
+    }
+}
+
+module.exports = InactivityWheel;
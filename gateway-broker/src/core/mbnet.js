@@ -0,0 +1,110 @@
+/**
+ * mbnet - Tag Byte Layout for Frames Exchanged with Gateway Devices
+ * ------------------------------------------------------------------
+ *
+ * Every payload published on a `<client>/<device>/mbnet` topic starts with a tag byte followed by
+ * the raw Modbus ADU (without CRC). The low nibble identifies who produced the frame and bits 4..5
+ * carry the priority class used by the device's bus scheduler. A tag of 0xFF marks frames that
+ * devices must ignore.
+ *
+ *   bit 7..6 | bit 5..4       | bit 3..0
+ *   version  | priority class | origin
+ *
+ * Version 0 is the bare tag above. Version 1 (sequenced) extends the tag into a header, so several
+ * frames can be outstanding on a device and their responses matched in any order:
+ *
+ *   byte 0 | byte 1..2         | byte 3 | byte 4
+ *   tag    | sequence (BE u16) | bus id | flags
+ *
+ * Devices echo the header of a request on its response, setting `FLAG_REFUSED` when their
+ * scheduler dropped the frame. Devices announce the sequenced header as `"mbnet": 1`.
+ *
+ * Priority Classes:
+ * - **CONTROL**: Write commands and alarms, always served first.
+ * - **INTERACTIVE**: Reads issued on behalf of a waiting client.
+ * - **BACKGROUND**: Periodic polling that can yield to everything else.
+ *
+ * Example:
+ * ----------------
+ * const { mbnet } = require('@core/mbnet.js');
+ * const tag = mbnet.tag(mbnet.CLASS_CONTROL);
+ */
+
+const mbnet = Object.freeze({
+    TAG_IGNORE:         0xFF,
+
+    VERSION_MASK:       0xC0,
+    VERSION_LEGACY:     0x00,
+    VERSION_SEQUENCED:  0x40,
+    HEADER_SIZE:        5,
+
+    FLAG_REFUSED:       0x01,
+
+    ORIGIN_MASK:        0x0F,
+    ORIGIN_BROKER:      0x00,
+    ORIGIN_DEVICE:      0x01,
+
+    CLASS_SHIFT:        4,
+    CLASS_MASK:         0x30,
+    CLASS_CONTROL:      0,
+    CLASS_INTERACTIVE:  1,
+    CLASS_BACKGROUND:   2,
+
+    /**
+     * Builds the tag byte of a frame published by the broker.
+     * @param {number} priority - Priority class of the frame.
+     * @returns {number} - Tag byte.
+     */
+    tag(priority) {
+        return this.ORIGIN_BROKER | ((priority << this.CLASS_SHIFT) & this.CLASS_MASK);
+    },
+
+    /**
+     * Builds the sequenced header of a frame published by the broker.
+     * @param {number} priority - Priority class of the frame.
+     * @param {number} sequence - Sequence number identifying the frame among those outstanding.
+     * @param {number} [bus=0] - Bus the frame is addressed to.
+     * @param {number} [flags=0] - Header flags.
+     * @returns {Buffer} - Header bytes.
+     */
+    header(priority, sequence, bus = 0, flags = 0) {
+        const header = Buffer.alloc(this.HEADER_SIZE);
+        header[0] = this.VERSION_SEQUENCED | this.tag(priority);
+        header.writeUInt16BE(sequence & 0xFFFF, 1);
+        header[3] = bus;
+        header[4] = flags;
+        return header;
+    },
+
+    /**
+     * Returns the length of the header a tag byte starts.
+     * @param {number} tag - Tag byte.
+     * @returns {number} - Header length in bytes.
+     */
+    headerLength(tag) {
+        return (tag & this.VERSION_MASK) === this.VERSION_SEQUENCED ? this.HEADER_SIZE : 1;
+    },
+
+    /**
+     * Splits an mbnet payload into its header fields and the Modbus ADU.
+     * @param {Buffer} payload - mbnet payload.
+     * @returns {Object} - `{ origin, priority, sequenced, sequence, bus, flags, adu }`, sequence, bus and
+     *                     flags being null for legacy frames.
+     */
+    parse(payload) {
+        const tag = payload[0];
+        const sequenced = (tag & this.VERSION_MASK) === this.VERSION_SEQUENCED && payload.length >= this.HEADER_SIZE;
+
+        return {
+            origin:     tag & this.ORIGIN_MASK,
+            priority:   (tag & this.CLASS_MASK) >> this.CLASS_SHIFT,
+            sequenced:  sequenced,
+            sequence:   sequenced ? payload.readUInt16BE(1) : null,
+            bus:        sequenced ? payload[3] : null,
+            flags:      sequenced ? payload[4] : null,
+            adu:        payload.subarray(sequenced ? this.HEADER_SIZE : 1),
+        };
+    },
+});
+
+module.exports = { mbnet };
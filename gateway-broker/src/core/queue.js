@@ -2,69 +2,228 @@
  * RequestQueue - A Queue System for Managing Modbus Requests in MQTT Gateway
  * ---------------------------------------------------------------------------
  * 
- * The `RequestQueue` class manages client requests in the MQTT to Modbus gateway system, ensuring
+ * The `RequestQueue` class manages the client requests addressed to one gateway device, ensuring
  * requests are processed sequentially and responses are properly relayed back to clients. It queues
- * incoming client requests, posts them to devices, and handles device responses, including timeout
- * and error management.
+ * incoming client requests, posts them to the device, and handles device responses, including timeout
+ * and error management. The gateway keeps one queue per logged in device, so devices on different
+ * buses are served concurrently.
  *
  * Key Functionalities:
  * - **Queue Management**: Enqueues requests up to a defined maximum size (`maxSize`), processes them
  *   sequentially, and handles overflow by rejecting additional requests when full.
+ * - **Read Coalescing**: Reads of the same slave with the same function that wait in the queue are
+ *   merged into a `CoalescedRead`, served by one set of frames and fanned out to every client. With
+ *   `coalesceWindow_ms` set, reads are held that long before being sent so simultaneous ones can merge.
+ *   The requests of a batch are inserted together (`enqueueAll()`), so its reads merge as well.
+ * - **Priority Ordering**: Requests are kept ordered by priority class, so control writes overtake
+ *   queued reads. A request can only be overtaken `maxBypass` times, which bounds its wait.
  * - **Device Communication**: Uses `postToDeviceCallback` to transmit buffered requests to the Modbus
- *   devices, waits for responses, and retries if responses are delayed.
+ *   devices. Up to `capability.window` frames are outstanding at once, each identified by the sequence
+ *   number of its mbnet header, so responses are matched to their frame whatever order they come in.
  * - **Timeout Handling**: Implements response timeouts to manage delayed device responses, alerting
- *   the client if no response is received within the specified period.
+ *   the client if no response is received within the specified period. Timeouts are derived from
+ *   the capability record the device announces, see `DeviceCapability`.
+ * - **Teardown**: `drain()` answers every request, sent or not, when the device session ends, and closes
+ *   the queue so none of its frames reach the device again.
  * - **Client Response Posting**: Transmits the final response back to the client via `postToClientCallback`,
  *   ensuring the client receives either the expected response or a timeout/error notification.
  *
  * Dependencies:
  * - `ClientRequest`: Instances of `ClientRequest` are enqueued, processed, and updated with device responses.
+ * - `DeviceCapability`: Capabilities announced by devices, used to size response timeouts.
+ * - `CoalescedRead`: Reads of several clients merged into one set of frames.
+ * - `@core/mbnet`: Header of the frames exchanged with devices.
  * - `postToDeviceCallback` and `postToClientCallback`: Static callback functions must be assigned in the
- *   parent system to handle outgoing device messages and client responses.
+ *   parent system to handle outgoing device messages and client responses. `windowCallback` may narrow
+ *   the window, e.g. for transports that carry a single frame at a time.
  *
  * Usage in TCC System:
- * 1. Client requests are enqueued with `enqueue()`.
- * 2. `triggerQueue()` processes each request, sending packets to devices and awaiting responses.
+ * 1. Client requests are enqueued with `enqueue()`, or all at once with `enqueueAll()` for batches.
+ * 2. `triggerQueue()` sends frames while the window allows; `pushResponse()` completes them.
  * 3. If a response times out, an error is logged and the client is notified via `postToClientCallback`.
  *
  * Example:
  * ----------------
- * const queue = new RequestQueue();
+ * const queue = new RequestQueue('esp1@usp');
  * queue.enqueue(clientRequest);
  *
  * Author: TEMPESTA, H. H.
  * Date: Oct 31st 2024
  */
 
+require('module-alias/register');
+const DeviceCapability = require('@core/deviceCapability.js');
+const CoalescedRead = require('@core/coalescedRead.js');
+const { mbnet } = require('@core/mbnet.js');
+
 class RequestQueue {
 
     static postToClientCallback = null;
     static postToDeviceCallback = null;
+    static windowCallback = null;
 
     /**
-     * Initializes the RequestQueue with an empty list of items and sets the processing state.
+     * Initializes the RequestQueue of a device with an empty list of items and sets the processing state.
      * Limits the queue size to `maxSize`.
+     * @param {string} device - Name of the device the queued requests are addressed to.
      */
-    constructor() {
+    constructor(device) {
+        this.device = device;
         this.items = [];
         this.processing = false;
         this.maxSize = 256;
+        this.maxBypass = 8;
+        this.capability = DeviceCapability.fallback;
+        this.inFlight = new Map();      // Sequence number -> { item, index, timer, sentAt }
+        this.sequence = 0;
+        this.roundTrip_ms = null;       // Smoothed time devices take to answer a frame
+        this.coalesceWindow_ms = 0;
+        this.holdTimer = null;
+        this.closed = false;
+    }
+
+    /**
+     * Records the capabilities announced by the device.
+     * @param {DeviceCapability|null} capability - Announced capabilities, null to fall back to conservative defaults.
+     */
+    setCapability(capability) {
+        this.capability = capability ?? DeviceCapability.fallback;
+    }
+
+    /**
+     * Profile the request encoder plans the transactions to a slave of this device with.
+     * @param {number} id - Slave address.
+     * @returns {Object} - Transaction profile, see `DeviceCapability.transactionProfile`.
+     */
+    transactionProfile(id) {
+        return this.capability.transactionProfile(id, this.roundTrip_ms);
+    }
+
+    /**
+     * Answers every request with an error, including those with frames already sent, and closes the
+     * queue. Frames in flight are forgotten and nothing is sent afterwards, as their sequence numbers
+     * could match the frames of the session the device opens next.
+     * @param {string} message - Error reported to the clients.
+     */
+    drain(message) {
+        this.closed = true;
+        this.processing = false;
+
+        for (const entry of this.inFlight.values()) {
+            clearTimeout(entry.timer);
+        }
+        this.inFlight.clear();
+        clearTimeout(this.holdTimer);
+        this.holdTimer = null;
+
+        const items = this.items;
+        this.items = [];
+
+        for (const item of items) {
+            item.processClientError(message);
+            this.respond(item);
+        }
     }
 
     /**
-     * Adds a new request to the queue if the queue size limit has not been reached.
+     * Posts the response of a finished item to its client, or to every client of a coalesced read.
+     * @param {ClientRequest|CoalescedRead} item - The finished item.
+     */
+    respond(item) {
+        for (const request of item.members ?? [item]) {
+            this.postToClientCallback(request);
+        }
+    }
+
+    /**
+     * Merges a read into a waiting read of the same slave and function, if any.
+     * @param {ClientRequest} element - The incoming request.
+     * @returns {boolean} - True if the request joined a waiting read and must not be queued itself.
+     */
+    coalesce(element) {
+        const key = CoalescedRead.keyOf(element);
+        if (key === null) {
+            return false;
+        }
+
+        const index = this.items.findIndex((item) => item.sentPackets === 0 && CoalescedRead.keyOf(item) === key);
+        if (index < 0) {
+            if (this.coalesceWindow_ms > 0) {
+                element.holdUntil = Date.now() + this.coalesceWindow_ms;
+            }
+            return false;
+        }
+
+        const profile = this.transactionProfile(element.parsedRequests[0][0]);
+        const target = this.items[index];
+        const carrier = target instanceof CoalescedRead ? target : new CoalescedRead(target, profile);
+
+        carrier.join(element, profile);
+        this.items[index] = carrier;
+        console.log('\x1b[34m%s\x1b[0m', '[Coalesced Read]', `${element.client} ---> ${this.device}`, `${carrier.members.length} clients`);
+        return true;
+    }
+
+    /**
+     * Adds a new request to the queue if the queue size limit has not been reached, placing it ahead
+     * of less urgent requests that have not yet been overtaken `maxBypass` times.
      * Starts processing the queue if it is not already being processed.
      * @param {ClientRequest} element - The client request to be added to the queue.
+     * @returns {boolean} - False if the queue is full and the request was rejected.
      */
     enqueue(element) {
+        if (!this.insert(element)) {
+            return false;
+        }
+
+        this.triggerQueue();
+        return true;
+    }
+
+    /**
+     * Adds the requests of a batch before sending any frame, so reads of the same slave and function
+     * within the batch coalesce.
+     * @param {Array} elements - The client requests to be added to the queue.
+     * @returns {Array} - Per request, false if the queue is full and it was rejected.
+     */
+    enqueueAll(elements) {
+        const accepted = elements.map((element) => this.insert(element));
+        this.triggerQueue();
+        return accepted;
+    }
+
+    /**
+     * Merges a request into a waiting read or places it in the queue, without sending any frame.
+     * @param {ClientRequest} element - The client request to be added to the queue.
+     * @returns {boolean} - False if the queue is full and the request was rejected.
+     */
+    insert(element) {
+        if (this.coalesce(element)) {
+            return true;
+        }
+
         if (this.items.length >= this.maxSize) {
-            return; // Queue is full; reject additional requests.
+            return false; // Queue is full; reject additional requests.
         }
 
-        this.items.push(element);
-        if (!this.processing) {
-            this.triggerQueue();
+        // Requests with frames already sent, and every request ahead of them, stay in place
+        const head = this.items.findLastIndex((item) => item.sentPackets > 0) + 1;
+        let position = this.items.length;
+
+        while (position > head) {
+            const previous = this.items[position - 1];
+            if (previous.priority <= element.priority || previous.bypassed >= this.maxBypass) {
+                break;
+            }
+            position--;
         }
+
+        for (let i = position; i < this.items.length; i++) {
+            this.items[i].bypassed++;
+        }
+
+        this.items.splice(position, 0, element);
+        return true;
     }
 
     /**
@@ -94,64 +253,115 @@ class RequestQueue {
     }
 
     /**
-     * Waits for a response from the device, resolving if a response is received,
-     * or rejecting if a timeout occurs.
-     * @param {ClientRequest} item - The request item to await a response for.
-     * @param {number} [timeout=15000] - The timeout period in milliseconds.
-     * @returns {Promise<void>} - Resolves when a response is received; rejects on timeout.
+     * Sends frames of the queued requests, in queue order, until the device's window of outstanding
+     * frames is full. Devices speaking the sequenced mbnet header accept several frames at once, so
+     * their scheduler never runs dry while round trips are in flight; legacy devices get one at a time.
      */
-    async awaitForResponse(item, timeout = 15000) { // 5 seconds timeout by default
-        const originalLength = item.bufferResponses.length;
+    triggerQueue() {
+        if (this.closed) {
+            return;
+        }
+
+        const window = this.windowCallback ? this.windowCallback() : this.capability.window;
+        const now = Date.now();
 
-        return new Promise((resolve, reject) => {
-            const startTime = Date.now();
+        while (this.inFlight.size < window) {
+            const item = this.items.find((candidate) => candidate.sentPackets < candidate.bufferRequests.length && !(candidate.holdUntil > now));
+            if (!item) {
+                break;
+            }
 
-            const checkLength = () => {
-                if (item.bufferResponses.length > originalLength) {
-                    resolve();
-                } 
-                else if (Date.now() - startTime >= timeout) {
-                    reject(new Error(`[Request Timed Out] ${item.client}/${item.device}/mbnet`));
-                } 
-                else {
-                    setTimeout(checkLength, 1); // Check every 1ms
-                }
-            };
+            this.transmit(item);
+        }
+
+        // Reads held for coalescing are sent once their window expires
+        const held = this.items.filter((item) => item.sentPackets === 0 && item.holdUntil > now);
+        if (held.length > 0 && !this.holdTimer) {
+            this.holdTimer = setTimeout(() => {
+                this.holdTimer = null;
+                this.triggerQueue();
+            }, Math.min(...held.map((item) => item.holdUntil)) - now);
+        }
 
-            checkLength();
-        });
+        this.processing = this.inFlight.size > 0;
     }
 
     /**
-     * Processes each request in the queue, sending requests to the device and awaiting responses.
-     * Posts responses to the client or logs timeout errors as needed.
+     * Sends the next frame of a request and arms its response timeout.
+     * @param {ClientRequest} item - The request the frame belongs to.
      */
-    async triggerQueue() {
-        this.processing = true;
+    transmit(item) {
+        const index = item.sentPackets++;
+        const packet = item.bufferRequests[index];
 
-        while (!this.isEmpty()) {
-            const item = this.peek();
-            let hasTimedOut = false;
+        this.sequence = (this.sequence + 1) & 0xFFFF;
+        const sequence = this.sequence;
 
-            for (const packet of item.bufferRequests) {
-                this.postToDeviceCallback(item.client, item.device, packet);
+        const timer = setTimeout(() => {
+            console.error(`[Request Timed Out] ${item.client}/${item.device}/mbnet`);
+            this.inFlight.delete(sequence);
+            this.complete(item, true);
+        }, this.capability.responseTimeout(packet));
 
-                try {
-                    await this.awaitForResponse(item, 3000);
-                } 
-                catch (error) {
-                    console.error(error.message);
-                    hasTimedOut = true;
-                    break;
-                }
-            }    
+        this.inFlight.set(sequence, { item, index, timer, sentAt: Date.now() });
+        this.postToDeviceCallback(item.client, item.device, packet, item.priority, sequence);
+    }
 
-            item.processClientResponse(hasTimedOut);
-            this.postToClientCallback(item);
-            this.dequeue();
+    /**
+     * Hands a device response to the frame it answers. Sequenced responses are matched by sequence
+     * number, legacy ones to the only frame in flight.
+     * @param {Buffer} payload - mbnet payload, header followed by the Modbus ADU.
+     */
+    pushResponse(payload) {
+        const frame = mbnet.parse(payload);
+        const sequence = frame.sequenced ? frame.sequence : this.inFlight.keys().next().value;
+        const entry = this.inFlight.get(sequence);
+
+        // Late answers to frames that timed out are dropped
+        if (!entry) {
+            return;
         }
-        
-        this.processing = false;
+
+        if (frame.flags & mbnet.FLAG_REFUSED) {
+            console.log('\x1b[33m%s\x1b[0m', '[Device Busy]', `${this.device} refused frame ${sequence}`);
+        }
+
+        clearTimeout(entry.timer);
+        this.inFlight.delete(sequence);
+        entry.item.pushResponse(frame.adu, entry.index);
+
+        const roundTrip_ms = Date.now() - entry.sentAt;
+        this.roundTrip_ms = this.roundTrip_ms === null ? roundTrip_ms : 0.8 * this.roundTrip_ms + 0.2 * roundTrip_ms;
+
+        if (entry.item.answeredPackets === entry.item.bufferRequests.length) {
+            this.complete(entry.item, false);
+        }
+        else {
+            this.triggerQueue();
+        }
+    }
+
+    /**
+     * Answers the client of a request and removes it from the queue, cancelling its frames still in flight.
+     * @param {ClientRequest} item - The finished request.
+     * @param {boolean} hasTimedOut - True if a frame of the request was not answered in time.
+     */
+    complete(item, hasTimedOut) {
+        for (const [sequence, entry] of this.inFlight) {
+            if (entry.item === item) {
+                clearTimeout(entry.timer);
+                this.inFlight.delete(sequence);
+            }
+        }
+
+        const position = this.items.indexOf(item);
+        if (position >= 0) {
+            this.items.splice(position, 1);
+        }
+
+        item.processClientResponse(hasTimedOut);
+        this.respond(item);
+        this.triggerQueue();
     }
 }
 
@@ -0,0 +1,211 @@
+/**
+ * RegisterCache - Recently Read Values Served Without Going Back to the Bus
+ * --------------------------------------------------------------------------
+ *
+ * Keeps the values read from, and written to, the devices' slaves, keyed by device, slave, data type
+ * and address, along with the time they were seen. A read whose every address holds a value younger
+ * than its staleness bound is answered from the cache, without touching the device queue.
+ *
+ * Key Functionalities:
+ * - **Staleness Bound**: Clients bound staleness per request with `maxAge` (milliseconds, 0 forces a
+ *   bus read). Requests without one use the cache policy: the most specific rule matching the
+ *   device, slave, data type and address range, or the default maximum age.
+ * - **Write-Through**: Successful writes update the entries they cover; failed writes invalidate them,
+ *   the state of the slave being unknown. Writes the broker does not encode invalidate the slave, as
+ *   do raw frames of any function that is not a read.
+ * - **Size Bound**: At most `maxEntries` values are kept; beyond that, the ones recorded longest ago
+ *   are dropped first.
+ * - **Metrics**: `metrics()` reports hits, misses, hit ratio, entries and an estimate of memory use.
+ *
+ * Policy rules, e.g. loaded from a JSON file:
+ *   [{ "device": "esp1", "maxAge_ms": 500 },
+ *    { "device": "esp1", "slave": 3, "datatype": "ni", "range": [0, 99], "maxAge_ms": 5000 }]
+ *
+ * Dependencies:
+ * - `@maps/keywordsMap`: Fields of the unified requests.
+ *
+ * Example:
+ * ----------------
+ * const cache = new RegisterCache(0, policy);
+ * const values = cache.lookup('esp1', request.content);
+ */
+
+require('module-alias/register');
+const { mb } = require('@maps/keywordsMap');
+
+class RegisterCache {
+
+    static entryFootprint = 96;     // Estimated bytes per entry: map slot, key and value record
+
+    // Functions of raw frames that only read, every other one may change the slave
+    static readFunctions = new Set([0x01, 0x02, 0x03, 0x04, 0x07, 0x08, 0x0B, 0x0C, 0x11, 0x14, 0x18, 0x2B]);
+
+    /**
+     * Creates an empty cache.
+     * @param {number} [defaultMaxAge_ms=0] - Maximum age used when neither the request nor a rule sets one.
+     * @param {Array} [policy=[]] - Maximum age rules, see the module description.
+     * @param {number} [maxEntries=100000] - Values kept at most, about 10 MB by `entryFootprint`.
+     */
+    constructor(defaultMaxAge_ms = 0, policy = [], maxEntries = 100000) {
+        this.defaultMaxAge_ms = defaultMaxAge_ms;
+        this.policy = policy;
+        this.maxEntries = maxEntries;
+        this.entries = new Map();   // "device/slave/datatype/address" -> { value, time }, oldest recorded first
+        this.hits = 0;
+        this.misses = 0;
+    }
+
+    /**
+     * Lists the addresses a read or write request targets, in the order of its values.
+     * @param {Object} content - Unified request.
+     * @returns {Array} - Addresses.
+     */
+    static addressesOf(content) {
+        if (content.hasOwnProperty(mb.RANGE_PROPERTY)) {
+            const [start, end] = content[mb.RANGE_PROPERTY];
+            return Array.from({ length: end - start + 1 }, (_, i) => start + i);
+        }
+        return content[mb.LIST_PROPERTY] ?? [];
+    }
+
+    /**
+     * Maximum age applying to a read, from the request itself or the policy.
+     * @param {string} device - Device name.
+     * @param {Object} content - Unified read request.
+     * @returns {number} - Maximum age in milliseconds.
+     */
+    maxAgeOf(device, content) {
+        if (content.hasOwnProperty(mb.MAX_AGE_PROPERTY)) {
+            return content[mb.MAX_AGE_PROPERTY];
+        }
+
+        const addresses = RegisterCache.addressesOf(content);
+        const first = Math.min(...addresses);
+        const last = Math.max(...addresses);
+        let best = null;
+        let bestScore = -1;
+
+        for (const rule of this.policy) {
+            const matches = rule.device === device
+                && (rule.slave === undefined || rule.slave === content[mb.ID_PROPERTY])
+                && (rule.datatype === undefined || rule.datatype === content[mb.DATATYPE_PROPERTY])
+                && (rule.range === undefined || (rule.range[0] <= first && last <= rule.range[1]));
+            const score = (rule.slave !== undefined) + (rule.datatype !== undefined) + (rule.range !== undefined);
+
+            if (matches && score > bestScore) {
+                best = rule;
+                bestScore = score;
+            }
+        }
+
+        return best ? best.maxAge_ms : this.defaultMaxAge_ms;
+    }
+
+    /**
+     * Looks a read up in the cache.
+     * @param {string} device - Device name.
+     * @param {Object} content - Unified read request.
+     * @returns {Array|null} - The values in the order of the request, or null unless all are fresh enough.
+     */
+    lookup(device, content) {
+        const maxAge_ms = this.maxAgeOf(device, content);
+        if (maxAge_ms <= 0 || this.entries.size === 0) {
+            this.misses++;
+            return null;
+        }
+
+        const oldest = Date.now() - maxAge_ms;
+        const prefix = `${device}/${content[mb.ID_PROPERTY]}/${content[mb.DATATYPE_PROPERTY]}/`;
+        const values = [];
+
+        for (const address of RegisterCache.addressesOf(content)) {
+            const entry = this.entries.get(prefix + address);
+            if (!entry || entry.time < oldest) {
+                this.misses++;
+                return null;
+            }
+            values.push(entry.value);
+        }
+
+        this.hits++;
+        return values;
+    }
+
+    /**
+     * Records the outcome of a finished request: values read or written, or invalidation.
+     * @param {string} device - Device name.
+     * @param {ClientRequest} request - The finished request.
+     */
+    record(device, request) {
+        const content = request.content;
+        const func = content[mb.FUNCTION_PROPERTY];
+
+        if (func === mb.MODBUS) {
+            // Raw frames may write anything on the slave
+            if (!RegisterCache.readFunctions.has(content[mb.PACKET_PROPERTY]?.[0])) {
+                this.invalidate(device, content[mb.ID_PROPERTY]);
+            }
+            return;
+        }
+        if (func !== mb.READ && func !== mb.WRITE) {
+            return;
+        }
+
+        const addresses = RegisterCache.addressesOf(content);
+        const prefix = `${device}/${content[mb.ID_PROPERTY]}/${content[mb.DATATYPE_PROPERTY]}/`;
+        const values = func === mb.READ ? request.fetchedData : content[mb.VALUES_PROPERTY];
+
+        if (!request.succeeded || !values) {
+            if (func === mb.WRITE) {
+                addresses.forEach((address) => this.entries.delete(prefix + address));
+            }
+            return;
+        }
+
+        // Re-inserted entries move to the end, so the oldest recorded are evicted first
+        const time = Date.now();
+        addresses.forEach((address, i) => {
+            this.entries.delete(prefix + address);
+            this.entries.set(prefix + address, { value: values[i], time });
+        });
+
+        for (const key of this.entries.keys()) {
+            if (this.entries.size <= this.maxEntries) {
+                break;
+            }
+            this.entries.delete(key);
+        }
+    }
+
+    /**
+     * Drops every entry of a slave, or of a whole device.
+     * @param {string} device - Device name.
+     * @param {number} [slave] - Slave address, the whole device if omitted.
+     */
+    invalidate(device, slave) {
+        const prefix = slave === undefined ? `${device}/` : `${device}/${slave}/`;
+        for (const key of this.entries.keys()) {
+            if (key.startsWith(prefix)) {
+                this.entries.delete(key);
+            }
+        }
+    }
+
+    /**
+     * Reports the effectiveness and size of the cache.
+     * @returns {Object} - Hits, misses, hit ratio, entries and estimated bytes.
+     */
+    metrics() {
+        const entries = this.entries.size;
+        const lookups = this.hits + this.misses;
+        return {
+            hits: this.hits,
+            misses: this.misses,
+            hitRatio: lookups ? this.hits / lookups : 0,
+            entries: entries,
+            bytes: entries * RegisterCache.entryFootprint,
+        };
+    }
+}
+
+module.exports = RegisterCache;
@@ -0,0 +1,53 @@
+/**
+ * RequestBatch - Combined Response of Requests Published Together
+ * ----------------------------------------------------------------
+ *
+ * Clients may publish an array of requests, in any mix of formats, as one message on the request
+ * topic rather than one message per request:
+ *
+ *   [{"id": 1, "fn": "r", "dt": "bo", "rg": [0, 15]}, {"id": 1, "fn": "r", "dt": "no", "ls": [3, 9]}]
+ *
+ * Each request is handled as it would have been on its own, and the gateway queues those needing
+ * the device together, so reads of the same slave and function are served by shared frames. The
+ * batch collects the responses, immediate or from the device, and publishes them as one array, in
+ * the order of the requests, once the last one is answered.
+ *
+ * Example:
+ * ----------------
+ * const batch = new RequestBatch(requests.length, (responses) => publish(responses));
+ * batch.answer(index, response);
+ */
+
+class RequestBatch {
+
+    static maxSize = 64;    // Requests per batch, as many may wait in a device queue at once
+
+    /**
+     * Creates a batch waiting for every response.
+     * @param {number} size - Number of requests in the batch.
+     * @param {Function} publishCallback - Publishes the responses, in the order of the requests.
+     */
+    constructor(size, publishCallback) {
+        this.responses = new Array(size);
+        this.pending = size;
+        this.publishCallback = publishCallback;
+    }
+
+    /**
+     * Records the response of one request, publishing the batch once every request is answered.
+     * @param {number} index - Position of the request in the batch.
+     * @param {Object} response - Response in the format of the request.
+     */
+    answer(index, response) {
+        if (this.responses[index] !== undefined) {
+            return;
+        }
+
+        this.responses[index] = response;
+        if (--this.pending === 0) {
+            this.publishCallback(this.responses);
+        }
+    }
+}
+
+module.exports = RequestBatch;
@@ -0,0 +1,205 @@
+/**
+ * SessionRegistry - Logged In Users, Devices and Their Subscribers
+ * -----------------------------------------------------------------
+ *
+ * Holds the sessions of the broker, indexed both by MQTT client id and by identifier, so that every
+ * login, subscription and authorization check is answered by a map lookup, whatever the number of
+ * clients connected.
+ *
+ * Key Functionalities:
+ * - **Sessions**: Each client id logged in maps to its identifier, whether it is a user or a device,
+ *   and the devices a user is allowed.
+ * - **Identifiers**: Each identifier maps to the client ids logged in as it. A device reconnecting
+ *   before its previous connection was closed briefly holds two.
+ * - **Subscribers**: Each device maps to the clients subscribed to its topics, and the topics each one
+ *   holds, so a client leaving is removed from the devices it subscribed to only.
+ *
+ * Example:
+ * ----------------
+ * const sessions = new SessionRegistry();
+ * sessions.login('client-1', 'alice.acme', ['plc-1'], false);
+ * sessions.isUser('alice.acme');  // true
+ * sessions.subscribe('client-1', 'plc-1', 'alice.acme/plc-1/response');
+ * sessions.logout('client-1');
+ */
+
+class SessionRegistry {
+
+    /**
+     * Creates an empty registry.
+     */
+    constructor() {
+        this.clients = new Map();       // Client id -> { identifier, devices, isDevice, subscriptions }
+        this.users = new Map();         // User identifier -> client ids
+        this.devices = new Map();       // Device identifier -> client ids
+        this.subscribers = new Map();   // Device identifier -> client id -> topics
+    }
+
+    /**
+     * Records a client logged in. A client id already logged in ends its previous session first, so
+     * no identifier keeps it.
+     * @param {string} clientId - The MQTT client id.
+     * @param {string} identifier - User or device identifier.
+     * @param {string[]} [devices] - Devices a user is allowed.
+     * @param {boolean} isDevice - True if the client is a device.
+     * @returns {Object|undefined} - The previous session of the client, as returned by `logout`.
+     */
+    login(clientId, identifier, devices, isDevice) {
+        const previous = this.clients.has(clientId) ? this.logout(clientId) : undefined;
+        this.clients.set(clientId, { identifier, devices, isDevice, subscriptions: new Set() });
+
+        const index = isDevice ? this.devices : this.users;
+        let clientIds = index.get(identifier);
+        if (!clientIds) {
+            clientIds = new Set();
+            index.set(identifier, clientIds);
+        }
+        clientIds.add(clientId);
+        return previous;
+    }
+
+    /**
+     * Forgets a client, with its subscriptions.
+     * @param {string} clientId - The MQTT client id.
+     * @returns {Object|undefined} - The session ended, with `lastOfIdentifier` telling whether no other
+     * client remains logged in as its identifier; undefined if the client was not logged in.
+     */
+    logout(clientId) {
+        const session = this.clients.get(clientId);
+        if (!session) {
+            return undefined;
+        }
+        this.clients.delete(clientId);
+
+        for (const device of session.subscriptions) {
+            this.removeSubscriber(device, clientId);
+        }
+
+        const index = session.isDevice ? this.devices : this.users;
+        const clientIds = index.get(session.identifier);
+        clientIds.delete(clientId);
+        session.lastOfIdentifier = clientIds.size === 0;
+        if (session.lastOfIdentifier) {
+            index.delete(session.identifier);
+        }
+
+        return session;
+    }
+
+    /**
+     * Gets the session of a client.
+     * @param {string} clientId - The MQTT client id.
+     * @returns {Object|undefined} - The session, if the client is logged in.
+     */
+    get(clientId) {
+        return this.clients.get(clientId);
+    }
+
+    /**
+     * Tells whether a user is logged in.
+     * @param {string} identifier - User identifier.
+     * @returns {boolean}
+     */
+    isUser(identifier) {
+        return this.users.has(identifier);
+    }
+
+    /**
+     * Tells whether a device is logged in.
+     * @param {string} identifier - Device identifier.
+     * @returns {boolean}
+     */
+    isDevice(identifier) {
+        return this.devices.has(identifier);
+    }
+
+    /**
+     * Gets a client logged in as a device, the first one if it reconnected.
+     * @param {string} identifier - Device identifier.
+     * @returns {string|undefined} - The client id, if the device is logged in.
+     */
+    clientOfDevice(identifier) {
+        return this.devices.get(identifier)?.values().next().value;
+    }
+
+    /**
+     * Records a client's subscription to one of a device's topics.
+     * @param {string} clientId - The MQTT client id.
+     * @param {string} device - Device identifier.
+     * @param {string} topic - The topic subscribed to.
+     */
+    subscribe(clientId, device, topic) {
+        const session = this.clients.get(clientId);
+        if (!session) {
+            return;
+        }
+
+        let clients = this.subscribers.get(device);
+        if (!clients) {
+            clients = new Map();
+            this.subscribers.set(device, clients);
+        }
+        let topics = clients.get(clientId);
+        if (!topics) {
+            topics = new Set();
+            clients.set(clientId, topics);
+        }
+        topics.add(topic);
+        session.subscriptions.add(device);
+    }
+
+    /**
+     * Forgets a client's subscription to one of a device's topics.
+     * @param {string} clientId - The MQTT client id.
+     * @param {string} device - Device identifier.
+     * @param {string} topic - The topic unsubscribed from.
+     */
+    unsubscribe(clientId, device, topic) {
+        const topics = this.subscribers.get(device)?.get(clientId);
+        if (!topics) {
+            return;
+        }
+
+        topics.delete(topic);
+        if (topics.size === 0) {
+            this.removeSubscriber(device, clientId);
+            this.clients.get(clientId)?.subscriptions.delete(device);
+        }
+    }
+
+    /**
+     * Gets the clients subscribed to a device's topics.
+     * @param {string} device - Device identifier.
+     * @returns {string[]} - Their client ids.
+     */
+    subscribersOf(device) {
+        return [...(this.subscribers.get(device)?.keys() ?? [])];
+    }
+
+    /**
+     * Removes a client from a device's subscribers.
+     * @param {string} device - Device identifier.
+     * @param {string} clientId - The MQTT client id.
+     */
+    removeSubscriber(device, clientId) {
+        const clients = this.subscribers.get(device);
+        if (!clients) {
+            return;
+        }
+
+        clients.delete(clientId);
+        if (clients.size === 0) {
+            this.subscribers.delete(device);
+        }
+    }
+
+    /**
+     * Number of clients logged in.
+     * @returns {number}
+     */
+    get size() {
+        return this.clients.size;
+    }
+}
+
+module.exports = SessionRegistry;
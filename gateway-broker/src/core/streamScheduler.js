@@ -0,0 +1,259 @@
+/**
+ * StreamScheduler - Periodic Reads Pushed to Subscribed Clients
+ * --------------------------------------------------------------
+ *
+ * Clients that want to follow values subscribe with a request of function `s` (`subscribe`) rather
+ * than re-publishing the same read in a loop:
+ *
+ *   {"id": 1, "fn": "s", "dt": "no", "rg": [0, 9], "pe": 1000, "db": 2, "ex": 600}
+ *
+ * `pe` is the poll period in milliseconds, `db` the deadband a numeric value must move by before it
+ * is published again (0 by default) and `ex` the lifetime of the subscription in seconds (600 by
+ * default, 0 cancels it). Subscribing again renews the subscription.
+ *
+ * The broker polls the addresses at background priority and publishes on `<client>/<device>/stream`
+ * only the values that changed for that client, `ls` listing their addresses and `fd` their values.
+ * A failing poll is reported once, with a false status, until the values come back.
+ *
+ * Key Functionalities:
+ * - **Shared Polls**: Identical subscriptions of different clients (same device, slave, data type,
+ *   addresses and period) share one poll; deadband and change tracking stay per client.
+ * - **Client Lifetime**: Subscriptions end with the client's session, not only when they expire.
+ * - **Central Scheduling**: A single timer serves every poll. Each poll starts at a random phase
+ *   within its period, so subscriptions made together do not poll the bus in bursts. A poll still
+ *   in flight when it is due again skips that round.
+ *
+ * Dependencies:
+ * - `@maps/keywordsMap`: Fields of the unified requests, and their names in the client's format.
+ * - `@validator/binaryFormat`: Encodes the stream messages of binary subscriptions.
+ * - `pollCallback` and `publishCallback`: Assigned by the gateway to queue polls and publish messages.
+ *
+ * Example:
+ * ----------------
+ * const streams = new StreamScheduler();
+ * streams.subscribe('user', 'esp1', content, originalContent, 'terse');
+ */
+
+require('module-alias/register');
+const { mb, getKey }            = require('@maps/keywordsMap');
+const BinaryFormat              = require('@validator/binaryFormat');
+
+class StreamScheduler {
+
+    static defaultExpiry_s = 600;
+
+    constructor() {
+        this.polls = new Map();     // Poll key -> poll
+        this.timer = null;
+        this.pollCallback = null;
+        this.publishCallback = null;
+    }
+
+    /**
+     * Identifies the poll serving a subscription.
+     * @param {string} device - Device name.
+     * @param {Object} content - Unified subscription request.
+     * @returns {string} - Poll key.
+     */
+    static keyOf(device, content) {
+        return [device, content[mb.ID_PROPERTY], content[mb.DATATYPE_PROPERTY], content[mb.PERIOD_PROPERTY],
+            StreamScheduler.addressesOf(content).join(',')].join('|');
+    }
+
+    /**
+     * Lists the addresses a subscription follows, in ascending order.
+     * @param {Object} content - Unified subscription request.
+     * @returns {Array} - Addresses.
+     */
+    static addressesOf(content) {
+        if (content.hasOwnProperty(mb.RANGE_PROPERTY)) {
+            const [start, end] = content[mb.RANGE_PROPERTY];
+            return Array.from({ length: end - start + 1 }, (_, i) => start + i);
+        }
+        return [...content[mb.LIST_PROPERTY]].sort((a, b) => a - b);
+    }
+
+    /**
+     * Registers, renews or cancels a client's subscription.
+     * @param {string} client - Client name.
+     * @param {string} device - Device name.
+     * @param {Object} content - Unified subscription request.
+     * @param {Object} originalContent - Request as published, to format stream messages alike.
+     * @param {string} format - Format of the request, verbose, terse or binary.
+     */
+    subscribe(client, device, content, originalContent, format) {
+        const key = StreamScheduler.keyOf(device, content);
+        const expiry_s = content[mb.EXPIRY_PROPERTY] ?? StreamScheduler.defaultExpiry_s;
+
+        if (expiry_s === 0) {
+            this.polls.get(key)?.subscribers.delete(client);
+            return;
+        }
+
+        if (!this.polls.has(key)) {
+            const addresses = StreamScheduler.addressesOf(content);
+            const period_ms = content[mb.PERIOD_PROPERTY];
+
+            this.polls.set(key, {
+                key: key,
+                device: device,
+                period_ms: period_ms,
+                nextDue: Date.now() + Math.random() * period_ms,
+                inFlight: false,
+                addresses: addresses,
+                content: {
+                    [mb.ID_PROPERTY]: content[mb.ID_PROPERTY],
+                    [mb.FUNCTION_PROPERTY]: mb.READ,
+                    [mb.DATATYPE_PROPERTY]: content[mb.DATATYPE_PROPERTY],
+                    [mb.LIST_PROPERTY]: addresses,
+                },
+                subscribers: new Map(),
+            });
+        }
+
+        const poll = this.polls.get(key);
+        const subscriber = poll.subscribers.get(client) ?? { sent: new Map(), failing: false };
+
+        poll.subscribers.set(client, Object.assign(subscriber, {
+            deadband: content[mb.DEADBAND_PROPERTY] ?? 0,
+            expiresAt: Date.now() + 1000 * expiry_s,
+            originalContent: originalContent,
+            format: format,
+        }));
+
+        this.arm();
+    }
+
+    /**
+     * Cancels every subscription of a client, as when it disconnects.
+     * @param {string} client - Client name.
+     */
+    unsubscribeClient(client) {
+        for (const [key, poll] of this.polls) {
+            poll.subscribers.delete(client);
+            if (poll.subscribers.size === 0) {
+                this.polls.delete(key);
+            }
+        }
+        this.arm();
+    }
+
+    /**
+     * Arms the timer for the earliest poll due.
+     */
+    arm() {
+        clearTimeout(this.timer);
+        this.timer = null;
+
+        if (this.polls.size === 0) {
+            return;
+        }
+
+        let nextDue = Infinity;
+        for (const poll of this.polls.values()) {
+            nextDue = Math.min(nextDue, poll.nextDue);
+        }
+        this.timer = setTimeout(() => this.run(), Math.max(0, nextDue - Date.now()));
+    }
+
+    /**
+     * Drops expired subscriptions and queues the polls that are due.
+     */
+    run() {
+        const now = Date.now();
+
+        for (const [key, poll] of this.polls) {
+            for (const [client, subscriber] of poll.subscribers) {
+                if (subscriber.expiresAt <= now) {
+                    poll.subscribers.delete(client);
+                }
+            }
+            if (poll.subscribers.size === 0) {
+                this.polls.delete(key);
+                continue;
+            }
+            if (poll.nextDue > now) {
+                continue;
+            }
+
+            // Keep the phase, skipping the rounds missed while the event loop was busy
+            poll.nextDue += poll.period_ms * Math.max(1, Math.ceil((now - poll.nextDue) / poll.period_ms));
+
+            if (!poll.inFlight) {
+                poll.inFlight = this.pollCallback(poll);
+            }
+        }
+
+        this.arm();
+    }
+
+    /**
+     * Publishes to each subscriber of a poll the values that changed for it.
+     * @param {Object} poll - The poll that completed.
+     * @param {Array|null} values - Values read in the order of `poll.addresses`, null if the poll failed.
+     * @param {string} [message] - Error reported when the poll failed.
+     */
+    onPollResult(poll, values, message = 'Error Retrieving Data') {
+        poll.inFlight = false;
+        const isNumeric = [mb.NUMERIC_INPUT, mb.NUMERIC_OUTPUT].includes(poll.content[mb.DATATYPE_PROPERTY]);
+
+        for (const [client, subscriber] of poll.subscribers) {
+            const streamObject = {
+                [mb.ID_PROPERTY]: poll.content[mb.ID_PROPERTY],
+                [mb.FUNCTION_PROPERTY]: mb.SUBSCRIBE,
+                [mb.DATATYPE_PROPERTY]: poll.content[mb.DATATYPE_PROPERTY],
+            };
+
+            if (!values) {
+                if (subscriber.failing) {
+                    continue;
+                }
+                subscriber.failing = true;
+                streamObject[mb.STATUS] = false;
+                streamObject[mb.MESSAGE] = message;
+            }
+            else {
+                const changed = [];
+                poll.addresses.forEach((address, i) => {
+                    const last = subscriber.sent.get(address);
+                    const moved = isNumeric ? Math.abs(values[i] - last) > subscriber.deadband : values[i] !== last;
+                    if (last === undefined || moved) {
+                        subscriber.sent.set(address, values[i]);
+                        changed.push(i);
+                    }
+                });
+
+                if (changed.length === 0 && !subscriber.failing) {
+                    continue;
+                }
+                subscriber.failing = false;
+                streamObject[mb.LIST_PROPERTY] = changed.map((i) => poll.addresses[i]);
+                streamObject[mb.FETCHED_DATA] = changed.map((i) => values[i]);
+                streamObject[mb.STATUS] = true;
+            }
+
+            this.publishCallback(client, poll.device, StreamScheduler.format(streamObject, subscriber));
+        }
+    }
+
+    /**
+     * Renames the fields of a stream message to the subscriber's format, echoing the identifying
+     * fields of its subscription as published.
+     * @param {Object} streamObject - Unified stream message.
+     * @param {Object} subscriber - The subscriber.
+     * @returns {Object|Buffer} - Stream message in the subscriber's format, encoded for binary subscribers.
+     */
+    static format(streamObject, subscriber) {
+        const echoed = [mb.ID_PROPERTY, mb.FUNCTION_PROPERTY, mb.DATATYPE_PROPERTY];
+
+        const message = Object.keys(streamObject).reduce((accumulator, key) => {
+            const formattedKey = getKey(key, subscriber.format);
+            accumulator[formattedKey] = echoed.includes(key) ? subscriber.originalContent[formattedKey] : streamObject[key];
+            return accumulator;
+        }, {});
+
+        return subscriber.format === 'binary' ? BinaryFormat.encode(message) : message;
+    }
+}
+
+module.exports = StreamScheduler;
@@ -0,0 +1,241 @@
+/**
+ * UdpEndpoint - Datagram Transport to Gateway Devices on the Same LAN
+ * --------------------------------------------------------------------
+ *
+ * Devices announcing a UDP port in their capability record can exchange Modbus frames as single
+ * datagrams, skipping TCP and the QoS 2 handshake of the mbnet topic. MQTT remains the control
+ * plane: the broker opens a session, hands its token to the device over the control topic, and only
+ * sends datagrams once the device has acknowledged it. Only the device may read its control topic,
+ * and the token is never relayed for users, so no other client learns or replaces it. Datagrams are
+ * laid out as
+ *
+ *   version (u8) | type (u8) | token (4 bytes) | sequence (u16, big-endian) | mbnet tag | ADU
+ *
+ * Key Functionalities:
+ * - **Sessions**: One per device, identified by a random token so stray or spoofed datagrams are
+ *   dropped.
+ * - **Retransmission**: A request is sent again after an RTO of twice the smoothed round trip
+ *   (clamped to `minRto_ms`..`maxRto_ms`), doubling on each attempt until its deadline. The device
+ *   answers retransmissions from a cache, so writes are never executed twice.
+ * - **Fallback**: A request left unanswered until its deadline deactivates the session, and the
+ *   device is reached over MQTT again until it announces itself anew.
+ *
+ * Example:
+ * ----------------
+ * const udp = new UdpEndpoint(5020);
+ * udp.onResponse((device, response) => queue.items[0].pushResponse(response));
+ * udp.start();
+ */
+
+const dgram = require('dgram');
+const crypto = require('crypto');
+
+class UdpEndpoint {
+
+    static VERSION = 1;
+    static TYPE_REQUEST = 0x01;
+    static TYPE_RESPONSE = 0x02;
+    static HEADER_SIZE = 8;             // Bytes before the mbnet tag
+    static CONTROL_SESSION = 0x05;      // Control command handing the session token to the device
+
+    static minRto_ms = 5;
+    static maxRto_ms = 200;
+
+    /**
+     * Initializes the endpoint without binding it.
+     * @param {number} [port=0] - Local port datagrams are sent from, any if 0.
+     */
+    constructor(port = 0) {
+        this.port = port;
+        this.socket = null;
+        this.sessions = new Map();      // Device name -> session
+        this.tokens = new Map();        // Token (hex) -> device name
+        this.responseCallback = null;
+    }
+
+    /**
+     * Binds the socket and starts listening for device responses.
+     */
+    start() {
+        this.socket = dgram.createSocket('udp4');
+        this.socket.on('message', this.onDatagram.bind(this));
+        this.socket.on('error', (err) => {
+            console.log('\x1b[31m%s\x1b[0m', '[UDP Error]', err.message);
+        });
+        this.socket.bind(this.port, () => {
+            console.log('\x1b[32m%s\x1b[0m', '[UDP Endpoint]', `listening on port ${this.socket.address().port}`);
+        });
+    }
+
+    /**
+     * Registers a callback for device responses.
+     * @param {Function} callback - Called with the device name and the mbnet payload (tag and ADU).
+     */
+    onResponse(callback) {
+        this.responseCallback = callback;
+    }
+
+    /**
+     * Opens a session with a device, replacing any previous one. The session carries no traffic
+     * until `activate` is called.
+     * @param {string} device - Device name.
+     * @param {string} address - IPv4 address of the device.
+     * @param {number} port - UDP port announced by the device.
+     * @returns {Buffer} - Session token to hand to the device.
+     */
+    openSession(device, address, port) {
+        this.closeSession(device);
+
+        const token = crypto.randomBytes(4);
+        this.sessions.set(device, {
+            token: token,
+            address: address,
+            port: port,
+            active: false,
+            sequence: crypto.randomInt(0x10000),
+            srtt_ms: null,
+            pending: null,
+        });
+        this.tokens.set(token.toString('hex'), device);
+        return token;
+    }
+
+    /**
+     * Starts sending a device's frames as datagrams, once it acknowledged the session token.
+     * @param {string} device - Device name.
+     */
+    activate(device) {
+        const session = this.sessions.get(device);
+        if (session) {
+            session.active = true;
+            console.log('\x1b[32m%s\x1b[0m', '[UDP Session]', `${device} at ${session.address}:${session.port}`);
+        }
+    }
+
+    /**
+     * Checks whether a device's frames are sent as datagrams.
+     * @param {string} device - Device name.
+     * @returns {boolean} - True if the device has an active session.
+     */
+    isActive(device) {
+        return this.sessions.get(device)?.active ?? false;
+    }
+
+    /**
+     * Closes a device's session, its frames are published over MQTT again.
+     * @param {string} device - Device name.
+     */
+    closeSession(device) {
+        const session = this.sessions.get(device);
+        if (!session) {
+            return;
+        }
+
+        clearTimeout(session.pending?.timer);
+        this.tokens.delete(session.token.toString('hex'));
+        this.sessions.delete(device);
+    }
+
+    /**
+     * Sends a frame to a device, retransmitting it until answered or until its deadline.
+     * @param {string} device - Device name, must have an active session.
+     * @param {Buffer} packet - Modbus ADU without CRC.
+     * @param {number} tag - mbnet tag byte of the frame.
+     * @param {number} deadline_ms - Time after which the device is deemed unreachable over UDP.
+     */
+    send(device, packet, tag, deadline_ms) {
+        const session = this.sessions.get(device);
+        clearTimeout(session.pending?.timer);
+
+        session.sequence = (session.sequence + 1) & 0xFFFF;
+
+        const datagram = Buffer.alloc(UdpEndpoint.HEADER_SIZE + 1 + packet.length);
+        datagram[0] = UdpEndpoint.VERSION;
+        datagram[1] = UdpEndpoint.TYPE_REQUEST;
+        session.token.copy(datagram, 2);
+        datagram.writeUInt16BE(session.sequence, 6);
+        datagram[UdpEndpoint.HEADER_SIZE] = tag;
+        packet.copy(datagram, UdpEndpoint.HEADER_SIZE + 1);
+
+        const rto_ms = session.srtt_ms === null ? UdpEndpoint.maxRto_ms
+            : Math.min(Math.max(2 * session.srtt_ms, UdpEndpoint.minRto_ms), UdpEndpoint.maxRto_ms);
+
+        session.pending = {
+            sequence: session.sequence,
+            datagram: datagram,
+            sentAt: Date.now(),
+            deadline: Date.now() + deadline_ms,
+            rto_ms: rto_ms,
+            retransmitted: false,
+            timer: null,
+        };
+
+        this.transmit(device, session);
+    }
+
+    /**
+     * Sends the pending datagram of a session and arms its retransmission timer.
+     * @param {string} device - Device name.
+     * @param {Object} session - Session holding the pending datagram.
+     */
+    transmit(device, session) {
+        const pending = session.pending;
+        this.socket.send(pending.datagram, session.port, session.address);
+
+        const remaining = pending.deadline - Date.now();
+        pending.timer = setTimeout(() => {
+            if (session.pending !== pending) {
+                return;
+            }
+
+            if (Date.now() >= pending.deadline) {
+                // The path is broken, the device has to be reached over MQTT again
+                console.log('\x1b[33m%s\x1b[0m', '[UDP Fallback]', `${device} did not answer, using MQTT`);
+                session.pending = null;
+                session.active = false;
+                return;
+            }
+
+            pending.retransmitted = true;
+            pending.rto_ms = Math.min(2 * pending.rto_ms, UdpEndpoint.maxRto_ms);
+            this.transmit(device, session);
+        }, Math.max(Math.min(pending.rto_ms, remaining), 0));
+    }
+
+    /**
+     * Validates a datagram received from a device and hands over the response it carries.
+     * @param {Buffer} datagram - Received datagram.
+     */
+    onDatagram(datagram) {
+        if (datagram.length <= UdpEndpoint.HEADER_SIZE + 1) {
+            return;
+        }
+        if (datagram[0] !== UdpEndpoint.VERSION || datagram[1] !== UdpEndpoint.TYPE_RESPONSE) {
+            return;
+        }
+
+        const device = this.tokens.get(datagram.toString('hex', 2, 6));
+        const session = this.sessions.get(device);
+        const pending = session?.pending;
+
+        // Late answers to retransmissions of a completed request are dropped
+        if (!pending || datagram.readUInt16BE(6) !== pending.sequence) {
+            return;
+        }
+
+        clearTimeout(pending.timer);
+        session.pending = null;
+
+        // Only unambiguous samples feed the round trip estimate
+        if (!pending.retransmitted) {
+            const rtt_ms = Date.now() - pending.sentAt;
+            session.srtt_ms = session.srtt_ms === null ? rtt_ms : 0.875 * session.srtt_ms + 0.125 * rtt_ms;
+        }
+
+        if (this.responseCallback) {
+            this.responseCallback(device, Buffer.from(datagram.subarray(UdpEndpoint.HEADER_SIZE)));
+        }
+    }
+}
+
+module.exports = UdpEndpoint;
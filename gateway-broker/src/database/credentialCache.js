@@ -0,0 +1,70 @@
+/**
+ * CredentialCache - Short-Lived Memory of Verified Passwords
+ * -----------------------------------------------------------
+ *
+ * bcrypt is slow by design, and every login pays for it on the shared libuv threadpool. When many
+ * clients reconnect at once, as gateways do after an outage, the comparisons queue behind each other.
+ * This cache remembers, for a while, which password was last verified for each identifier, so that a
+ * client logging in again with the same password is checked in memory.
+ *
+ * Key Functionalities:
+ * - **Keyed Digests**: Passwords are never kept; only an HMAC-SHA256 of them under a key drawn at start
+ *   up, which never leaves the process, compared in constant time.
+ * - **Bound to the Hash**: An entry only holds for the stored hash it was verified against, so a
+ *   password change in the database voids it.
+ * - **Successes Only**: Failed attempts are not remembered, and always go through bcrypt.
+ * - **Bounded**: Entries expire after `ttl_ms`, and the oldest are dropped beyond `maxEntries`.
+ *
+ * Example:
+ * ----------------
+ * const credentials = new CredentialCache();
+ * const match = await credentials.verify('alice.acme', password, user.hashedPassword);
+ */
+
+const crypto = require('crypto');
+const bcrypt = require('bcrypt');
+
+class CredentialCache {
+
+    static key = crypto.randomBytes(32);
+
+    /**
+     * Creates an empty cache.
+     * @param {number} ttl_ms - Time a verified password is remembered.
+     * @param {number} maxEntries - Identifiers remembered at most.
+     */
+    constructor(ttl_ms = 600000, maxEntries = 10000) {
+        this.ttl_ms = ttl_ms;
+        this.maxEntries = maxEntries;
+        this.entries = new Map();   // Identifier -> { digest, hashedPassword, expiresAt }, oldest first
+    }
+
+    /**
+     * Checks a password against a stored hash, in memory if it was recently verified.
+     * @param {string} identifier - User or device identifier.
+     * @param {string} password - The password given.
+     * @param {string} hashedPassword - The stored bcrypt hash.
+     * @returns {boolean} - True if the password matches.
+     */
+    async verify(identifier, password, hashedPassword) {
+        const digest = crypto.createHmac('sha256', CredentialCache.key).update(password).digest();
+        const entry = this.entries.get(identifier);
+
+        if (entry && entry.hashedPassword === hashedPassword && entry.expiresAt > Date.now()
+            && crypto.timingSafeEqual(entry.digest, digest)) {
+            return true;
+        }
+
+        const match = await bcrypt.compare(password, hashedPassword);
+        if (match) {
+            this.entries.delete(identifier);
+            this.entries.set(identifier, { digest, hashedPassword, expiresAt: Date.now() + this.ttl_ms });
+            if (this.entries.size > this.maxEntries) {
+                this.entries.delete(this.entries.keys().next().value);
+            }
+        }
+        return match;
+    }
+}
+
+module.exports = CredentialCache;
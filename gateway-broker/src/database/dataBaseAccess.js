@@ -16,11 +16,15 @@
  *   has authorized entry.
  * - **Topic Permissions**: Retrieves and verifies permitted topics for each user, ensuring they access
  *   only allowed resources.
+ * - **Caching**: Organizations are served from a `PrincipalCache`, kept fresh by a change stream and
+ *   version stamps, and recently verified passwords from a `CredentialCache`, so that reconnect storms
+ *   are served mostly from memory instead of MongoDB and bcrypt.
  * 
  * Dependencies:
  * - `mongoose`: Manages the MongoDB connection and schema-based document handling.
- * - `bcrypt`: Secures passwords by comparing hashed passwords for authentication.
  * - `@schemas/orgSchemas`: Defines organization schema structure, managing users and devices.
+ * - `@database/principalCache`: Indexes organization users and devices in memory.
+ * - `@database/credentialCache`: Remembers verified passwords, comparing them through bcrypt otherwise.
  *
  * Usage in TCC System:
  * 1. Instantiate `DBAccess` with a MongoDB URI to initialize the database connection.
@@ -38,8 +42,9 @@
 
 require('module-alias/register');
 const mongoose = require('mongoose');
-const bcrypt = require('bcrypt');
 const Organization = require('@schemas/orgSchemas');
+const PrincipalCache = require('@database/principalCache');
+const CredentialCache = require('@database/credentialCache');
 
 class DBAccess {
     /**
@@ -48,6 +53,12 @@ class DBAccess {
      */
     constructor(dbUri) {
         this.dbUri = dbUri;
+
+        this.principals = new PrincipalCache();
+        this.principals.loadCallback = (organizationName) => Organization.findOne({ organizationName }).lean();
+        this.principals.versionCallback = (organizationName) => Organization.findOne({ organizationName }, { updatedAt: 1 }).lean();
+        this.credentials = new CredentialCache();
+
         this.connectToDB();
     }
 
@@ -59,19 +70,38 @@ class DBAccess {
         try {
             await mongoose.connect(this.dbUri, {});
             console.log('\x1b[32m%s\x1b[0m', '[Database]', 'Connected Successfully');
+            this.watchOrganizations();
         } catch (err) {
             console.log('\x1b[31m%s\x1b[0m', '[Database]', err);
         }
     }
 
     /**
-     * Fetches an organization by name from the database.
+     * Drops cached organizations as soon as they change, through a change stream. Change streams need
+     * a replica set; on a standalone server the stream fails and change stamps alone keep the cache fresh.
+     */
+    watchOrganizations() {
+        try {
+            const stream = Organization.watch();
+            stream.on('change', (change) => this.principals.invalidate(change.documentKey?._id));
+            stream.on('error', (error) => {
+                console.log('\x1b[33m%s\x1b[0m', '[Database]', `Change stream unavailable: ${error.message}`);
+                this.principals.clear();
+                stream.close().catch(() => {});
+            });
+        } catch (error) {
+            console.log('\x1b[33m%s\x1b[0m', '[Database]', `Change stream unavailable: ${error.message}`);
+        }
+    }
+
+    /**
+     * Fetches an organization by name, from the cache or the database.
      * @param {string} organizationName - The name of the organization to retrieve.
-     * @returns {Object|null} - The organization object if found; otherwise, null.
+     * @returns {Object|null} - The organization, its users and devices by username and token, if found; otherwise, null.
      */
     async getOrganization(organizationName) {
         try {
-            const organization = await Organization.findOne({ organizationName }).lean();
+            const organization = await this.principals.organization(organizationName);
             if (!organization) {
                 console.log('\x1b[31m%s\x1b[0m', '[Database]', `${organizationName} not found`);
                 return null;
@@ -103,12 +133,12 @@ class DBAccess {
                 return { success: false, message: 'Organization not found' };
             }
 
-            const user = organization.users.find(user => user.username === username);
+            const user = organization.users.get(username);
             if (!user) {
                 return { success: false, message: 'User not found' };
             }
 
-            const passwordMatch = await bcrypt.compare(password, user.hashedPassword);
+            const passwordMatch = await this.credentials.verify(identifier, password, user.hashedPassword);
             return passwordMatch
                 ? { success: true, identifier: identifier, devices: user.allowedDevices }
                 : { success: false, message: 'Incorrect password' };
@@ -138,12 +168,12 @@ class DBAccess {
                 return { success: false, message: 'Organization not found' };
             }
 
-            const device = organization.devices.find(device => device.token === token);
+            const device = organization.devices.get(token);
             if (!device) {
                 return { success: false, message: 'Device not found' };
             }
 
-            const passwordMatch = await bcrypt.compare(password, device.hashedPassword);
+            const passwordMatch = await this.credentials.verify(identifier, password, device.hashedPassword);
             return passwordMatch
                 ? { success: true, identifier: identifier }
                 : { success: false, message: 'Incorrect device password' };
@@ -166,7 +196,7 @@ class DBAccess {
                 return { success: false, message: `Organization ${organizationName} not found` };
             }
 
-            const user = organization.users.find(user => user.username === username);
+            const user = organization.users.get(username);
             return user
                 ? { success: true, topics: user.allowedDevices }
                 : { success: false, message: `User ${username} not found in organization ${organizationName}` };
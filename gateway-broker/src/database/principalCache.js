@@ -0,0 +1,152 @@
+/**
+ * PrincipalCache - In-Memory Index of Organization Users and Devices
+ * -------------------------------------------------------------------
+ *
+ * Keeps the users and devices of each organization in memory, indexed by username and by device
+ * token, so that logins and topic permission checks neither load the whole organization document
+ * nor search its users and devices one by one.
+ *
+ * Key Functionalities:
+ * - **Indexing**: An organization is loaded once and its users and devices are kept in maps.
+ * - **Shared Loads**: Clients asking for an organization being loaded wait for that same load, so a
+ *   reconnect storm of one organization costs a single query.
+ * - **Freshness**: An entry is trusted for `revalidate_ms`. Past that, only the organization's change
+ *   stamp (`updatedAt`, set by Mongoose on every save and update) is read, and the organization is
+ *   loaded again if it changed or if the entry is older than `maxAge_ms`, which also catches writes
+ *   made outside Mongoose. Changes reported by a MongoDB change stream drop the entry at once.
+ * - **Outages**: While the database cannot be reached, the last loaded entry keeps being served, for
+ *   at most `staleLimit_ms` after it was last confirmed.
+ *
+ * Example:
+ * ----------------
+ * const principals = new PrincipalCache();
+ * principals.loadCallback = (name) => Organization.findOne({ organizationName: name }).lean();
+ * principals.versionCallback = (name) => Organization.findOne({ organizationName: name }, { updatedAt: 1 }).lean();
+ * const user = (await principals.organization('acme'))?.users.get('alice');
+ */
+
+class PrincipalCache {
+
+    /**
+     * Creates an empty cache. `loadCallback` and `versionCallback` must be set before use.
+     * @param {number} revalidate_ms - Time an entry is trusted without asking the database.
+     * @param {number} maxAge_ms - Time after which an entry is loaded again, even if its stamp is unchanged.
+     * @param {number} staleLimit_ms - Time an entry may be served past its last confirmation while the
+     * database cannot be reached.
+     */
+    constructor(revalidate_ms = 5000, maxAge_ms = 60000, staleLimit_ms = 300000) {
+        this.revalidate_ms = revalidate_ms;
+        this.maxAge_ms = maxAge_ms;
+        this.staleLimit_ms = staleLimit_ms;
+        this.organizations = new Map();     // Name -> indexed organization
+        this.loading = new Map();           // Name -> pending refresh
+        this.generation = 0;                // Bumped by invalidations, voiding refreshes started before
+        this.loadCallback = null;           // Name -> organization document, or null
+        this.versionCallback = null;        // Name -> { _id, updatedAt }, or null
+    }
+
+    /**
+     * Gets an organization, loading or revalidating it when needed.
+     * @param {string} organizationName - The name of the organization.
+     * @returns {Object|null} - The indexed organization, or null if it does not exist.
+     * @throws {Error} - If the database fails and the organization was never loaded, or was last
+     * confirmed more than `staleLimit_ms` ago.
+     */
+    async organization(organizationName) {
+        const entry = this.organizations.get(organizationName);
+        if (entry && Date.now() - entry.checkedAt < this.revalidate_ms) {
+            return entry;
+        }
+
+        let pending = this.loading.get(organizationName);
+        if (!pending) {
+            pending = this.refresh(organizationName, entry)
+                .finally(() => this.loading.delete(organizationName));
+            this.loading.set(organizationName, pending);
+        }
+        return pending;
+    }
+
+    /**
+     * Revalidates an entry through its change stamp, or loads the organization again.
+     * @param {string} organizationName - The name of the organization.
+     * @param {Object} [entry] - The entry held so far.
+     * @returns {Object|null} - The indexed organization, or null if it does not exist.
+     */
+    async refresh(organizationName, entry) {
+        const generation = this.generation;
+
+        try {
+            if (entry && Date.now() - entry.loadedAt < this.maxAge_ms) {
+                const stamp = await this.versionCallback(organizationName);
+                if (stamp && String(stamp._id) === entry.id && PrincipalCache.stamp(stamp) === entry.stamp) {
+                    entry.checkedAt = Date.now();
+                    return entry;
+                }
+            }
+
+            const document = await this.loadCallback(organizationName);
+            const fresh = document ? PrincipalCache.index(document) : null;
+            if (generation === this.generation) {
+                fresh ? this.organizations.set(organizationName, fresh) : this.organizations.delete(organizationName);
+            }
+            return fresh;
+        }
+        catch (error) {
+            if (!entry || Date.now() - entry.checkedAt >= this.staleLimit_ms) {
+                throw error;
+            }
+            console.log('\x1b[33m%s\x1b[0m', '[Principal Cache]', `Serving ${organizationName} as last loaded: ${error.message}`);
+            return entry;
+        }
+    }
+
+    /**
+     * Drops an organization, as reported changed by a change stream.
+     * @param {*} organizationId - The `_id` of the organization.
+     */
+    invalidate(organizationId) {
+        this.generation++;
+        for (const [name, entry] of this.organizations) {
+            if (entry.id === String(organizationId)) {
+                this.organizations.delete(name);
+            }
+        }
+    }
+
+    /**
+     * Drops every organization, as when a change stream fails and changes may have been missed.
+     */
+    clear() {
+        this.generation++;
+        this.organizations.clear();
+    }
+
+    /**
+     * Indexes an organization document.
+     * @param {Object} document - The organization, as stored.
+     * @returns {Object} - Its id, change stamp, and users and devices by username and token.
+     */
+    static index(document) {
+        const now = Date.now();
+        return {
+            id: String(document._id),
+            stamp: PrincipalCache.stamp(document),
+            users: new Map((document.users ?? []).map((user) => [user.username, user])),
+            devices: new Map((document.devices ?? []).map((device) => [device.token, device])),
+            loadedAt: now,
+            checkedAt: now,
+        };
+    }
+
+    /**
+     * Change stamp of an organization, 0 for documents saved before timestamps were kept.
+     * @param {Object} document - The organization, or its stamp fields.
+     * @returns {number} - Time of its last update, in milliseconds.
+     */
+    static stamp(document) {
+        return document.updatedAt ? new Date(document.updatedAt).getTime() : 0;
+    }
+}
+
+module.exports = PrincipalCache;
@@ -4,10 +4,12 @@
  * 
  * This module provides keyword mappings for Modbus requests in the MQTT-Modbus gateway system.
  * It processes keywords from the `modbusKeywords` JSON file and creates mappings for terse
- * and verbose formats, allowing retrieval of keys based on format type.
+ * and verbose formats, allowing retrieval of keys based on format type. Every table is compiled once,
+ * at load time, and frozen: translating a keyword is a single property lookup.
  *
  * Exports:
  * - `mb`: Object mapping keyword identifiers to their terse format.
+ * - `keywordNames`: Name of each terse keyword in the `terse` and `verbose` formats.
  * - `getKey`: Function to retrieve a keyword in either terse or verbose format based on a value.
  * 
  * Dependencies:
@@ -27,21 +29,40 @@ require('module-alias/register');
 const modbusKeywords = require('@keywords/modbusKeywords.json');
 
 // Map keywords to their terse format representations
-const mb = Object.entries(modbusKeywords).reduce((accumulator, entry) => {
+const mb = Object.freeze(Object.entries(modbusKeywords).reduce((accumulator, entry) => {
     accumulator[entry[0]] = entry[1][0];
     return accumulator;
-}, {});
+}, {}));
+
+/**
+ * Compiles the name of each terse keyword in a format. Tables have no prototype, so that no
+ * inherited property answers for an unknown keyword.
+ * 
+ * @param {number} formatId - Position of the format in the keyword entries, 0 terse and 1 verbose.
+ * @returns {Object} - Frozen table from terse keyword to its name in the format.
+ */
+function compileNames(formatId) {
+    const names = Object.create(null);
+    for (const entry of Object.values(modbusKeywords)) {
+        names[entry[0]] ??= entry[formatId];
+    }
+    return Object.freeze(names);
+}
+
+const keywordNames = Object.freeze({
+    terse: compileNames(0),
+    verbose: compileNames(1),
+});
 
 /**
  * Retrieves the keyword in the specified format (terse or verbose).
  * 
  * @param {string} mbValue - The Modbus keyword value to map.
- * @param {string} format - The format type ('terse' or 'verbose').
+ * @param {string} format - The format type ('terse', 'verbose' or 'binary', which uses terse names).
  * @returns {string} - The keyword in the specified format.
  */
 function getKey(mbValue, format) {
-    const formatId = (format === 'terse') ? 0 : 1;
-    return modbusKeywords[Object.keys(mb).find(key => mb[key] === mbValue)][formatId];
+    return (format === 'terse' || format === 'binary' ? keywordNames.terse : keywordNames.verbose)[mbValue];
 }
 
-module.exports = { mb, getKey };
+module.exports = { mb, keywordNames, getKey };
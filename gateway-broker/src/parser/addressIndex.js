@@ -0,0 +1,52 @@
+/**
+ * AddressIndex - Position of Each Address in a Request's List
+ * -------------------------------------------------------------
+ *
+ * List requests name their addresses in any order, while frames cover them in ascending ranges.
+ * Both the bufferizer, writing a list's values into the frames, and the response decoder, placing
+ * the values read back in the order of the list, need the position of an address in the list.
+ *
+ * Modbus addresses span at most 65536 points, so positions are kept in a typed array indexed by the
+ * address relative to the lowest one, built in a single pass. Lists spanning more fall back to a Map.
+ *
+ * Example:
+ * ----------------
+ * const positionOf = AddressIndex.of(request[mb.LIST_PROPERTY]);
+ * const value = values[positionOf(address)];
+ */
+
+class AddressIndex {
+
+    static maxSpan = 0x10000;
+
+    /**
+     * Builds the position lookup of a list of addresses.
+     * @param {Array} list - List of addresses.
+     * @returns {Function} - Returns the position of an address in the list, undefined if absent.
+     */
+    static of(list) {
+        let min = Infinity;
+        let max = -Infinity;
+        for (const address of list) {
+            min = address < min ? address : min;
+            max = address > max ? address : max;
+        }
+
+        if (!(max - min < AddressIndex.maxSpan)) {
+            const positions = new Map();
+            list.forEach((address, i) => positions.set(address, i));
+            return (address) => positions.get(address);
+        }
+
+        const positions = new Int32Array(max - min + 1).fill(-1);
+        for (let i = 0; i < list.length; i++) {
+            positions[list[i] - min] = i;
+        }
+        return (address) => {
+            const position = positions[address - min];
+            return position >= 0 ? position : undefined;
+        };
+    }
+}
+
+module.exports = AddressIndex;
@@ -7,9 +7,10 @@
  * is converted into a buffer format suitable for Modbus transmission.
  * 
  * Key Components:
- * - **IORequestBufferizer**: Base class that provides a method for converting parsed packets into buffers.
+ * - **IORequestBufferizer**: Base class that writes the header of input/output frames.
  * - **ReadingRequestBufferizer**: Buffers Modbus reading requests.
  * - **WritingRequestBufferizer**: Buffers Modbus writing requests, handling both numeric and boolean outputs.
+ *   Values are taken straight from the request through an address lookup built once per request.
  * - **DiagnosisRequestBufferizer**: Buffers diagnostic requests for Modbus.
  * - **RawModbusRequestBufferizer**: Buffers raw Modbus requests without additional processing.
  * - **ModbusPacketBufferizer**: Main class used to identify the correct bufferizer based on the request
@@ -18,14 +19,16 @@
  * Dependencies:
  * - `@maps/keywordsMap.js`: Contains mappings for keywords like `mb.FUNCTION_PROPERTY` and
  *   data types such as `mb.NUMERIC_OUTPUT` and `mb.BOOLEAN_OUTPUT`.
+ * - `@parser/addressIndex.js`: Position of each address in a list request.
  *
  * Usage:
- * The `ModbusPacketBufferizer` class is called to convert parsed request packets into buffers,
- * selecting the appropriate bufferizer based on request type. 
+ * The `ModbusPacketBufferizer` class is called to convert the frames planned for a request into buffers,
+ * selecting the appropriate bufferizer based on request type. All frames of a request are written in a
+ * single pass into one buffer, each frame being a view on it.
  *
  * Example:
  * ----------------
- * const buffer = ModbusPacketBufferizer.toBuffer(parsedPacket, request);
+ * const buffers = ModbusPacketBufferizer.toBuffers(parsedRequests, request);
  *
  * Author: TEMPESTA, H. H.
  * Date: Oct 31st 2024
@@ -33,105 +36,116 @@
 
 require('module-alias/register');
 const { mb } = require('@maps/keywordsMap.js');
+const AddressIndex = require('@parser/addressIndex.js');
 
 class IORequestBufferizer {
     /**
-     * Converts a parsed packet into a buffer with the specified size.
+     * Size of an input/output frame without data.
      * @param {Array} parsedPacket - The parsed packet array.
-     * @param {number} bufferSize - The size of the buffer to create.
-     * @returns {Buffer} - The buffer containing the packet data.
+     * @param {Object} request - The original request object.
+     * @returns {number} - Frame size in bytes.
      */
-    static toBuffer(parsedPacket, bufferSize) {
-        const buffer = Buffer.alloc(bufferSize);
-        buffer.writeUInt8(parsedPacket[0], 0);
-        buffer.writeUInt8(parsedPacket[1], 1);
-        buffer.writeUInt16BE(parsedPacket[2], 2);
-        buffer.writeUInt16BE(parsedPacket[3], 4);
-        return buffer;
+    static frameSize(parsedPacket, request) {
+        return 6;
     }
-}
 
-class ReadingRequestBufferizer extends IORequestBufferizer {
     /**
-     * Buffers a parsed Modbus reading request.
+     * Writes the id, function, start address and quantity of a frame.
+     * @param {Buffer} buffer - The buffer to write into.
+     * @param {number} offset - Position of the frame in the buffer.
      * @param {Array} parsedPacket - The parsed packet array.
-     * @param {Object} request - The original request object.
-     * @returns {Buffer} - The buffered request data.
      */
-    static toBuffer(parsedPacket, request) {
-        return super.toBuffer(parsedPacket, 6);
+    static writeFrame(buffer, offset, parsedPacket) {
+        buffer[offset] = parsedPacket[0];
+        buffer[offset + 1] = parsedPacket[1];
+        buffer.writeUInt16BE(parsedPacket[2], offset + 2);
+        buffer.writeUInt16BE(parsedPacket[3], offset + 4);
     }
 }
 
+class ReadingRequestBufferizer extends IORequestBufferizer {}
+
 class WritingRequestBufferizer extends IORequestBufferizer {
     /**
-     * Buffers a parsed Modbus writing request, handling numeric or boolean data.
+     * Size of a writing frame, handling numeric or boolean data.
      * @param {Array} parsedPacket - The parsed packet array.
      * @param {Object} request - The original request object.
-     * @returns {Buffer} - The buffered request data.
+     * @returns {number} - Frame size in bytes.
+     */
+    static frameSize(parsedPacket, request) {
+        return request[mb.DATATYPE_PROPERTY] === mb.NUMERIC_OUTPUT
+            ? 7 + 2 * parsedPacket[3]
+            : 7 + Math.ceil(parsedPacket[3] / 8);
+    }
+
+    /**
+     * Builds the lookup of the value to write at each address, in a single pass over the request.
+     * @param {Object} request - The original request object.
+     * @returns {Function} - Returns the value to write at an address.
      */
-    static toBuffer(parsedPacket, request) {
-        const bufferSize = request[mb.DATATYPE_PROPERTY] === mb.NUMERIC_OUTPUT
-            ? 7 + 2 * (parsedPacket.length - 4)
-            : 7 + Math.ceil((parsedPacket.length - 4) / 8);
-            
-        const buffer = super.toBuffer(parsedPacket, bufferSize);
-        buffer.writeUInt8(bufferSize - 7, 6);
-        this.writeDataToBuffer(buffer, parsedPacket, request);
-        
-        return buffer;
+    static valueLookup(request) {
+        const values = request[mb.VALUES_PROPERTY];
+
+        if (request.hasOwnProperty(mb.RANGE_PROPERTY)) {
+            const start = request[mb.RANGE_PROPERTY][0];
+            return (address) => values[address - start];
+        }
+
+        const positionOf = AddressIndex.of(request[mb.LIST_PROPERTY]);
+        return (address) => values[positionOf(address)];
     }
 
     /**
-     * Writes data into the buffer for a Modbus writing request, supporting numeric and boolean data.
-     * @param {Buffer} buffer - The buffer to write data into.
+     * Writes a Modbus writing frame, supporting numeric and boolean data.
+     * @param {Buffer} buffer - The buffer to write into, zero filled.
+     * @param {number} offset - Position of the frame in the buffer.
      * @param {Array} parsedPacket - The parsed packet array.
      * @param {Object} request - The original request object.
+     * @param {Function} valueOf - Value to write at an address, see `valueLookup`.
      */
-    static writeDataToBuffer(buffer, parsedPacket, request) {
+    static writeFrame(buffer, offset, parsedPacket, request, valueOf) {
+        super.writeFrame(buffer, offset, parsedPacket);
+
+        const [, , start, count] = parsedPacket;
+        const data = offset + 7;
+        buffer[offset + 6] = this.frameSize(parsedPacket, request) - 7;
+
         if (request[mb.DATATYPE_PROPERTY] === mb.NUMERIC_OUTPUT) {
-            parsedPacket.slice(4).forEach((data, i) => buffer.writeUInt16BE(data, 7 + 2 * i));
+            for (let i = 0; i < count; i++) {
+                buffer.writeUInt16BE(valueOf(start + i), data + 2 * i);
+            }
         } 
         else { // request[mb.DATATYPE_PROPERTY] === mb.BOOLEAN_OUTPUT
-            let encodedByte = 0;
-            let bytePosition = 7;
-
-            parsedPacket.slice(4).forEach((data, i) => {
-                if (data !== 0) { 
-                    encodedByte |= (1 << (i % 8));
+            for (let i = 0; i < count; i++) {
+                if (valueOf(start + i) !== 0) {
+                    buffer[data + (i >> 3)] |= 1 << (i & 7);
                 }
-                if (i % 8 === 7 || i === parsedPacket.length - 5) {
-                    buffer.writeUInt8(encodedByte, bytePosition++);
-                    encodedByte = 0;
-                }
-            });
+            }
         }
     }
 }
 
-class DiagnosisRequestBufferizer extends IORequestBufferizer {
+class DiagnosisRequestBufferizer extends IORequestBufferizer {}
+
+class RawModbusRequestBufferizer {
     /**
-     * Buffers a parsed Modbus diagnostic request.
+     * Size of a raw Modbus frame.
      * @param {Array} parsedPacket - The parsed packet array.
      * @param {Object} request - The original request object.
-     * @returns {Buffer} - The buffered request data.
+     * @returns {number} - Frame size in bytes.
      */
-    static toBuffer(parsedPacket, request) {
-        return super.toBuffer(parsedPacket, 6);
+    static frameSize(parsedPacket, request) {
+        return parsedPacket.length;
     }
-}
 
-class RawModbusRequestBufferizer {
     /**
-     * Buffers a raw Modbus request without additional processing.
+     * Writes a raw Modbus frame without additional processing.
+     * @param {Buffer} buffer - The buffer to write into.
+     * @param {number} offset - Position of the frame in the buffer.
      * @param {Array} parsedPacket - The parsed packet array.
-     * @param {Object} request - The original request object.
-     * @returns {Buffer} - The buffered raw Modbus request.
      */
-    static toBuffer(parsedPacket, request) {
-        const buffer = Buffer.alloc(parsedPacket.length);
-        parsedPacket.forEach((value, index) => { buffer.writeUInt8(value, index); });
-        return buffer;
+    static writeFrame(buffer, offset, parsedPacket) {
+        buffer.set(parsedPacket, offset);
     }
 }
 
@@ -156,14 +170,23 @@ class ModbusPacketBufferizer {
     }
 
     /**
-     * Buffers the parsed packet using the appropriate bufferizer based on the request type.
-     * @param {Array} parsedPacket - The parsed packet array.
+     * Buffers the frames planned for a request, writing them all into a single buffer.
+     * @param {Array} parsedRequests - The parsed packet arrays, as planned by the request encoder.
      * @param {Object} request - The original request object.
-     * @returns {Buffer} - The buffered request data.
+     * @returns {Array} - One buffer per frame, views on the shared buffer.
      */
-    static toBuffer(parsedPacket, request) {
+    static toBuffers(parsedRequests, request) {
         const bufferizer = this.fetchBufferizer(request);
-        return bufferizer.toBuffer(parsedPacket, request);
+        const sizes = parsedRequests.map((parsedPacket) => bufferizer.frameSize(parsedPacket, request));
+        const buffer = Buffer.alloc(sizes.reduce((total, size) => total + size, 0));
+        const valueOf = bufferizer === WritingRequestBufferizer ? bufferizer.valueLookup(request) : null;
+
+        let offset = 0;
+        return parsedRequests.map((parsedPacket, i) => {
+            bufferizer.writeFrame(buffer, offset, parsedPacket, request, valueOf);
+            offset += sizes[i];
+            return buffer.subarray(offset - sizes[i], offset);
+        });
     }
 }
 
@@ -8,10 +8,12 @@
  * 
  * Key Components:
  * - **IORequestEncoder**: Base encoder class that provides encoding logic for general
- *   input/output requests and handles range generation for Modbus commands.
+ *   input/output requests and plans the transactions covering the requested addresses: ranges are
+ *   split at the protocol and slave limits, and scattered reads are merged across gaps whenever
+ *   reading the extra points costs less than another transaction (see `gapBudget`).
  * - **ReadingRequestEncoder**: Encodes Modbus reading requests.
  * - **WritingRequestEncoder**: Encodes Modbus writing requests, supporting range and list
- *   configurations for data.
+ *   configurations. Data is left to `ModbusPacketBufferizer`, which writes it straight into the frames.
  * - **DiagnosisRequestEncoder**: Encodes diagnostic requests based on Modbus subfunctions.
  * - **RawModbusRequestEncoder**: Encodes raw Modbus requests without additional processing.
  * - **ModbusPacketConstructor**: Main class to determine the encoder type based on the request
@@ -23,11 +25,11 @@
  * - `@maps/diagnosisMap.js`: Contains mappings for diagnostic subfunctions.
  *
  * Usage:
- * Use `ModbusPacketConstructor.parse(request)` to encode a Modbus request based on its function.
+ * Use `ModbusPacketConstructor.parse(request, profile)` to encode a Modbus request based on its function.
  *
  * Example:
  * ----------------
- * const encodedPackets = ModbusPacketConstructor.parse(request);
+ * const encodedPackets = ModbusPacketConstructor.parse(request, capability.transactionProfile(id, roundTrip_ms));
  *
  * Author: TEMPESTA, H. H.
  * Date: Oct 31st 2024
@@ -38,18 +40,29 @@ const { mb } = require('@maps/keywordsMap.js');
 const { diagnosisMap } = require('@maps/diagnosisMap.js');
 
 class IORequestEncoder {
-    
-    
+
+    /**
+     * Transaction profile assumed when the device is unknown: protocol limits, and no gap is worth reading.
+     */
+    static defaultProfile = Object.freeze({
+        maxReadBits: 2000,
+        maxReadRegisters: 125,
+        maxWriteBits: 1968,
+        maxWriteRegisters: 123,
+        characterTime_ms: 0,
+        transactionCost_ms: 0,
+    });
 
     /**
      * Encodes a general input/output request, converting it into Modbus packet format.
      * @param {Object} request - The request object with Modbus parameters.
+     * @param {Object} profile - Transaction profile of the target slave, see `DeviceCapability.transactionProfile`.
      * @returns {Array} - An array containing packets and ranges.
      */
-    static encodeIORequest(request) {
+    static encodeIORequest(request, profile) {
         let packets = [];
         const mbFunction = IORequestEncoder.determineModbusFunction(request);
-        const ranges = IORequestEncoder.getRanges(request);
+        const ranges = IORequestEncoder.getRanges(request, profile);
         packets.push(...ranges.map(range => [request[mb.ID_PROPERTY], mbFunction, range[0], range[1]]));
         return [packets, ranges];
     }
@@ -72,89 +85,133 @@ class IORequestEncoder {
     }
 
     /**
-     * Extracts the target address ranges from the request for encoding.
+     * Extracts the target address ranges from the request for encoding, split at the transaction limits.
      * @param {Object} request - The request object with Modbus parameters.
+     * @param {Object} profile - Transaction profile of the target slave.
      * @returns {Array} - Array of ranges with start address and count.
      */
-    static getRanges(request) {
+    static getRanges(request, profile) {
+        const isRead = request[mb.FUNCTION_PROPERTY] === mb.READ;
+        const isBit = [mb.BOOLEAN_OUTPUT, mb.BOOLEAN_INPUT].includes(request[mb.DATATYPE_PROPERTY]);
+        const limit = isRead
+            ? (isBit ? profile.maxReadBits : profile.maxReadRegisters)
+            : (isBit ? profile.maxWriteBits : profile.maxWriteRegisters);
+
         if (request.hasOwnProperty(mb.RANGE_PROPERTY)) {
             const [start, end] = request[mb.RANGE_PROPERTY];
-            return [[start, end - start + 1]];
+            const ranges = [];
+            for (let offset = start; offset <= end; offset += limit) {
+                ranges.push([offset, Math.min(limit, end - offset + 1)]);
+            }
+            return ranges;
         } 
         if (request.hasOwnProperty(mb.LIST_PROPERTY)) {
-            return IORequestEncoder.getRangesFromList(request[mb.LIST_PROPERTY]);
+            // Writing a gap would overwrite points the client did not ask for, only reads may span them
+            const gapBudget = isRead ? IORequestEncoder.gapBudget(profile, isBit) : 0;
+            return IORequestEncoder.getRangesFromList(request[mb.LIST_PROPERTY], limit, gapBudget);
         }
     }
 
     /**
-     * Converts a list of addresses into contiguous ranges.
+     * Largest gap worth reading through rather than starting another transaction: reading a point
+     * costs its bytes on the serial line, a transaction costs its framing, the slave's turnaround
+     * and the round trip to the device.
+     * @param {Object} profile - Transaction profile of the target slave.
+     * @param {boolean} isBit - True for coils and discrete inputs, packed eight to a byte.
+     * @returns {number} - Number of unrequested points a range may span.
+     */
+    static gapBudget(profile, isBit) {
+        const pointCost_ms = (isBit ? 1 / 8 : 2) * profile.characterTime_ms;
+        return pointCost_ms > 0 ? Math.floor(profile.transactionCost_ms / pointCost_ms) : 0;
+    }
+
+    /**
+     * Plans the transactions covering a list of addresses: neighbouring addresses share a range when
+     * the gap between them is within `gapBudget`, and no range exceeds `limit` points.
      * @param {Array} list - List of addresses.
-     * @returns {Array} - Array of contiguous address ranges.
+     * @param {number} [limit=Infinity] - Most points a single transaction may carry.
+     * @param {number} [gapBudget=0] - Most unrequested points a range may span between two addresses.
+     * @returns {Array} - Array of address ranges with start address and count.
      */
-    static getRangesFromList(list) {
-        const target = [...list].sort((a, b) => a - b);
+    static getRangesFromList(list, limit = Infinity, gapBudget = 0) {
+        const target = IORequestEncoder.sortedAddresses(list);
         const ranges = [];
         let rangeStart = target[0];
+        let rangeEnd = target[0];
 
-        for (let i = 0; i < target.length; i++) {
-            if (target[i] !== target[i + 1] - 1) {
-                ranges.push([rangeStart, target[i] - rangeStart + 1]);
-                rangeStart = target[i + 1];
+        for (let i = 1; i <= target.length; i++) {
+            const address = target[i];
+            if (address !== undefined && address - rangeEnd - 1 <= gapBudget && address - rangeStart < limit) {
+                rangeEnd = address;
+                continue;
             }
+
+            ranges.push([rangeStart, rangeEnd - rangeStart + 1]);
+            rangeStart = rangeEnd = address;
         }
         return ranges;
     }
+
+    /**
+     * Sorts and deduplicates a list of addresses. Modbus addresses span at most 65536 points, so they
+     * are marked in a bitmap and read back in order, a fallback sort handling out of range lists.
+     * @param {Array} list - List of addresses.
+     * @returns {Float64Array} - Distinct addresses in ascending order.
+     */
+    static sortedAddresses(list) {
+        let min = Infinity;
+        let max = -Infinity;
+        for (const address of list) {
+            min = address < min ? address : min;
+            max = address > max ? address : max;
+        }
+
+        if (!(max - min < 0x10000)) {
+            return Float64Array.from(new Set(list)).sort();
+        }
+
+        const present = new Uint8Array(max - min + 1);
+        let count = 0;
+        for (const address of list) {
+            count += present[address - min] ^ 1;
+            present[address - min] = 1;
+        }
+
+        const target = new Float64Array(count);
+        for (let offset = 0, i = 0; i < count; offset++) {
+            if (present[offset]) {
+                target[i++] = min + offset;
+            }
+        }
+        return target;
+    }
 }
 
 class ReadingRequestEncoder extends IORequestEncoder {
     /**
      * Encodes a Modbus reading request.
      * @param {Object} request - The request object with Modbus parameters.
+     * @param {Object} profile - Transaction profile of the target slave.
      * @returns {Array} - An array of encoded Modbus packets.
      */
-    static encode(request) {
-        const [packets, _] = super.encodeIORequest(request);
+    static encode(request, profile) {
+        const [packets, _] = super.encodeIORequest(request, profile);
         return packets;
     }
 }
 
 class WritingRequestEncoder extends IORequestEncoder {
     /**
-     * Encodes a Modbus writing request, attaching data to the encoded packets.
+     * Encodes a Modbus writing request. The frames carry no data: the bufferizer writes the values
+     * straight from the request.
      * @param {Object} request - The request object with Modbus parameters.
-     * @returns {Array} - An array of encoded Modbus packets with data.
+     * @param {Object} profile - Transaction profile of the target slave.
+     * @returns {Array} - An array of encoded Modbus packets.
      */
-    static encode(request) {
-        let [packets, ranges] = super.encodeIORequest(request);
-        const dataArrays = this.getData(request, ranges);
-        for (let i = 0; i < packets.length; i++) {
-            packets[i].push(...dataArrays[i]);
-        }
+    static encode(request, profile) {
+        const [packets, _] = super.encodeIORequest(request, profile);
         return packets;
     }
-    
-    /**
-     * Retrieves data to be written, formatted to align with the Modbus ranges.
-     * @param {Object} request - The request object with data values.
-     * @param {Array} ranges - Array of address ranges for the request.
-     * @returns {Array} - Data arrays corresponding to each Modbus range.
-     */
-    static getData(request, ranges) {
-        if (request.hasOwnProperty(mb.RANGE_PROPERTY)) {
-            return [request[mb.VALUES_PROPERTY]];
-        }
-        else {
-            let dataArrays = [];
-            for (const range of ranges) {
-                let data = [];
-                for (let i = 0; i < range[1]; i++) {
-                    data.push(request[mb.VALUES_PROPERTY][request[mb.LIST_PROPERTY].indexOf(range[0] + i)]); 
-                }
-                dataArrays.push(data);
-            }
-            return dataArrays;
-        } 
-    }
 }
 
 class DiagnosisRequestEncoder {
@@ -202,11 +259,12 @@ class ModbusPacketConstructor {
     /**
      * Parses the request object into an encoded Modbus packet array.
      * @param {Object} request - The request object with Modbus parameters.
+     * @param {Object} [profile] - Transaction profile of the target slave, protocol limits if omitted.
      * @returns {Array} - Encoded Modbus packet array.
      */
-    static parse(request) {
+    static parse(request, profile = IORequestEncoder.defaultProfile) {
         const encoder = ModbusPacketConstructor.encoderFetcher(request);
-        return encoder.encode(request);
+        return encoder.encode(request, profile);
     }
 }
 
@@ -60,58 +60,64 @@ class ReadingResponseDebufferizer {
      * @param {Buffer} response - The buffered Modbus response.
      * @param {number} targetLength - Expected length of data in registers or bits.
      * @param {string} dataType - Data type of the response (numeric or boolean).
-     * @returns {Array} - Decoded response with ID, function, and fetched data.
+     * @returns {Array|null} - Decoded response with ID, function, and fetched data, or null if the
+     * response is too short for the data asked for.
      */
     static toArray(response, targetLength, dataType) {
-        let parsedResponse = [
-            response.readUInt8(0),      // ID
-            response.readUInt8(1),      // FUNCTION
-        ];
+        const isNumeric = [mb.NUMERIC_INPUT, mb.NUMERIC_OUTPUT].includes(dataType);
+        const byteCount = isNumeric ? 2 * targetLength : Math.ceil(targetLength / 8);
+
+        // A response too short for the data asked for, exception responses included, fails the request
+        if (response.length < 3 + byteCount) {
+            return null;
+        }
 
-        const fetchedDataParser = [mb.NUMERIC_INPUT, mb.NUMERIC_OUTPUT].includes(dataType)
-            ? this.parseFetchedNumericData 
-            : this.parseFetchedBooleanData;
+        const parsedResponse = new Array(2 + targetLength);
+        parsedResponse[0] = response[0];    // ID
+        parsedResponse[1] = response[1];    // FUNCTION
 
-        try {
-            parsedResponse.push(...fetchedDataParser(response.slice(3), targetLength));
+        if (isNumeric) {
+            this.parseFetchedNumericData(response, targetLength, parsedResponse);
         }
-        catch {
-            parsedResponse.push(null);
+        else {
+            this.parseFetchedBooleanData(response, targetLength, parsedResponse);
         }
 
         return parsedResponse;
     }
 
     /**
-     * Parses numeric data from the response.
-     * @param {Buffer} response - Buffer containing the data.
+     * Parses numeric data from the response, after the id, function and byte count.
+     * @param {Buffer} response - The buffered Modbus response.
      * @param {number} targetLength - Expected length of numeric data.
-     * @returns {Array} - Array of parsed numeric data.
+     * @param {Array} parsedResponse - Array receiving the data from its third position on.
      */
-    static parseFetchedNumericData(response, targetLength) {
-        let fetchedData = [];
-        for (let i = 0; i < targetLength * 2; i += 2) {
-            fetchedData.push(response.readUInt16BE(i));
+    static parseFetchedNumericData(response, targetLength, parsedResponse) {
+        for (let i = 0; i < targetLength; i++) {
+            parsedResponse[2 + i] = (response[3 + 2 * i] << 8) | response[4 + 2 * i];
         }
-        return fetchedData;
     }
 
     /**
-     * Parses boolean data from the response, extracting individual bits.
-     * @param {Buffer} response - Buffer containing the data.
+     * Bits of every byte value, least significant first, as coils are packed.
+     */
+    static bitTable = Array.from({ length: 256 }, (_, byte) => Array.from({ length: 8 }, (_, bit) => (byte >> bit) & 1));
+
+    /**
+     * Parses boolean data from the response, after the id, function and byte count, unpacking a
+     * byte at a time.
+     * @param {Buffer} response - The buffered Modbus response.
      * @param {number} targetLength - Expected length of boolean data in bits.
-     * @returns {Array} - Array of parsed boolean data.
+     * @param {Array} parsedResponse - Array receiving the data from its third position on.
      */
-    static parseFetchedBooleanData(response, targetLength) {
-        let fetchedData = [];
-        for (let i = 0; i < response.length; i++) {
-            const byte = response.readUInt8(i);
-            for (let bit = 0; bit < 8; bit++) {
-                fetchedData.push((byte >> bit) & 1);
-                if (fetchedData.length === targetLength) break;
+    static parseFetchedBooleanData(response, targetLength, parsedResponse) {
+        for (let i = 0; i < targetLength; i += 8) {
+            const bits = ReadingResponseDebufferizer.bitTable[response[3 + (i >> 3)]];
+            const count = Math.min(8, targetLength - i);
+            for (let bit = 0; bit < count; bit++) {
+                parsedResponse[2 + i + bit] = bits[bit];
             }
         }
-        return fetchedData;
     }
 }
 
@@ -8,8 +8,8 @@
  *
  * Key Components:
  * - **WritingResponseDecoder**: Decodes Modbus writing responses, validating basic response fields.
- * - **ReadingResponseDecoder**: Decodes Modbus reading responses, mapping data back to the requested
- *   addresses.
+ * - **ReadingResponseDecoder**: Decodes Modbus reading responses, placing each value directly at the
+ *   position of its address in the request.
  * - **DiagnosisResponseDecoder**: Decodes diagnostic responses, extracting fetched data when present.
  * - **RawModbusResponseDecoder**: Decodes raw Modbus responses without additional interpretation.
  * - **ModbusResponseDecoder**: Main class that selects the appropriate decoder based on the Modbus
@@ -17,6 +17,9 @@
  *
  * Dependencies:
  * - `@maps/keywordsMap.js`: Provides constants like `mb.FETCHED_DATA`, `mb.STATUS`, and function codes.
+ * - `@parser/addressIndex.js`: Position of each address in a list request.
+ *
+ * Responses are shallow copies of the request: the arrays of the request are shared, never modified.
  *
  * Usage:
  * Use `ModbusResponseDecoder.createClientResponse(request, mbResponses)` to decode a Modbus
@@ -32,6 +35,7 @@
 
 require('module-alias/register');
 const { mb } = require('@maps/keywordsMap.js');
+const AddressIndex = require('@parser/addressIndex.js');
 
 class WritingResponseDecoder {
     
@@ -44,7 +48,7 @@ class WritingResponseDecoder {
      * @returns {Object} - The decoded response with status and content.
      */
     static decode(request, mbResponses) {
-        return JSON.parse(JSON.stringify(request.content));
+        return { ...request.content };
     }
 }
 
@@ -59,22 +63,27 @@ class ReadingResponseDecoder {
      * @returns {Object} - The decoded response with fetched data.
      */
     static decode(request, mbResponses) {
-        const response = JSON.parse(JSON.stringify(request.content));
-        let fetchedData = [];
+        const response = { ...request.content };
+        const isRange = request.content.hasOwnProperty(mb.RANGE_PROPERTY);
+        const start = isRange ? request.content[mb.RANGE_PROPERTY][0] : 0;
+        const positionOf = isRange ? null : AddressIndex.of(request.content[mb.LIST_PROPERTY]);
+        const fetchedData = new Array(isRange
+            ? request.content[mb.RANGE_PROPERTY][1] - start + 1
+            : request.content[mb.LIST_PROPERTY].length);
 
-        request.parsedRequests.forEach((mbRequest, index) => {
-            const targetOffset = mbRequest[2];
-            const targetLength = mbRequest[3];
+        request.parsedRequests.forEach(([, , targetOffset, targetLength], index) => {
+            const data = mbResponses[index];
 
             for (let i = 0; i < targetLength; i++) {
-                fetchedData.push([targetOffset + i, mbResponses[index][2 + i]]);
+                // Addresses read through a gap of a list are not part of the response
+                const position = isRange ? targetOffset + i - start : positionOf(targetOffset + i);
+                if (position !== undefined) {
+                    fetchedData[position] = data[2 + i];
+                }
             }
         });
 
-        response[mb.FETCHED_DATA] = request.content.hasOwnProperty(mb.RANGE_PROPERTY)
-            ? fetchedData.sort((a, b) => a[0] - b[0]).map(self => self[1])
-            : request.content[mb.LIST_PROPERTY].map(target => fetchedData[fetchedData.findIndex(subarray => subarray[0] === target)][1]);
-
+        response[mb.FETCHED_DATA] = fetchedData;
         return response;
     }
 }
@@ -90,7 +99,7 @@ class DiagnosisResponseDecoder {
      * @returns {Object} - The decoded response with fetched diagnostic data.
      */
     static decode(request, mbResponses) {
-        const response = JSON.parse(JSON.stringify(request.content));
+        const response = { ...request.content };
         if (mbResponses[0].length === 4) {
             response[mb.FETCHED_DATA] = [mbResponses[0][3]];
         }
@@ -109,7 +118,7 @@ class RawModbusResponseDecoder {
      * @returns {Object} - The decoded response containing raw fetched data.
      */
     static decode(request, mbResponses) {
-        const response = JSON.parse(JSON.stringify(request.content));
+        const response = { ...request.content };
         response[mb.FETCHED_DATA] = mbResponses[0];
         return response;
     }
@@ -149,7 +158,7 @@ class ModbusResponseDecoder {
             response = decoder.decode(request, mbResponses);
             response[mb.STATUS] = true;
         } else {
-            response = JSON.parse(JSON.stringify(request.content));
+            response = { ...request.content };
             response[mb.STATUS] = false;
         }
        
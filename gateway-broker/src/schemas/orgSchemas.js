@@ -13,7 +13,8 @@
  * - **Device Schema**: Contains fields for `token` and `hashedPassword` for device
  *   authentication within an organization.
  * - **Organization Schema**: Top-level schema with `organizationName`, `hashedPassword`,
- *   and nested `users` and `devices` arrays to manage access control.
+ *   and nested `users` and `devices` arrays to manage access control. Its `updatedAt` timestamp,
+ *   maintained by Mongoose, tells the broker's cache when the organization changed.
  *
  * Usage:
  * - The `Organization` schema is instantiated in the database to manage users and devices,
@@ -57,7 +58,7 @@ const organizationSchema = new mongoose.Schema({
     hashedPassword: { type: String, required: true }, // Organization's hashed password
     users: { type: [userSchema], default: [] },
     devices: { type: [deviceSchema], default: [] },
-});
+}, { timestamps: true });
 
 // Export the Organization model
 const Organization = mongoose.model('Organization', organizationSchema);
@@ -3,8 +3,8 @@
  * ----------------------------------------------------------------------
  * 
  * This schema defines the structure and constraints for Modbus requests within the
- * MQTT-Modbus gateway, supporting four types of requests: Write, Read, Diagnosis, and
- * Modbus. Each type has specific property requirements and constraints enforced through
+ * MQTT-Modbus gateway, supporting five types of requests: Write, Read, Diagnosis, Modbus
+ * and Subscribe. Each type has specific property requirements and constraints enforced through
  * JSON schema rules and custom keywords.
  *
  * Schema Structure:
@@ -12,13 +12,17 @@
  *   properties allowed.
  * - **Properties**:
  *   - `{ID_PROPERTY}`: Integer between 1 and 247, represents the unique Modbus ID.
- *   - `{FUNCTION_PROPERTY}`: Enum of Modbus functions `{WRITE}`, `{READ}`, `{DIAGNOSIS}`, and `{MODBUS}`.
+ *   - `{FUNCTION_PROPERTY}`: Enum of Modbus functions `{WRITE}`, `{READ}`, `{DIAGNOSIS}`, `{MODBUS}` and `{SUBSCRIBE}`.
  *   - `{DATATYPE_PROPERTY}`: Enum of data types including `{BOOLEAN_INPUT}`, `{BOOLEAN_OUTPUT}`, `{NUMERIC_INPUT}`, and `{NUMERIC_OUTPUT}`.
  *   - `{RANGE_PROPERTY}`: Optional array of exactly 2 integers, unique and sorted in ascending order.
  *   - `{LIST_PROPERTY}`: Optional array of unique integers with at least one item.
  *   - `{VALUES_PROPERTY}`: Optional array of integers with at least one item, representing data to write.
  *   - `{SUBFUNCTION_PROPERTY}`: Required for `DIAGNOSIS` function, validated against `{SUBFUNCTIONS}`.
  *   - `{PACKET_PROPERTY}`: Array of integers (0-255) for direct Modbus communication.
+ *   - `{MAX_AGE_PROPERTY}`: Optional non-negative integer, staleness in milliseconds a read accepts from the broker's cache.
+ *   - `{PERIOD_PROPERTY}`: Poll period of a subscription in milliseconds, at least 100.
+ *   - `{DEADBAND_PROPERTY}`: Optional non-negative number, change a numeric value needs to be streamed again.
+ *   - `{EXPIRY_PROPERTY}`: Optional lifetime of a subscription in seconds, 0 cancels it.
  *
  * Validation Rules:
  * 1. Required properties `{ID_PROPERTY}` and `{FUNCTION_PROPERTY}` must always be present.
@@ -37,12 +41,17 @@
  *    - **Modbus Requests (`{MODBUS}`)**:
  *      - `{PACKET_PROPERTY}` must be present.
  *      - No other properties (`{VALUES_PROPERTY}`, `{DATATYPE_PROPERTY}`, `{LIST_PROPERTY}`, `{RANGE_PROPERTY}`, `{SUBFUNCTION_PROPERTY}`) should be present.
+ *    - **Subscribe Requests (`{SUBSCRIBE}`)**:
+ *      - `{DATATYPE_PROPERTY}` and `{PERIOD_PROPERTY}` must be present.
+ *      - Exactly one of `{RANGE_PROPERTY}` or `{LIST_PROPERTY}` must be present (XOR condition).
+ *      - `{VALUES_PROPERTY}`, `{SUBFUNCTION_PROPERTY}` and `{PACKET_PROPERTY}` must not be present.
  *
  * Custom Keywords:
  * - **validateReadRequest**: Ensures XOR condition on `{LIST_PROPERTY}` and `{RANGE_PROPERTY}`, disallows `{VALUES_PROPERTY}` and `{SUBFUNCTION_PROPERTY}` for Read requests.
  * - **validateWriteRequest**: Enforces presence of `{VALUES_PROPERTY}` and correct length, validates `{DATATYPE_PROPERTY}`, applies XOR condition on `{LIST_PROPERTY}` and `{RANGE_PROPERTY}`.
  * - **validateDiagnosisRequest**: Requires `{SUBFUNCTION_PROPERTY}`, disallows all other non-diagnostic parameters.
  * - **validateModbusRequest**: Requires `{PACKET_PROPERTY}`, disallows all other non-Modbus parameters.
+ * - **validateSubscribeRequest**: Requires `{DATATYPE_PROPERTY}` and `{PERIOD_PROPERTY}`, applies XOR condition on `{LIST_PROPERTY}` and `{RANGE_PROPERTY}`.
  *
  * Usage:
  * This schema is used in conjunction with a validation system that dynamically replaces placeholders
@@ -56,13 +65,17 @@ const schemaTemplate = {
     type: 'object',
     properties: {
         '{ID_PROPERTY}': { type: 'integer', minimum: 1, maximum: 247 },
-        '{FUNCTION_PROPERTY}': { type: 'string', enum: ['{WRITE}', '{READ}', '{DIAGNOSIS}', '{MODBUS}'] },
+        '{FUNCTION_PROPERTY}': { type: 'string', enum: ['{WRITE}', '{READ}', '{DIAGNOSIS}', '{MODBUS}', '{SUBSCRIBE}'] },
         '{DATATYPE_PROPERTY}': { type: 'string', enum: ['{BOOLEAN_INPUT}', '{BOOLEAN_OUTPUT}', '{NUMERIC_INPUT}', '{NUMERIC_OUTPUT}'] },
         '{RANGE_PROPERTY}': { type: 'array', items: { type: 'integer' }, minItems: 2, maxItems: 2, uniqueItems: true, ascendingItems: true },
         '{LIST_PROPERTY}': { type: 'array', items: { type: 'integer' }, minItems: 1, uniqueItems: true },
         '{VALUES_PROPERTY}': { type: 'array', items: { type: 'integer' }, minItems: 1 },
         '{SUBFUNCTION_PROPERTY}': { type: 'string', enum: ['{SUBFUNCTIONS}'] },
         '{PACKET_PROPERTY}': { type: 'array', items: { type: 'integer', minimum: 0, maximum: 255 } },
+        '{MAX_AGE_PROPERTY}': { type: 'integer', minimum: 0 },
+        '{PERIOD_PROPERTY}': { type: 'integer', minimum: 100 },
+        '{DEADBAND_PROPERTY}': { type: 'number', minimum: 0 },
+        '{EXPIRY_PROPERTY}': { type: 'integer', minimum: 0 },
     },
     required: ['{ID_PROPERTY}', '{FUNCTION_PROPERTY}'],
     additionalProperties: false,
@@ -106,6 +119,17 @@ const schemaTemplate = {
         list:           '{LIST_PROPERTY}',
         range:          '{RANGE_PROPERTY}',
         packet:         '{PACKET_PROPERTY}',
+    },
+    validateSubscribeRequest: {
+        func:           '{FUNCTION_PROPERTY}',
+        subscribe:      '{SUBSCRIBE}',
+        datatype:       '{DATATYPE_PROPERTY}',
+        period:         '{PERIOD_PROPERTY}',
+        values:         '{VALUES_PROPERTY}',
+        list:           '{LIST_PROPERTY}',
+        range:          '{RANGE_PROPERTY}',
+        subfunctions:   '{SUBFUNCTION_PROPERTY}',
+        packet:         '{PACKET_PROPERTY}',
     }
 };
 
@@ -0,0 +1,284 @@
+/**
+ * BinaryFormat - Compact Binary Wire Format for Client Requests and Responses
+ * ----------------------------------------------------------------------------
+ *
+ * A third client format, next to terse and verbose JSON, for clients exchanging many or large
+ * messages: no JSON to parse or serialize, and values travel as packed big-endian words instead of
+ * decimal text. A binary message is a marker byte followed by fields, in any order:
+ *
+ *   byte 0 | per field: tag (u8) | length (LEB128 varint, bytes) | value
+ *   0xB1   |
+ *
+ * The marker cannot start a JSON document, so binary requests share the request topic with JSON ones.
+ *
+ * Fields:
+ *   tag  | keyword | value
+ *   0x01 | `id`    | u8
+ *   0x02 | `fn`    | u8 code: 1 `w`, 2 `r`, 3 `d`, 4 `mb`, 5 `s`
+ *   0x03 | `dt`    | u8 code: 1 `bi`, 2 `bo`, 3 `ni`, 4 `no`
+ *   0x04 | `rg`    | first and last address, u16 each
+ *   0x05 | `ls`    | addresses, u16 each
+ *   0x06 | `dv`    | values, u16 each
+ *   0x07 | `sf`    | u16 diagnosis subfunction code
+ *   0x08 | `pk`    | raw Modbus frame bytes
+ *   0x09 | `ma`    | u32
+ *   0x0A | `pe`    | u32
+ *   0x0B | `db`    | f64
+ *   0x0C | `ex`    | u32
+ *   0x10 | `st`    | u8, 0 or 1
+ *   0x11 | `fd`    | values, u16 each
+ *   0x12 | `mg`    | UTF-8 text
+ *
+ * Multi-byte values are big-endian. Requests decode to the terse format, so they are validated and
+ * parsed as terse requests; responses and stream messages are encoded from the terse format.
+ *
+ * Example:
+ * ----------------
+ * const request = BinaryFormat.decode(payload);
+ * const response = BinaryFormat.encode({ id: 1, fn: 'r', dt: 'no', rg: [0, 9], fd: values, st: true });
+ */
+
+require('module-alias/register');
+const modbusDiagnosis   = require('@keywords/diagnosisKeywords.json');
+const { mb }            = require('@maps/keywordsMap.js');
+
+// Code of each keyword carried as a number
+const functionCodes = [[1, mb.WRITE], [2, mb.READ], [3, mb.DIAGNOSIS], [4, mb.MODBUS], [5, mb.SUBSCRIBE]];
+const datatypeCodes = [[1, mb.BOOLEAN_INPUT], [2, mb.BOOLEAN_OUTPUT], [3, mb.NUMERIC_INPUT], [4, mb.NUMERIC_OUTPUT]];
+const subfunctionCodes = Object.values(modbusDiagnosis).map(([terse, , code]) => [code, terse]);
+
+/**
+ * Value encodings: size of an encoded value, and its writer and reader. Sizes return undefined when
+ * the value cannot be encoded, readers when the value's length does not fit the encoding.
+ */
+const encodings = {
+    u8: {
+        size: () => 1,
+        write: (buffer, offset, value) => buffer.writeUInt8(value & 0xFF, offset),
+        read: (buffer, offset, length) => length === 1 ? buffer[offset] : undefined,
+    },
+    bool: {
+        size: () => 1,
+        write: (buffer, offset, value) => buffer.writeUInt8(value ? 1 : 0, offset),
+        read: (buffer, offset, length) => length === 1 ? buffer[offset] !== 0 : undefined,
+    },
+    u16: {
+        size: () => 2,
+        write: (buffer, offset, value) => buffer.writeUInt16BE(value & 0xFFFF, offset),
+        read: (buffer, offset, length) => length === 2 ? buffer.readUInt16BE(offset) : undefined,
+    },
+    u32: {
+        size: () => 4,
+        write: (buffer, offset, value) => buffer.writeUInt32BE(value >>> 0, offset),
+        read: (buffer, offset, length) => length === 4 ? buffer.readUInt32BE(offset) : undefined,
+    },
+    f64: {
+        size: () => 8,
+        write: (buffer, offset, value) => buffer.writeDoubleBE(value, offset),
+        read: (buffer, offset, length) => length === 8 ? buffer.readDoubleBE(offset) : undefined,
+    },
+    words: {
+        size: (values) => isIntegerArray(values) ? 2 * values.length : undefined,
+        write: (buffer, offset, values) => {
+            for (let i = 0; i < values.length; i++) {
+                buffer.writeUInt16BE(values[i] & 0xFFFF, offset + 2 * i);
+            }
+        },
+        read: (buffer, offset, length) => {
+            if (length % 2) {
+                return undefined;
+            }
+            const values = new Array(length / 2);
+            for (let i = 0; i < values.length; i++) {
+                values[i] = buffer.readUInt16BE(offset + 2 * i);
+            }
+            return values;
+        },
+    },
+    bytes: {
+        size: (values) => isIntegerArray(values) ? values.length : undefined,
+        write: (buffer, offset, values) => {
+            for (let i = 0; i < values.length; i++) {
+                buffer[offset + i] = values[i] & 0xFF;
+            }
+        },
+        read: (buffer, offset, length) => Array.from(buffer.subarray(offset, offset + length)),
+    },
+    text: {
+        size: (value) => Buffer.byteLength(String(value)),
+        write: (buffer, offset, value) => buffer.write(String(value), offset),
+        read: (buffer, offset, length) => buffer.toString('utf8', offset, offset + length),
+    },
+};
+
+/**
+ * Tells whether a value is an array of integers, as word and byte fields carry. Missing values,
+ * as nulls, would otherwise be sent as zeros.
+ * @param {*} values - Value to encode.
+ * @returns {boolean}
+ */
+function isIntegerArray(values) {
+    if (!Array.isArray(values)) {
+        return false;
+    }
+    for (let i = 0; i < values.length; i++) {
+        if (!Number.isInteger(values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Builds the encoding of a keyword carried as a code. Unknown codes read as undefined.
+ * @param {Array} entries - Pairs of code and terse keyword.
+ * @param {Object} encoding - Encoding of the code.
+ * @returns {Object} - The encoding.
+ */
+function codeEncoding(entries, encoding) {
+    const keywordOf = new Map(entries);
+    const codeOf = new Map(entries.map(([code, keyword]) => [keyword, code]));
+    return {
+        size: encoding.size,
+        write: (buffer, offset, value) => encoding.write(buffer, offset, codeOf.get(value) ?? 0),
+        read: (buffer, offset, length) => keywordOf.get(encoding.read(buffer, offset, length)),
+    };
+}
+
+class BinaryFormat {
+
+    static marker = 0xB1;
+
+    static fields = [
+        [0x01, mb.ID_PROPERTY,          encodings.u8],
+        [0x02, mb.FUNCTION_PROPERTY,    codeEncoding(functionCodes, encodings.u8)],
+        [0x03, mb.DATATYPE_PROPERTY,    codeEncoding(datatypeCodes, encodings.u8)],
+        [0x04, mb.RANGE_PROPERTY,       encodings.words],
+        [0x05, mb.LIST_PROPERTY,        encodings.words],
+        [0x06, mb.VALUES_PROPERTY,      encodings.words],
+        [0x07, mb.SUBFUNCTION_PROPERTY, codeEncoding(subfunctionCodes, encodings.u16)],
+        [0x08, mb.PACKET_PROPERTY,      encodings.bytes],
+        [0x09, mb.MAX_AGE_PROPERTY,     encodings.u32],
+        [0x0A, mb.PERIOD_PROPERTY,      encodings.u32],
+        [0x0B, mb.DEADBAND_PROPERTY,    encodings.f64],
+        [0x0C, mb.EXPIRY_PROPERTY,      encodings.u32],
+        [0x10, mb.STATUS,               encodings.bool],
+        [0x11, mb.FETCHED_DATA,         encodings.words],
+        [0x12, mb.MESSAGE,              encodings.text],
+    ];
+
+    static fieldsByTag = new Map(BinaryFormat.fields.map((field) => [field[0], field]));
+    static fieldsByKeyword = new Map(BinaryFormat.fields.map((field) => [field[1], field]));
+
+    /**
+     * Tells whether a payload is a binary message.
+     * @param {Buffer} payload - Payload as published.
+     * @returns {boolean} - True if the payload starts with the binary marker.
+     */
+    static isBinary(payload) {
+        return Buffer.isBuffer(payload) && payload.length > 0 && payload[0] === BinaryFormat.marker;
+    }
+
+    /**
+     * Decodes a binary message to the terse format.
+     * @param {Buffer} payload - Binary message, marker included.
+     * @returns {Object} - The message in the terse format.
+     * @throws {Error} - If a field is truncated, unknown, repeated or holds an invalid value.
+     */
+    static decode(payload) {
+        const message = {};
+        let offset = 1;
+
+        while (offset < payload.length) {
+            const tag = payload[offset++];
+            let length = 0;
+            for (let shift = 0; ; shift += 7) {
+                if (offset >= payload.length || shift > 21) {
+                    throw new Error(`Truncated binary field 0x${tag.toString(16)}`);
+                }
+                const byte = payload[offset++];
+                length += (byte & 0x7F) * 2 ** shift;
+                if (!(byte & 0x80)) {
+                    break;
+                }
+            }
+            if (offset + length > payload.length) {
+                throw new Error(`Truncated binary field 0x${tag.toString(16)}`);
+            }
+
+            const field = BinaryFormat.fieldsByTag.get(tag);
+            if (!field || message.hasOwnProperty(field[1])) {
+                throw new Error(`Unexpected binary field 0x${tag.toString(16)}`);
+            }
+
+            const value = field[2].read(payload, offset, length);
+            if (value === undefined) {
+                throw new Error(`Invalid binary field 0x${tag.toString(16)}`);
+            }
+            message[field[1]] = value;
+            offset += length;
+        }
+
+        return message;
+    }
+
+    /**
+     * Encodes a message in the terse format. Keywords without a binary field are left out.
+     * @param {Object} message - The message in the terse format.
+     * @returns {Buffer} - Binary message, marker included.
+     * @throws {Error} - If a word or byte field is not an array of integers.
+     */
+    static encode(message) {
+        const fields = [];
+        let size = 1;
+
+        for (const keyword in message) {
+            const field = BinaryFormat.fieldsByKeyword.get(keyword);
+            const value = message[keyword];
+            if (!field || value === null || value === undefined) {
+                continue;
+            }
+
+            const length = field[2].size(value);
+            if (length === undefined) {
+                throw new Error(`Invalid value for binary field 0x${field[0].toString(16)}`);
+            }
+            fields.push([field, value, length]);
+            size += 1 + BinaryFormat.varintSize(length) + length;
+        }
+
+        const buffer = Buffer.allocUnsafe(size);
+        buffer[0] = BinaryFormat.marker;
+        let offset = 1;
+
+        for (const [field, value, length] of fields) {
+            buffer[offset++] = field[0];
+            for (let rest = length; ; rest = Math.floor(rest / 0x80)) {
+                buffer[offset++] = rest >= 0x80 ? (rest & 0x7F) | 0x80 : rest;
+                if (rest < 0x80) {
+                    break;
+                }
+            }
+            field[2].write(buffer, offset, value);
+            offset += length;
+        }
+
+        return buffer;
+    }
+
+    /**
+     * Size of a length encoded as a LEB128 varint.
+     * @param {number} length - Field length in bytes.
+     * @returns {number} - Bytes taken by the varint.
+     */
+    static varintSize(length) {
+        let size = 1;
+        while (length >= 0x80) {
+            length = Math.floor(length / 0x80);
+            size++;
+        }
+        return size;
+    }
+}
+
+module.exports = BinaryFormat;
@@ -11,12 +11,20 @@
  * - **Keyword Mapping**: Uses keyword mappings from JSON files to replace verbose keys with their terse
  *   equivalents and vice versa.
  * - **Format Correction**: Adjusts the request format to match the original input format, useful for
- *   responses and error handling.
+ *   responses and error handling. Binary requests, decoded to the terse format, are answered in the
+ *   terse format encoded by `BinaryFormat`.
+ * - **Compiled Formatters**: Parsing and format correction are generated once per format, at load time,
+ *   as functions reading and writing each known property by its literal name. The terse form of every
+ *   verbose value is kept in a frozen table. Formatting costs a constant number of property accesses
+ *   per property, with no keyword table walked.
  *
  * Dependencies:
  * - `@keywords/modbusKeywords.json`: Contains mappings for Modbus keywords.
  * - `@keywords/diagnosisKeywords.json`: Contains mappings for diagnosis keywords.
- * - `@maps/keywordsMap.js`: Provides utility functions like `getKey` for key translation.
+ * - `@maps/keywordsMap.js`: Provides the `keywordNames` tables for key translation.
+ * - `@validator/binaryFormat`: Encodes the responses of binary requests.
+ * - `@keywords/*.json` are trusted inputs: their names are spliced, as string literals, into the
+ *   generated functions.
  *
  * Usage:
  * Use `parse(data, format)` to parse incoming requests based on the specified format.
@@ -33,52 +41,93 @@
 require('module-alias/register');
 const modbusKeywords = require('@keywords/modbusKeywords.json');
 const modbusDiagnosis = require('@keywords/diagnosisKeywords.json');
-const { getKey } = require('@maps/keywordsMap.js');
+const { keywordNames } = require('@maps/keywordsMap.js');
+const BinaryFormat = require('@validator/binaryFormat');
 
 class RequestFormatter {
 
+    /**
+     * Format corrections, generated at load time, see `__compileFormatter`.
+     */
+    static terseFormatter = RequestFormatter.__compileFormatter('terse');
+    static verboseFormatter = RequestFormatter.__compileFormatter('verbose');
+
     /**
      * Constructor for RequestFormatter.
-     * Initializes the modbusKeywordsMap and modbusDiagnosisMap by calling the createUnifiedMap method.
+     * Compiles the terse form of every verbose Modbus and diagnosis keyword, and a parser per format.
      */
     constructor() {
-        this.unifiedFormat = Object.entries(modbusKeywords).slice(0, 8).reduce((accumulator, entry) => {
-            accumulator[entry[0]] = entry[1][0];
-            return accumulator;
-        }, {});
-        
-        this.modbusKeywordsMap = RequestFormatter.__createUnifiedMap(modbusKeywords);
-        this.modbusDiagnosisMap = RequestFormatter.__createUnifiedMap(modbusDiagnosis);
+        // Modbus keywords take precedence over diagnosis keywords sharing a verbose name
+        this.terseValues = Object.freeze(Object.assign(Object.create(null),
+            RequestFormatter.__createUnifiedMap(modbusDiagnosis),
+            RequestFormatter.__createUnifiedMap(modbusKeywords)));
+
+        this.terseParser = RequestFormatter.__compileParser(0, this.terseValues);
+        this.verboseParser = RequestFormatter.__compileParser(1, this.terseValues);
     }
 
     /**
      * Parses the data according to the specified format (terse or verbose).
      * 
      * @param {Object} data - The data to parse.
-     * @param {string} format - The format type ('verbose' or other).
+     * @param {string} format - The format type ('verbose' or other, binary requests being decoded to terse).
      * @returns {Object} The parsed request.
      */
     parse(data, format) {
-        let index = 0;
-        if (format === 'verbose') {
-            index = 1;
-        }
+        return format === 'verbose' ? this.verboseParser(data) : this.terseParser(data);
+    }
 
-        const parsedRequest = Object.keys(this.unifiedFormat).reduce((accumulator, key) => {
-            const placeholder = modbusKeywords[key][index];
-            const value = data[placeholder] || null;
-        
-            if (value !== null) {
-                if (typeof value === 'string') {
-                    accumulator[this.unifiedFormat[key]] = this.modbusKeywordsMap[value] || this.modbusDiagnosisMap[value] || value;
-                } else {
-                    accumulator[this.unifiedFormat[key]] = value;
-                }
-            }
-            return accumulator;
-        }, {});
+    /**
+     * Generates the parser of a format: each property is read by its name in the format and, when
+     * present, written under its terse name, string values translated to their terse form.
+     * 
+     * @param {number} index - Position of the format in the keyword entries, 0 terse and 1 verbose.
+     * @param {Object} terseValues - Terse form of the verbose keywords.
+     * @returns {Function} The parser, from request to unified request.
+     */
+    static __compileParser(index, terseValues) {
+        const statements = Object.entries(modbusKeywords)
+            .filter(([key]) => key.endsWith('_PROPERTY'))
+            .map(([, entry]) => `
+            value = data[${JSON.stringify(entry[index])}];
+            if (value !== null && value !== undefined) {
+                parsedRequest[${JSON.stringify(entry[0])}] = typeof value === 'string' ? terseValues[value] ?? value : value;
+            }`);
 
-        return parsedRequest;
+        return new Function('terseValues', `
+            return function parse(data) {
+                const parsedRequest = {};
+                let value;
+                ${statements.join('')}
+                return parsedRequest;
+            };`)(terseValues);
+    }
+
+    /**
+     * Generates the format correction of a format: each known key is renamed to the format, taking
+     * the value of the original object when it has one. Unknown keys are kept as they are.
+     * 
+     * @param {string} format - The format type ('verbose' or terse).
+     * @returns {Function} The format correction, from new and original objects to the adjusted object.
+     */
+    static __compileFormatter(format) {
+        const names = format === 'terse' ? keywordNames.terse : keywordNames.verbose;
+        const cases = Object.keys(names).map((key) => `
+                    case ${JSON.stringify(key)}:
+                        formattedObject[${JSON.stringify(names[key])}] = oldObject[${JSON.stringify(names[key])}] || newObject[key];
+                        break;`);
+
+        return new Function(`
+            return function correctFormat(newObject, oldObject) {
+                const formattedObject = {};
+                for (const key in newObject) {
+                    switch (key) {${cases.join('')}
+                    default:
+                        formattedObject[key] = oldObject[key] || newObject[key];
+                    }
+                }
+                return formattedObject;
+            };`)();
     }
 
     /**
@@ -92,7 +141,7 @@ class RequestFormatter {
             const [shortKey, longKey] = targetObject[key];
             accumulator[longKey] = shortKey; 
             return accumulator;
-        }, {});
+        }, Object.create(null));
     }
 
     /**
@@ -100,17 +149,18 @@ class RequestFormatter {
      * 
      * @param {Object} newObject - The object to adjust.
      * @param {Object} oldObject - The original object providing the reference format.
-     * @param {string} format - The format type ('verbose' or terse).
-     * @returns {Object} The adjusted object.
+     * @param {string} format - The format type ('verbose', terse or binary).
+     * @returns {Object|Buffer} The adjusted object, encoded for binary requests.
      */
     static correctFormat(newObject, oldObject, format) {
-        const originalKeys = Object.keys(newObject);
-
-        return originalKeys.reduce((accumulator, key) => {
-            const originalKey = getKey(key, format);
-            accumulator[originalKey] = oldObject[originalKey] || newObject[key];
-            return accumulator;
-        }, {});
+        switch (format) {
+            case 'terse':
+                return RequestFormatter.terseFormatter(newObject, oldObject);
+            case 'binary':
+                return BinaryFormat.encode(RequestFormatter.terseFormatter(newObject, oldObject));
+            default:
+                return RequestFormatter.verboseFormatter(newObject, oldObject);
+        }
     }
 }
 
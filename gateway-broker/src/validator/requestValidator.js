@@ -2,23 +2,25 @@
  * Validator - Validates Modbus Requests for MQTT-Modbus Gateway
  * ----------------------------------------------------------------
  * 
- * This module defines a `Validator` class that uses the AJV (Another JSON Validator) library
- * to validate Modbus requests in both terse and verbose formats. It includes custom validation
- * keywords to enforce specific Modbus request requirements for write, read, diagnosis, and raw
- * Modbus requests.
+ * This module defines a `Validator` class that validates Modbus requests in both terse and verbose
+ * formats. It enforces the request schema along with custom rules for the specific requirements of
+ * write, read, diagnosis, raw Modbus and subscribe requests.
  *
  * Key Components:
- * - **Schema Compilation**: Compiles AJV schemas using `SchemaManager` to create terse and verbose
- *   validation schemas.
- * - **Custom Keywords**: Defines custom validation rules for various Modbus request types, such as
- *   ensuring ascending order, enforcing required fields, and prohibiting disallowed fields.
- * - **Format Validation**: Detects whether an incoming request is terse or verbose based on unique
- *   identifiers and validates accordingly.
+ * - **Generated Validators**: Validation functions generated at start up by `ValidatorGenerator` from
+ *   the terse and verbose schemas, with the custom rules inlined and validation stopping at the first
+ *   error.
+ * - **Custom Rules**: Ensure ascending ranges, enforce required fields and prohibit disallowed fields
+ *   for each request type (see `@schemas/requestSchema`).
+ * - **Format Validation**: Detects whether an incoming request is terse or verbose from its identifier
+ *   property, or binary from its marker byte, and validates accordingly. Binary requests are decoded to
+ *   the terse format and validated as such; the decoded request is returned in `result.request`.
  *
  * Dependencies:
- * - `Ajv`: JSON schema validation library used for compiling and validating requests.
  * - `@schemas/requestSchema`: Template for the Modbus request schema.
  * - `@validator/schemaManager`: Manages schema creation for terse and verbose validation.
+ * - `@validator/validatorGenerator`: Generates the validation functions.
+ * - `@validator/binaryFormat`: Decodes binary requests.
  *
  * Usage:
  * Use `validate(data)` to validate an incoming request based on its format.
@@ -32,249 +34,106 @@
  */
 
 require('module-alias/register');
-const Ajv               = require('ajv');
-const schemaTemplate    = require('@schemas/requestSchema');
-const SchemaManager     = require('@validator/schemaManager');
+const schemaTemplate        = require('@schemas/requestSchema');
+const SchemaManager         = require('@validator/schemaManager');
+const ValidatorGenerator    = require('@validator/validatorGenerator');
+const BinaryFormat          = require('@validator/binaryFormat');
+
+const hasOwn = Object.prototype.hasOwnProperty;
 
 class Validator {
 
     /**
      * Constructor for Validator.
-     * Initializes AJV with custom keywords and compiles schemas.
+     * Generates the validation functions of both formats.
      * 
      * @param {Object} template - The schema template to use for validation.
      */
     constructor(template) {
-        this.ajv = new Ajv({ allErrors: true });
-        this.addCustomKeywords();
-    
         const schemaManager = new SchemaManager(template);
-        this.validateTerse = this.ajv.compile(schemaManager.terseSchema);
-        this.validateVerbose = this.ajv.compile(schemaManager.verboseSchema);
+        this.validateTerse = ValidatorGenerator.compile(schemaManager.terseSchema);
+        this.validateVerbose = ValidatorGenerator.compile(schemaManager.verboseSchema);
 
         this.result = null;
-
     }
 
     /**
      * Validates the given data against the appropriate schema based on format.
      * 
-     * @param {Object} data - The data to validate.
+     * @param {Object|Buffer} data - The data to validate, a Buffer for binary requests.
      * @returns {boolean} - True if valid, false otherwise.
      */
     validate(data) {
-        const validateFormat = { 
-            'id':         ['terse'  , this.validateTerse  ], 
-            'identifier': ['verbose', this.validateVerbose] 
-        };
+        if (BinaryFormat.isBinary(data)) {
+            return this.validateBinary(data);
+        }
 
-        for (const key in validateFormat) {
-            // Checks if incoming message is terse or verbose
-            if (data.hasOwnProperty(key)) {
-                // Store possible format
-                let result = { format: validateFormat[key][0] };
-                    
-                // Try and validate request based on format
-                result.isValid = validateFormat[key][1](data);
-                
-                // If packet could not be validated
-                if (!result.isValid) {
-                    // Generate error message
-                    const error = validateFormat[key][1].errors[0];
-                    result.msg = (error.instancePath.substring(1) + ' ' + error.message).trimStart();
-                    if (error.keyword === 'enum') {
-                        result.allowedValues = error.params.allowedValues;
-                    }
-                }
-                this.result = result
-                return result.isValid;
+        // Checks if incoming message is terse or verbose
+        let format = null;
+        let validateFormat = null;
+        if (typeof data === 'object' && data !== null) {
+            if (hasOwn.call(data, 'id')) {
+                format = 'terse';
+                validateFormat = this.validateTerse;
+            }
+            else if (hasOwn.call(data, 'identifier')) {
+                format = 'verbose';
+                validateFormat = this.validateVerbose;
             }
         }
 
-        this.result = { result: false, format: null, msg: "Unidentified format" };
-        return false;
+        if (!validateFormat) {
+            this.result = { result: false, format: null, msg: "Unidentified format" };
+            return false;
+        }
+
+        return this.validateWith(data, format, validateFormat);
     }
 
     /**
-     * Adds custom keywords to the AJV instance for specialized validation.
+     * Validates the data with the validation function of its format.
+     * 
+     * @param {Object} data - The data to validate.
+     * @param {string} format - Format of the data.
+     * @param {Function} validateFormat - Validation function of the format.
+     * @returns {boolean} - True if valid, false otherwise.
      */
-    addCustomKeywords() {
-        // Custom keyword to check ascending order in the range array
-        this.ajv.addKeyword({
-            keyword: 'ascendingItems',
-            type: 'array',
-            errors: true,
-            validate: function validate(schema, data) {
-                const valid = data.every((value, index, array) => index === 0 || array[index - 1] <= value);
-                if (!valid) {
-                    validate.errors = [{
-                        instancePath: '',
-                        schemaPath: '#/ascendingItems',
-                        keyword: 'ascendingItems',
-                        params: {},
-                        message: 'Array items are not in ascending order'
-                    }];
-                    return false;
-                }
-                return true;
+    validateWith(data, format, validateFormat) {
+        // Try and validate request based on format
+        const result = { format: format, isValid: validateFormat(data) };
+
+        // If packet could not be validated
+        if (!result.isValid) {
+            // Generate error message
+            const error = validateFormat.errors[0];
+            result.msg = (error.instancePath.substring(1) + ' ' + error.message).trimStart();
+            if (error.keyword === 'enum') {
+                result.allowedValues = error.params.allowedValues;
             }
-        });
-    
-        // Custom keyword to enforce properties required for write requests
-        this.ajv.addKeyword({
-            keyword: 'validateWriteRequest',
-            type: 'object',
-            schemaType: 'object',
-            validate: function validate(schema, data) {
-                const { func, write, values, datatype, booleanOutput, numericOutput, list, range, subfunctions, packet } = schema;
-                const errors = [];
-
-                if (data[func] === write) {
-                    if (data.hasOwnProperty(list) === data.hasOwnProperty(range)) {
-                        errors.push({
-                            keyword: 'validateWriteRequest',
-                            message: `Either "${list}" or "${range}" must be present, but not both or neither`,
-                            params: { keyword: 'validateWriteRequest' }
-                        });
-                    }
-                    else if (!data.hasOwnProperty(values)) {
-                        errors.push({
-                            keyword: 'validateWriteRequest',
-                            message: `"${values}" property must be present`,
-                            params: { keyword: 'validateWriteRequest' }
-                        });
-                    }
-                    else if (data[datatype] !== booleanOutput && data[datatype] !== numericOutput) {
-                        errors.push({
-                            keyword: 'validateWriteRequest',
-                            message: `"${datatype}" must be either "${booleanOutput}" or "${numericOutput}"`,
-                            params: { keyword: 'validateWriteRequest' }
-                        });
-                    }
-                    else if (data[range] && (data[range][1] - data[range][0] + 1) !== data[values].length) {
-                        errors.push({
-                            keyword: 'validateWriteRequest',
-                            message: `Size of "${values}" does not match "${range}"`,
-                            params: { keyword: 'validateWriteRequest' }
-                        });
-                    }
-                    else if (data[list] && data[list].length !== data[values].length) {
-                        errors.push({
-                            keyword: 'validateWriteRequest',
-                            message: `Size of "${values}" does not match "${list}"`,
-                            params: { keyword: 'validateWriteRequest' }
-                        });
-                    }
-                    else if (data.hasOwnProperty(subfunctions) || data.hasOwnProperty(packet)) {
-                        errors.push({
-                            keyword: 'validateWriteRequest',
-                            message: `"${subfunctions}" property should not be present`,
-                            params: { keyword: 'validateWriteRequest' }
-                        });
-                    }
-                }
-
-                validate.errors = errors;
-                return errors.length === 0;
-            },
-            errors: true
-        });
-    
-        // Custom keyword to enforce properties required for read requests
-        this.ajv.addKeyword({
-            keyword: 'validateReadRequest',
-            type: 'object',
-            schemaType: 'object',
-            validate: function validate(schema, data) {
-                const { func, read, values, list, range, subfunctions, packet } = schema;
-                const errors = [];
-
-                if (data[func] === read) {
-                    if (data.hasOwnProperty(list) === data.hasOwnProperty(range)) {
-                        errors.push({
-                            keyword: 'validateReadRequest',
-                            message: `Either "${list}" or "${range}" must be present, but not both or neither`,
-                            params: { keyword: 'validateReadRequest' }
-                        });
-                    }
-                    if (data.hasOwnProperty(values) || data.hasOwnProperty(subfunctions) || data.hasOwnProperty(packet)) {
-                        errors.push({
-                            keyword: 'validateReadRequest',
-                            message: `"${values}" property should not be present`,
-                            params: { keyword: 'validateReadRequest' }
-                        });
-                    }
-                }
-
-                validate.errors = errors;
-                return errors.length === 0;
-            },
-            errors: true
-        });
-    
-        // Custom keyword to enforce properties required for diagnosis requests
-        this.ajv.addKeyword({
-            keyword: 'validateDiagnosisRequest',
-            type: 'object',
-            schemaType: 'object',
-            validate: function validate(schema, data) {
-                const { func, diagnosis, subfunctions, values, datatype, list, range, packet } = schema;
-                const errors = [];
-
-                if (data[func] === diagnosis) {
-                    if (!data.hasOwnProperty(subfunctions)) {
-                        errors.push({
-                            keyword: 'validateDiagnosisRequest',
-                            message: `"${subfunctions}" property must be present`,
-                            params: { keyword: 'validateDiagnosisRequest' }
-                        });
-                    }
-                    if (data.hasOwnProperty(values) || data.hasOwnProperty(datatype) || data.hasOwnProperty(list) || data.hasOwnProperty(range) || data.hasOwnProperty(packet)) {
-                        errors.push({
-                            keyword: 'validateDiagnosisRequest',
-                            message: `No other parameters except "${subfunctions}" can be present`,
-                            params: { keyword: 'validateDiagnosisRequest' }
-                        });
-                    }
-                }
-
-                validate.errors = errors;
-                return errors.length === 0;
-            },
-            errors: true
-        });
+        }
 
-        // Custom keyword to enforce properties required for direct modbus requests
-        this.ajv.addKeyword({
-            keyword: 'validateModbusRequest',
-            type: 'object',
-            schemaType: 'object',
-            validate: function validate(schema, data) {
-                const { func, modbus, subfunctions, values, datatype, list, range, packet } = schema;
-                const errors = [];
+        this.result = result;
+        return result.isValid;
+    }
 
-                if (data[func] === modbus) {
-                    if (!data.hasOwnProperty(packet)) {
-                        errors.push({
-                            keyword: 'validateModbusRequest',
-                            message: `"${packet}" property must be present`,
-                            params: { keyword: 'validateModbusRequest' }
-                        });
-                    }
-                    if (data.hasOwnProperty(values) || data.hasOwnProperty(datatype) || data.hasOwnProperty(list) || data.hasOwnProperty(range) || data.hasOwnProperty(subfunctions)) {
-                        errors.push({
-                            keyword: 'validateModbusRequest',
-                            message: `No other parameters except "${packet}" can be present`,
-                            params: { keyword: 'validateModbusRequest' }
-                        });
-                    }
-                }
+    /**
+     * Decodes a binary request to the terse format and validates it as such.
+     * 
+     * @param {Buffer} data - The binary request.
+     * @returns {boolean} - True if valid, false otherwise.
+     */
+    validateBinary(data) {
+        let request;
+        try {
+            request = BinaryFormat.decode(data);
+        } catch (error) {
+            this.result = { format: 'binary', isValid: false, msg: error.message, request: {} };
+            return false;
+        }
 
-                validate.errors = errors;
-                return errors.length === 0;
-            },
-            errors: true
-        });
+        const isValid = this.validateWith(request, 'binary', this.validateTerse);
+        this.result.request = request;
+        return isValid;
     }
 }
 
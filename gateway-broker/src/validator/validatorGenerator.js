@@ -0,0 +1,374 @@
+/**
+ * ValidatorGenerator - Generates Request Validators
+ * ---------------------------------------------------
+ *
+ * This module turns the terse and verbose request schemas compiled by `SchemaManager` into plain
+ * JavaScript validation functions, specialized for the request schema: every property check and the
+ * custom request rules are inlined, and validation stops at the first error. Nothing is interpreted
+ * per message.
+ *
+ * Errors mirror the ones Ajv reported with this schema (instance path, keyword, params and message),
+ * in the same order, so clients keep receiving the same messages.
+ *
+ * Key Components:
+ * - **Code Generation**: `generate(schema)` emits the source of a `validate(data)` function supporting
+ *   the keywords the request schema uses: `type`, `enum`, `minimum`, `maximum`, `minItems`, `maxItems`,
+ *   `uniqueItems`, `items`, `required`, `properties`, `additionalProperties`, and the custom keywords
+ *   `ascendingItems` and `validate*Request`. Any other keyword, or type, is refused with an error
+ *   rather than left unchecked.
+ * - **Compilation**: `compile(schema)` turns the source into a function at start up, which takes about
+ *   a millisecond for both formats, less than loading pregenerated modules would.
+ *
+ * Example:
+ * ----------------
+ * const validateTerse = ValidatorGenerator.compile(schemaManager.terseSchema);
+ */
+
+class ValidatorGenerator {
+
+    /**
+     * Keywords supported on the request object, besides the request rules.
+     */
+    static rootKeywords = new Set(['type', 'properties', 'required', 'additionalProperties']);
+
+    /**
+     * Keywords supported on property values.
+     */
+    static valueKeywords = new Set(['type', 'enum', 'minimum', 'maximum', 'minItems', 'maxItems', 'uniqueItems', 'items', 'ascendingItems']);
+
+    /**
+     * Generates a validator in memory.
+     * @param {Object} schema - Compiled request schema.
+     * @returns {Function} - Validation function, holding its errors in `errors`.
+     * @throws {Error} - If the schema uses a keyword the generator does not support.
+     */
+    static compile(schema) {
+        const source = `${ValidatorGenerator.generate(schema)}\nreturn validate;`;
+        return new Function('hasOwn', source)(Object.prototype.hasOwnProperty);
+    }
+
+    /**
+     * Refuses a schema using keywords the generator does not support, which would go unchecked.
+     * @param {Object} schema - Schema of the request object or of a value.
+     * @param {Set} supported - Keywords supported there.
+     * @param {string} schemaPath - Schema path, for the error.
+     * @throws {Error} - If a keyword is not supported.
+     */
+    static checkKeywords(schema, supported, schemaPath) {
+        for (const keyword of Object.keys(schema)) {
+            if (!supported.has(keyword)) {
+                throw new Error(`Unsupported schema keyword "${keyword}" at ${schemaPath}`);
+            }
+        }
+    }
+
+    /**
+     * Generates the source of the `validate(data)` function of a schema.
+     * @param {Object} schema - Compiled request schema.
+     * @returns {string} - Source of the function declaration.
+     */
+    static generate(schema) {
+        const code = new CodeWriter();
+
+        code.line('function validate(data) {');
+        code.indent(() => {
+            ValidatorGenerator.emitRoot(code, schema);
+            code.line('validate.errors = null;');
+            code.line('return true;');
+        });
+        code.line('}');
+        code.line('validate.errors = null;');
+
+        return code.toString();
+    }
+
+    /**
+     * Emits the checks of the request object: type, required and additional properties, each
+     * property, then the custom request rules.
+     * @param {CodeWriter} code - Code being generated.
+     * @param {Object} schema - Compiled request schema.
+     */
+    static emitRoot(code, schema) {
+        const properties = Object.keys(schema.properties);
+        ValidatorGenerator.checkKeywords(schema, new Set([...ValidatorGenerator.rootKeywords, ...ValidatorGenerator.requestRules]), '#');
+        if (schema.type !== 'object') {
+            throw new Error(`Unsupported schema type "${schema.type}" at #`);
+        }
+
+        code.block(`if (!(data && typeof data === 'object' && !Array.isArray(data)))`, () => {
+            ValidatorGenerator.emitError(code, `''`, '#/type', 'type', `{ type: 'object' }`, `'must be object'`);
+        });
+
+        for (const property of schema.required) {
+            code.block(`if (data[${literal(property)}] === undefined)`, () => {
+                ValidatorGenerator.emitError(code, `''`, '#/required', 'required', `{ missingProperty: ${literal(property)} }`,
+                    literal(`must have required property '${property}'`));
+            });
+        }
+
+        if (schema.additionalProperties === false) {
+            code.block('for (const key in data)', () => {
+                code.block('switch (key)', () => {
+                    properties.forEach((property) => code.line(`case ${literal(property)}:`));
+                    code.indent(() => code.line('break;'));
+                    code.line('default:');
+                    code.indent(() => ValidatorGenerator.emitError(code, `''`, '#/additionalProperties', 'additionalProperties',
+                        '{ additionalProperty: key }', `'must NOT have additional properties'`));
+                });
+            });
+        }
+
+        properties.forEach((property, i) => {
+            const value = `value${i}`;
+            code.line(`const ${value} = data[${literal(property)}];`);
+            code.block(`if (${value} !== undefined)`, () => {
+                ValidatorGenerator.emitValue(code, schema.properties[property], value, literal(`/${pointer(property)}`), `#/properties/${pointer(property)}`);
+            });
+        });
+
+        for (const keyword of ValidatorGenerator.requestRules) {
+            if (schema[keyword]) {
+                code.line(`// ${keyword}`);
+                ValidatorGenerator[keyword](code, schema[keyword]);
+            }
+        }
+    }
+
+    /**
+     * Emits the checks of a property value, in the order Ajv applied them: type, enum, then the
+     * number and array keywords.
+     * @param {CodeWriter} code - Code being generated.
+     * @param {Object} schema - Schema of the value.
+     * @param {string} value - Expression of the value.
+     * @param {string} instancePath - Expression of the value's instance path.
+     * @param {string} schemaPath - Schema path of the value.
+     */
+    static emitValue(code, schema, value, instancePath, schemaPath) {
+        const typeCheck = {
+            integer: `typeof ${value} === 'number' && !(${value} % 1) && !isNaN(${value}) && isFinite(${value})`,
+            number:  `typeof ${value} === 'number' && isFinite(${value})`,
+            string:  `typeof ${value} === 'string'`,
+            array:   `Array.isArray(${value})`,
+        }[schema.type];
+
+        ValidatorGenerator.checkKeywords(schema, ValidatorGenerator.valueKeywords, schemaPath);
+        if (!typeCheck) {
+            throw new Error(`Unsupported schema type "${schema.type}" at ${schemaPath}`);
+        }
+
+        code.block(`if (!(${typeCheck}))`, () => {
+            ValidatorGenerator.emitError(code, instancePath, `${schemaPath}/type`, 'type', `{ type: ${literal(schema.type)} }`,
+                literal(`must be ${schema.type}`));
+        });
+
+        if (schema.enum) {
+            code.block(`if (!(${schema.enum.map((allowed) => `${value} === ${literal(allowed)}`).join(' || ')}))`, () => {
+                ValidatorGenerator.emitError(code, instancePath, `${schemaPath}/enum`, 'enum', `{ allowedValues: ${JSON.stringify(schema.enum)} }`,
+                    `'must be equal to one of the allowed values'`);
+            });
+        }
+
+        for (const [keyword, comparison] of [['maximum', '<='], ['minimum', '>=']]) {
+            if (schema[keyword] !== undefined) {
+                code.block(`if (!(${value} ${comparison} ${schema[keyword]}))`, () => {
+                    ValidatorGenerator.emitError(code, instancePath, `${schemaPath}/${keyword}`, keyword,
+                        `{ comparison: '${comparison}', limit: ${schema[keyword]} }`, literal(`must be ${comparison} ${schema[keyword]}`));
+                });
+            }
+        }
+
+        for (const [keyword, comparison, bound] of [['maxItems', '>', 'more'], ['minItems', '<', 'fewer']]) {
+            if (schema[keyword] !== undefined) {
+                code.block(`if (${value}.length ${comparison} ${schema[keyword]})`, () => {
+                    ValidatorGenerator.emitError(code, instancePath, `${schemaPath}/${keyword}`, keyword, `{ limit: ${schema[keyword]} }`,
+                        literal(`must NOT have ${bound} than ${schema[keyword]} items`));
+                });
+            }
+        }
+
+        if (schema.uniqueItems) {
+            // Numbers in strictly ascending order, as lists mostly come, hold no duplicates
+            let condition = '';
+            if (schema.items?.type === 'integer') {
+                const ascending = `${value}Ascending`;
+                condition = `if (!${ascending})`;
+                code.line(`let ${ascending} = typeof ${value}[0] === 'number';`);
+                code.block(`for (let i = 1; ${ascending} && i < ${value}.length; i++)`, () => {
+                    code.line(`${ascending} = typeof ${value}[i] === 'number' && ${value}[i - 1] < ${value}[i];`);
+                });
+            }
+
+            // Otherwise, same scan as Ajv, from the last item and skipping items of the wrong type, so the same pair is reported
+            code.block(condition, () => {
+                code.line('const indices = new Map();');
+                code.block(`for (let i = ${value}.length; i--;)`, () => {
+                    code.line(`const item = ${value}[i];`);
+                    if (schema.items?.type === 'integer') {
+                        code.block(`if (typeof item !== 'number' || item % 1 || isNaN(item) || !isFinite(item))`, () => code.line('continue;'));
+                    }
+                    code.block(`if (indices.has(item))`, () => {
+                        code.line('const j = indices.get(item);');
+                        ValidatorGenerator.emitError(code, instancePath, `${schemaPath}/uniqueItems`, 'uniqueItems', '{ i, j }',
+                            '`must NOT have duplicate items (items ## ${j} and ${i} are identical)`');
+                    });
+                    code.line('indices.set(item, i);');
+                });
+            });
+        }
+
+        if (schema.items) {
+            code.block(`for (let i = 0; i < ${value}.length; i++)`, () => {
+                code.line(`const item = ${value}[i];`);
+                ValidatorGenerator.emitValue(code, schema.items, 'item', `${instancePath} + '/' + i`, `${schemaPath}/items`);
+            });
+        }
+
+        if (schema.ascendingItems) {
+            code.block(`for (let i = 1; i < ${value}.length; i++)`, () => {
+                code.block(`if (!(${value}[i - 1] <= ${value}[i]))`, () => {
+                    ValidatorGenerator.emitError(code, `''`, '#/ascendingItems', 'ascendingItems', '{}',
+                        `'Array items are not in ascending order'`);
+                });
+            });
+        }
+    }
+
+    /**
+     * Emits the report of an error, ending the validation.
+     * @param {CodeWriter} code - Code being generated.
+     * @param {string} instancePath - Expression of the instance path.
+     * @param {string} schemaPath - Schema path of the failing keyword.
+     * @param {string} keyword - Failing keyword.
+     * @param {string} params - Expression of the error parameters.
+     * @param {string} message - Expression of the message.
+     */
+    static emitError(code, instancePath, schemaPath, keyword, params, message) {
+        code.line(`validate.errors = [{ instancePath: ${instancePath}, schemaPath: ${literal(schemaPath)}, keyword: ${literal(keyword)}, params: ${params}, message: ${message} }];`);
+        code.line('return false;');
+    }
+
+    /**
+     * Custom request rules, in the order they were registered with Ajv.
+     */
+    static requestRules = [
+        'validateWriteRequest',
+        'validateReadRequest',
+        'validateDiagnosisRequest',
+        'validateModbusRequest',
+        'validateSubscribeRequest',
+    ];
+
+    /**
+     * Emits the checks of one request rule: the conditions are tested in order, the first one holding
+     * reports its message.
+     * @param {CodeWriter} code - Code being generated.
+     * @param {string} keyword - The request rule.
+     * @param {string} condition - Expression telling whether the rule applies.
+     * @param {Array} checks - Pairs of failing condition and message.
+     */
+    static emitRequestRule(code, keyword, condition, checks) {
+        code.block(`if (${condition})`, () => {
+            for (const [failure, message] of checks) {
+                code.block(`if (${failure})`, () => {
+                    ValidatorGenerator.emitError(code, `''`, `#/${keyword}`, keyword, `{ keyword: '${keyword}' }`, literal(message));
+                });
+            }
+        });
+    }
+
+    /**
+     * Request rules: each emits the checks of its custom keyword, as named in the compiled schema.
+     * @param {CodeWriter} code - Code being generated.
+     * @param {Object} names - Names of the properties and values the rule refers to.
+     */
+    static validateWriteRequest(code, { func, write, values, datatype, booleanOutput, numericOutput, list, range, subfunctions, packet }) {
+        const [l, r, v, d] = [list, range, values, datatype].map(literal);
+        ValidatorGenerator.emitRequestRule(code, 'validateWriteRequest', `data[${literal(func)}] === ${literal(write)}`, [
+            [`hasOwn.call(data, ${l}) === hasOwn.call(data, ${r})`, `Either "${list}" or "${range}" must be present, but not both or neither`],
+            [`!hasOwn.call(data, ${v})`, `"${values}" property must be present`],
+            [`data[${d}] !== ${literal(booleanOutput)} && data[${d}] !== ${literal(numericOutput)}`, `"${datatype}" must be either "${booleanOutput}" or "${numericOutput}"`],
+            [`data[${r}] && (data[${r}][1] - data[${r}][0] + 1) !== data[${v}].length`, `Size of "${values}" does not match "${range}"`],
+            [`data[${l}] && data[${l}].length !== data[${v}].length`, `Size of "${values}" does not match "${list}"`],
+            [`hasOwn.call(data, ${literal(subfunctions)}) || hasOwn.call(data, ${literal(packet)})`, `"${subfunctions}" property should not be present`],
+        ]);
+    }
+
+    static validateReadRequest(code, { func, read, values, list, range, subfunctions, packet }) {
+        ValidatorGenerator.emitRequestRule(code, 'validateReadRequest', `data[${literal(func)}] === ${literal(read)}`, [
+            [`hasOwn.call(data, ${literal(list)}) === hasOwn.call(data, ${literal(range)})`, `Either "${list}" or "${range}" must be present, but not both or neither`],
+            [[values, subfunctions, packet].map((key) => `hasOwn.call(data, ${literal(key)})`).join(' || '), `"${values}" property should not be present`],
+        ]);
+    }
+
+    static validateDiagnosisRequest(code, { func, diagnosis, subfunctions, values, datatype, list, range, packet }) {
+        ValidatorGenerator.emitRequestRule(code, 'validateDiagnosisRequest', `data[${literal(func)}] === ${literal(diagnosis)}`, [
+            [`!hasOwn.call(data, ${literal(subfunctions)})`, `"${subfunctions}" property must be present`],
+            [[values, datatype, list, range, packet].map((key) => `hasOwn.call(data, ${literal(key)})`).join(' || '), `No other parameters except "${subfunctions}" can be present`],
+        ]);
+    }
+
+    static validateModbusRequest(code, { func, modbus, subfunctions, values, datatype, list, range, packet }) {
+        ValidatorGenerator.emitRequestRule(code, 'validateModbusRequest', `data[${literal(func)}] === ${literal(modbus)}`, [
+            [`!hasOwn.call(data, ${literal(packet)})`, `"${packet}" property must be present`],
+            [[values, datatype, list, range, subfunctions].map((key) => `hasOwn.call(data, ${literal(key)})`).join(' || '), `No other parameters except "${packet}" can be present`],
+        ]);
+    }
+
+    static validateSubscribeRequest(code, { func, subscribe, datatype, period, values, list, range, subfunctions, packet }) {
+        ValidatorGenerator.emitRequestRule(code, 'validateSubscribeRequest', `data[${literal(func)}] === ${literal(subscribe)}`, [
+            [`hasOwn.call(data, ${literal(list)}) === hasOwn.call(data, ${literal(range)})`, `Either "${list}" or "${range}" must be present, but not both or neither`],
+            [`!hasOwn.call(data, ${literal(datatype)}) || !hasOwn.call(data, ${literal(period)})`, `"${datatype}" and "${period}" properties must be present`],
+            [[values, subfunctions, packet].map((key) => `hasOwn.call(data, ${literal(key)})`).join(' || '), `"${values}" property should not be present`],
+        ]);
+    }
+}
+
+/**
+ * Accumulates indented lines of generated code.
+ */
+class CodeWriter {
+    constructor() {
+        this.lines = [];
+        this.depth = 0;
+    }
+
+    line(text) {
+        this.lines.push('    '.repeat(this.depth) + text);
+    }
+
+    indent(emit) {
+        this.depth++;
+        emit();
+        this.depth--;
+    }
+
+    block(head, emit) {
+        this.line(head ? `${head} {` : '{');
+        this.indent(emit);
+        this.line('}');
+    }
+
+    toString() {
+        return this.lines.join('\n');
+    }
+}
+
+/**
+ * Quotes a value as a JavaScript literal.
+ * @param {*} value - String or number.
+ * @returns {string} - Literal.
+ */
+function literal(value) {
+    return JSON.stringify(value);
+}
+
+/**
+ * Escapes a property name as a JSON pointer segment.
+ * @param {string} property - Property name.
+ * @returns {string} - Pointer segment.
+ */
+function pointer(property) {
+    return property.replace(/~/g, '~0').replace(/\//g, '~1');
+}
+
+module.exports = ValidatorGenerator;
@@ -0,0 +1,51 @@
+/**
+ * @file busdiscovery.h
+ * @brief Sweep of the bus for live slave addresses.
+ *
+ * Every address of a range is probed once with a short timeout that adapts to the fastest
+ * turnaround seen so far. Only borderline addresses, the ones answering late, partially or with
+ * a corrupted frame, are probed again with the full default timeout, so a silent address costs
+ * a few milliseconds instead of a full response timeout. The turnaround measured for each
+ * responding slave seeds its response timeout (see modbus_seedSlaveTimeout).
+ *
+ * External Dependencies:
+ * - <stdint.h>
+ * - ESP-IDF UART driver
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "modbusserial.h"
+#include "bustrace.h"
+#include "busscheduler.h"
+
+#define DISCOVERY_MIN_TIMEOUT_MS    5       ///< Shortest probe timeout the adaptation may reach
+#define DISCOVERY_PROBE_LENGTH      8       ///< Length of a probe frame, including CRC
+
+// Request used to probe an address
+typedef enum {
+    DISCOVERY_PROBE_READ = 0,       ///< Read one holding register at address 0 (FC 3)
+    DISCOVERY_PROBE_ECHO,           ///< Return query data diagnostic (FC 8, subfunction 0)
+} discovery_probe_t;
+
+// A responding slave (little-endian, as published)
+typedef struct __attribute__((packed)) {
+    uint8_t id;                     ///< Slave address
+    uint32_t rtt_us;                ///< Request handed to the UART until the first response byte
+} discovery_result_t;
+
+/**
+ * @brief Probe a range of addresses and report the responding slaves. Runs on the bus worker task.
+ * @param first First address to probe.
+ * @param last Last address to probe.
+ * @param probe Request used as probe.
+ * @param results Buffer for at least MODBUS_MAX_SLAVE_ID results.
+ * @return Number of responding slaves.
+ */
+uint16_t discovery_scan(uint8_t first, uint8_t last, discovery_probe_t probe, discovery_result_t* results);
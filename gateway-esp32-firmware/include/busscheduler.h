@@ -0,0 +1,97 @@
+/**
+ * @file busscheduler.h
+ * @brief Priority scheduler that serializes Modbus bus transactions requested over MQTT.
+ *
+ * Incoming frames are queued per priority class and executed one at a time by a dedicated
+ * worker task, so the MQTT task never blocks on the bus. Higher classes are always served
+ * first, while a starvation guard makes sure lower classes still progress under load.
+ *
+ * External Dependencies:
+ * - <stdint.h>
+ * - <stdbool.h>
+ * - FreeRTOS task and queue libraries
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "mbnet.h"
+
+#define SCHEDULER_FRAME_SIZE    256     ///< Largest Modbus RTU ADU
+#define SCHEDULER_TOPIC_SIZE    128     ///< Largest topic a response can be published to
+#define SCHEDULER_STACK_SIZE    4096    ///< Stack depth of the bus worker task
+#define SCHEDULER_TASK_PRIORITY 10      ///< FreeRTOS priority of the bus worker task
+
+// Priority classes, from most to least urgent
+typedef enum {
+    SCHEDULER_CLASS_CONTROL = 0,    ///< Control writes and alarms
+    SCHEDULER_CLASS_INTERACTIVE,    ///< Interactive client reads
+    SCHEDULER_CLASS_BACKGROUND,     ///< Background polling
+    SCHEDULER_CLASS_COUNT
+} scheduler_class_t;
+
+// Kinds of work the bus worker executes
+typedef enum {
+    SCHEDULER_JOB_MODBUS = 0,       ///< Modbus frame relayed from the mbnet topic
+    SCHEDULER_JOB_CONTROL,          ///< Command received on the control topic
+    SCHEDULER_JOB_EDGE,             ///< Terse JSON request encoded on the device
+} scheduler_kind_t;
+
+// Transports a job can arrive from, and its response be sent over
+typedef enum {
+    SCHEDULER_ORIGIN_MQTT = 0,      ///< Published on an MQTT topic
+    SCHEDULER_ORIGIN_UDP,           ///< Received as a UDP datagram
+} scheduler_origin_t;
+
+// A single bus transaction waiting to be executed
+typedef struct {
+    scheduler_kind_t kind;                  ///< Kind of work carried by the job
+    scheduler_origin_t origin;              ///< Transport the response is sent over
+    scheduler_class_t priority;             ///< Priority class of the transaction
+    uint16_t sequence;                      ///< Datagram sequence number, UDP jobs only
+    uint8_t header[MBNET_HEADER_SIZE];      ///< mbnet header of the request, echoed on the response
+    uint8_t headerLen;                      ///< Length of the header
+    char topic[SCHEDULER_TOPIC_SIZE];       ///< Topic the response is published to
+    uint16_t topicLen;                      ///< Length of the topic
+    uint8_t frame[SCHEDULER_FRAME_SIZE];    ///< Modbus ADU without CRC, control command or JSON request
+    uint16_t frameLen;                      ///< Length of the ADU
+} scheduler_job_t;
+
+// Per-class counters of the scheduler
+typedef struct {
+    uint32_t executed[SCHEDULER_CLASS_COUNT];   ///< Jobs handed to the handler
+    uint32_t dropped[SCHEDULER_CLASS_COUNT];    ///< Jobs refused by a full queue
+} scheduler_stats_t;
+
+extern scheduler_stats_t scheduler_stats;
+
+// Function executing a job on the bus
+typedef void (*scheduler_handler_t)(scheduler_job_t* job);
+
+/**
+ * @brief Create the class queues and start the bus worker task.
+ * @param handler Function called by the worker for every dequeued job.
+ */
+void scheduler_initialize(scheduler_handler_t handler);
+
+/**
+ * @brief Queue a job for execution according to its priority class.
+ * @param job Job to be copied into the class queue.
+ * @return True if the job was queued, false if its class queue is full.
+ */
+bool scheduler_submit(const scheduler_job_t* job);
+
+/**
+ * @brief Number of jobs waiting in a priority class.
+ * @param priority Priority class to inspect.
+ * @return Number of queued jobs.
+ */
+uint16_t scheduler_pendingJobs(scheduler_class_t priority);
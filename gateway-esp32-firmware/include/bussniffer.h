@@ -0,0 +1,47 @@
+/**
+ * @file bussniffer.h
+ * @brief Listen-only mode harvesting register values from another master's bus traffic.
+ *
+ * When the bus is configured as listen-only the gateway never transmits. Frames are delimited
+ * by the UART idle-line timeout set to the Modbus t3.5 silent interval, validated by CRC, and
+ * paired as request/response. Values carried by reads (FC 1-4) and confirmed writes (FC 5, 6,
+ * 15, 16) are compared with the last published value and only changes beyond the configured
+ * deadband are published, as terse JSON, on `gateway/<device>/data`:
+ *
+ *   {"id": 1, "dt": "no", "ls": [16, 17], "fd": [230, 231]}
+ *
+ * Sniffed transactions are also recorded in the transaction trace.
+ *
+ * External Dependencies:
+ * - <stdint.h>
+ * - ESP-IDF UART driver
+ * - MQTT client
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "uartmanager.h"
+#include "modbusserial.h"
+#include "mqttclient.h"
+#include "bustrace.h"
+
+#define SNIFFER_TOPIC_FORMAT        "gateway/%s/data"   ///< Topic harvested values are published to
+#define SNIFFER_VALUES_PER_MESSAGE  64                  ///< Values published per message at most
+#define SNIFFER_STACK_SIZE          4096                ///< Stack depth of the sniffer task
+#define SNIFFER_TASK_PRIORITY       12                  ///< Above the bus worker, frames must not be missed
+#define SNIFFER_SILENT_INTERVAL_US  1750                ///< t3.5 above 19200 baud, per Modbus over serial line
+#define SNIFFER_RX_TIMEOUT_MAX      100                 ///< Largest idle-line timeout the UART accepts, in symbols
+
+/**
+ * @brief Configure the idle-line detection and start the sniffer task.
+ */
+void sniffer_initialize();
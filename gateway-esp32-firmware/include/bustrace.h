@@ -0,0 +1,101 @@
+/**
+ * @file bustrace.h
+ * @brief In-RAM ring buffer recording the most recent Modbus bus transactions.
+ *
+ * Every transaction executed by the bus worker is copied into a fixed-size ring together with
+ * its timestamps and outcome. Recording is a couple of bounded copies, so it can stay enabled
+ * in the field without disturbing bus timing. The ring can be dumped as a binary blob and
+ * turned into a readable timeline by `python-mqtt-client/trace_decoder.py`.
+ *
+ * The bus worker and the sniffer task both record, while control commands dump and clear the ring
+ * from the bus worker, so every access holds a spinlock. A dump copies the whole ring under it, and
+ * never holds a record half written.
+ *
+ * Dump layout (little-endian):
+ *   header  | magic "MBTR", version (u8), frame bytes (u8), record count (u16), record size (u16)
+ *   records | trace_record_t, oldest first
+ *
+ * External Dependencies:
+ * - <stdint.h>
+ * - <string.h>
+ * - FreeRTOS
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "modbusserial.h"
+#include "sdkconfig.h"
+
+#define TRACE_MAGIC         "MBTR"                              ///< Dump signature
+#define TRACE_VERSION       1                                   ///< Dump layout version
+#define TRACE_DEPTH         CONFIG_GATEWAY_TRACE_DEPTH          ///< Number of transactions kept
+#define TRACE_FRAME_BYTES   CONFIG_GATEWAY_TRACE_FRAME_BYTES    ///< Bytes kept of each frame
+#define TRACE_PRIORITY_SNIFFED  3                               ///< Priority of transactions observed in listen-only mode
+
+// Outcome of a recorded transaction
+typedef enum {
+    TRACE_OUTCOME_OK = 0,       ///< Valid response received
+    TRACE_OUTCOME_TIMEOUT,      ///< No response before the timeout
+    TRACE_OUTCOME_CRC_ERROR,    ///< Response received with a bad CRC
+    TRACE_OUTCOME_EXCEPTION,    ///< Slave answered with a Modbus exception
+} trace_outcome_t;
+
+// A single recorded transaction
+typedef struct __attribute__((packed)) {
+    uint32_t sequence;                  ///< Transaction number since boot
+    int64_t requestSent_us;             ///< Request handed to the UART
+    int64_t firstByte_us;               ///< First response byte, 0 if none
+    int64_t lastByte_us;                ///< Last response byte, 0 if none
+    uint8_t outcome;                    ///< trace_outcome_t
+    uint8_t priority;                   ///< Scheduler class of the transaction
+    uint16_t txLen;                     ///< Request length on the wire
+    uint16_t rxLen;                     ///< Response length on the wire
+    uint8_t tx[TRACE_FRAME_BYTES];      ///< Request bytes, truncated to TRACE_FRAME_BYTES
+    uint8_t rx[TRACE_FRAME_BYTES];      ///< Response bytes, truncated to TRACE_FRAME_BYTES
+} trace_record_t;
+
+// Header preceding the records of a dump
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint8_t version;
+    uint8_t frameBytes;
+    uint16_t count;
+    uint16_t recordSize;
+} trace_header_t;
+
+#define TRACE_DUMP_SIZE     (sizeof(trace_header_t) + TRACE_DEPTH * sizeof(trace_record_t))
+
+// The dump travels as one message behind a 2-byte reply prefix, see gatewaycontrol.h
+_Static_assert(TRACE_FRAME_BYTES <= UINT8_MAX, "Trace frame bytes must fit the dump header");
+_Static_assert(2 + TRACE_DUMP_SIZE <= UINT16_MAX, "Trace dump must fit a published payload length");
+_Static_assert(CONFIG_MQTT_PUBLISH_OUTBOX_LIMIT == 0 || 2 + TRACE_DUMP_SIZE <= CONFIG_MQTT_PUBLISH_OUTBOX_LIMIT,
+               "Trace dump must fit the publish outbox limit, lower the trace depth or frame bytes");
+
+/**
+ * @brief Record a transaction in the ring, overwriting the oldest entry when full.
+ * @param priority Scheduler class of the transaction.
+ * @param tx Request sent on the bus, including CRC.
+ * @param txLen Length of the request.
+ * @param rx Response read from the bus, including CRC.
+ * @param rxLen Length of the response, 0 if none.
+ * @param timing Timestamps of the transaction.
+ * @param outcome Outcome of the transaction.
+ */
+void trace_record(uint8_t priority, const uint8_t* tx, uint16_t txLen, const uint8_t* rx, uint16_t rxLen,
+                  const modbus_timing_t* timing, trace_outcome_t outcome);
+
+/**
+ * @brief Copy the ring, oldest record first, into a dump buffer.
+ * @param buffer Destination buffer, at least TRACE_DUMP_SIZE bytes long.
+ * @return Number of bytes written.
+ */
+uint32_t trace_dump(uint8_t* buffer);
+
+/**
+ * @brief Discard every recorded transaction.
+ */
+void trace_clear();
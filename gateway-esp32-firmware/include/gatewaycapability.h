@@ -0,0 +1,49 @@
+/**
+ * @file gatewaycapability.h
+ * @brief Capability record announced to the broker so it can size work to this device.
+ *
+ * On every connection, and after each discovery scan, the device publishes a retained JSON
+ * record on `gateway/<device>/capability` describing its bus, its limits and the turnaround
+ * measured for each discovered slave:
+ *
+ *   {"firmware": {"version": "1.0", "idf": "v5.4", "built": "Jan 1 2025 00:00:00"},
+ *    "buses": [{"id": 0, "baud": 115200, "parity": "none", "stopBits": 1, "listenOnly": false}],
+ *    "maxFrame": 256, "maxBundle": 254, "functions": [1, 2, 3, 4, 5, 6, 15, 16],
+ *    "queueDepth": [8, 8, 16], "timeout": 500, "udp": 5020, "mbnet": 1,
+ *    "codec": {"maxPoints": 512, "maxRequest": 254, "maxTopic": 127},
+ *    "slaves": [{"id": 1, "turnaround": 1830, "timeout": 10}]}
+ *
+ * Turnarounds are in microseconds, timeouts in milliseconds. queueDepth lists the scheduler
+ * queue depth of each priority class, most urgent first. udp is the port frames are accepted on
+ * as datagrams, 0 when the UDP transport is disabled. mbnet is the header version echoed on
+ * responses (see mbnet.h), letting the broker keep several frames in flight. codec bounds the terse requests the device
+ * encodes itself (see gatewaycodec.h), every limit is 0 when the edge codec is disabled.
+ *
+ * External Dependencies:
+ * - <stdint.h>
+ * - ESP-IDF app description
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "busscheduler.h"
+#include "modbusserial.h"
+#include "mqttclient.h"
+#include "gatewaycodec.h"
+
+#define CAPABILITY_TOPIC_FORMAT     "gateway/%s/capability"     ///< Topic the record is published to
+#define CAPABILITY_BASE_SIZE        768                         ///< Record size without slaves
+#define CAPABILITY_SLAVE_SIZE       48                          ///< Record size per discovered slave
+
+/**
+ * @brief Build the capability record and publish it, retained.
+ */
+void capability_publish();
@@ -0,0 +1,82 @@
+/**
+ * @file gatewaycodec.h
+ * @brief Terse JSON requests encoded and answered on the device instead of the broker.
+ *
+ * With the edge codec enabled the device handles terse read and write requests itself. The broker
+ * decides which ones, from the limits announced in the capability record, and hands each of them
+ * over on `<client>/<device>/edge`, a topic only the broker publishes to and only the device reads:
+ *
+ *   {"id": 1, "fn": "r", "dt": "no", "rg": [0, 9]}
+ *   {"id": 1, "fn": "w", "dt": "bo", "ls": [4, 2, 7], "dv": [1, 0, 1]}
+ *
+ * Addresses are split into the fewest transactions the protocol limits allow, and the request is
+ * answered on `<client>/<device>/response` with the same terse response the broker would build:
+ * the request itself, the fetched values (`fd`) of reads and the status (`st`), plus a message
+ * (`mg`) on failure. Other requests (verbose, diagnosis and raw Modbus) are left to the broker.
+ *
+ * The limits announced in the capability record (`codec.maxPoints`, `codec.maxRequest`,
+ * `codec.maxTopic`) tell the broker which requests it must still encode itself. Until the broker has
+ * the record, it encodes every request and hands none over, so no request is executed twice. The
+ * broker no longer answers the requests it hands over, so the device answers every one of them,
+ * with a failed status when it cannot execute it.
+ *
+ * External Dependencies:
+ * - <stdint.h>
+ * - cJSON (ESP-IDF json component)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "busscheduler.h"
+#include "bustrace.h"
+#include "modbusserial.h"
+#include "mqttclient.h"
+
+#define CODEC_TOPIC_SUFFIX          "/edge"     ///< Operator of the topic requests are handed over on
+#define CODEC_RESPONSE_OPERATOR     "response"  ///< Operator the response is published to
+#define CODEC_MAX_REQUEST           (SCHEDULER_FRAME_SIZE - 2)  ///< Largest request handled, in bytes
+#define CODEC_MAX_TOPIC             (SCHEDULER_TOPIC_SIZE - 1)  ///< Longest topic handled, in bytes
+
+#define CODEC_READ_BITS_LIMIT       2000    ///< Coils or discrete inputs per read
+#define CODEC_READ_REGISTERS_LIMIT  125     ///< Registers per read
+#define CODEC_WRITE_BITS_LIMIT      1968    ///< Coils per write
+#define CODEC_WRITE_REGISTERS_LIMIT 123     ///< Registers per write
+
+/**
+ * @brief Check whether a topic is an edge topic, carrying a request handed over by the broker.
+ * @param topic Topic of the incoming message, not null-terminated.
+ * @param topicLen Length of the topic.
+ * @return True if the topic ends with the edge operator.
+ */
+bool codec_isEdgeTopic(const char* topic, uint16_t topicLen);
+
+/**
+ * @brief Tell the scheduler class of a request without parsing it: writes are control traffic.
+ * @param request Request payload, not null-terminated.
+ * @param requestLen Length of the request.
+ * @return Scheduler class of the request.
+ */
+scheduler_class_t codec_requestPriority(const char* request, uint16_t requestLen);
+
+/**
+ * @brief Execute a terse request on the bus and publish its response. Runs on the bus worker task.
+ * @param job Job holding the request topic and the JSON request.
+ */
+void codec_handleRequest(scheduler_job_t* job);
+
+/**
+ * @brief Answer a request that is not executed, echoing it with a failed status.
+ * @param topic Edge topic, not null-terminated.
+ * @param topicLen Length of the topic.
+ * @param request JSON request, not null-terminated.
+ * @param requestLen Length of the request.
+ * @param message Reason reported to the client.
+ */
+void codec_refuseRequest(const char* topic, uint16_t topicLen, const char* request, uint16_t requestLen, const char* message);
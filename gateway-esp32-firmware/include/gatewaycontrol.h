@@ -0,0 +1,72 @@
+/**
+ * @file gatewaycontrol.h
+ * @brief Commands received on the device control topic.
+ *
+ * The broker publishes to `<client>/<device>/control` a payload made of an origin tag (see mbnet.h),
+ * a command byte and optional arguments. The device answers on the same topic with its own
+ * origin tag, the command byte and the command's result. Only the device may use its control
+ * topics: users publish their commands on `<user>/<device>/diagnostics`, and the broker relays
+ * them here and the replies back. Commands are executed by the bus worker, so they observe the
+ * bus state between two transactions.
+ *
+ * CONTROL_CMD_DISCOVER takes optional arguments: first address, last address and probe
+ * (discovery_probe_t), defaulting to a read probe of the whole unicast range.
+ *
+ * CONTROL_CMD_UDP_SESSION takes the UDP_TOKEN_SIZE bytes of the session token handed by the
+ * broker, see udptransport.h. It is only answered when the UDP transport is enabled, and only
+ * accepted on `gateway/<device>/control`, where the broker publishes.
+ *
+ * External Dependencies:
+ * - <stdint.h>
+ * - <stdbool.h>
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "busscheduler.h"
+#include "bustrace.h"
+#include "busdiscovery.h"
+#include "gatewaycapability.h"
+#include "mqttclient.h"
+#include "mbnet.h"
+#include "udptransport.h"
+
+#define CONTROL_TOPIC_SUFFIX    "/control"  ///< Operator of the control topic
+#define CONTROL_BROKER_PREFIX   "gateway/"  ///< Client of the control topic the broker publishes on
+
+// Commands accepted on the control topic
+typedef enum {
+    CONTROL_CMD_TRACE_DUMP  = 0x01,     ///< Reply with the binary transaction trace
+    CONTROL_CMD_TRACE_CLEAR = 0x02,     ///< Discard the transaction trace
+    CONTROL_CMD_STATS       = 0x03,     ///< Reply with the scheduler and publish counters
+    CONTROL_CMD_DISCOVER    = 0x04,     ///< Scan the bus, reply with a count and discovery_result_t list
+    CONTROL_CMD_UDP_SESSION = 0x05,     ///< Accept datagrams carrying the given token, reply empty
+} control_command_t;
+
+// Reply to CONTROL_CMD_STATS (little-endian)
+typedef struct __attribute__((packed)) {
+    uint16_t pending[SCHEDULER_CLASS_COUNT];    ///< Jobs waiting per scheduler class
+    uint32_t executed[SCHEDULER_CLASS_COUNT];   ///< Jobs executed per scheduler class
+    uint32_t dropped[SCHEDULER_CLASS_COUNT];    ///< Jobs refused per scheduler class
+    uint32_t outboxBytes;                       ///< Bytes waiting in the MQTT outbox
+    uint32_t published;                         ///< Messages handed to the MQTT outbox
+    uint32_t publishDropped;                    ///< Messages refused by a full outbox
+} control_stats_t;
+
+/**
+ * @brief Check whether a topic is a control topic.
+ * @param topic Topic of the incoming message, not null-terminated.
+ * @param topicLen Length of the topic.
+ * @return True if the topic ends with the control operator.
+ */
+bool control_isControlTopic(const char* topic, uint16_t topicLen);
+
+/**
+ * @brief Execute a control command and publish its result. Runs on the bus worker task.
+ * @param job Job holding the command byte and its arguments.
+ */
+void control_handleCommand(scheduler_job_t* job);
@@ -0,0 +1,58 @@
+/**
+ * @file mbnet.h
+ * @brief Layout of the header that prefixes every frame exchanged on the mbnet topic.
+ *
+ * Every mbnet payload starts with a tag byte followed by the raw Modbus ADU (without CRC).
+ * The low nibble tells who produced the frame, the next two bits carry the priority class the
+ * broker assigned to the request and the top two bits the header version. A tag of 0xFF marks
+ * frames that must be ignored.
+ *
+ *   bit 7..6 | bit 5..4       | bit 3..0
+ *   version  | priority class | origin
+ *
+ * Version 0 is the bare tag. Version 1 (sequenced) extends it into a header that lets the broker
+ * keep several frames in flight and match the responses in any order:
+ *
+ *   byte 0 | byte 1..2         | byte 3 | byte 4
+ *   tag    | sequence (BE u16) | bus id | flags
+ *
+ * The device echoes the header of a request on its response, only swapping the origin, and sets
+ * MBNET_FLAG_REFUSED when the scheduler dropped the frame.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define MBNET_TAG_IGNORE        0xFF    ///< Frame must not be processed
+
+#define MBNET_ORIGIN_MASK       0x0F    ///< Bits holding the frame origin
+#define MBNET_ORIGIN_BROKER     0x00    ///< Frame published by the broker
+#define MBNET_ORIGIN_DEVICE     0x01    ///< Frame published by this device
+
+#define MBNET_CLASS_SHIFT       4       ///< Position of the priority class inside the tag
+#define MBNET_CLASS_MASK        0x30    ///< Bits holding the priority class
+
+#define MBNET_VERSION_MASK      0xC0    ///< Bits holding the header version
+#define MBNET_VERSION_LEGACY    0x00    ///< Bare tag byte
+#define MBNET_VERSION_SEQUENCED 0x40    ///< Tag, sequence number, bus id and flags
+#define MBNET_VERSION_CURRENT   1       ///< Header version announced in the capability record
+#define MBNET_HEADER_SIZE       5       ///< Length of the sequenced header
+
+#define MBNET_FLAG_REFUSED      0x01    ///< The device dropped the frame, its bus queue being full
+
+/**
+ * @brief Extract the origin of an mbnet frame from its tag byte.
+ */
+#define mbnet_tagOrigin(tag)    ((uint8_t)((tag) & MBNET_ORIGIN_MASK))
+
+/**
+ * @brief Extract the priority class of an mbnet frame from its tag byte.
+ */
+#define mbnet_tagClass(tag)     ((uint8_t)(((tag) & MBNET_CLASS_MASK) >> MBNET_CLASS_SHIFT))
+
+/**
+ * @brief Length of the header started by a tag byte, 0 for unknown versions.
+ */
+#define mbnet_headerLength(tag) ((uint8_t)(((tag) & MBNET_VERSION_MASK) == MBNET_VERSION_LEGACY ? 1 : \
+                                           ((tag) & MBNET_VERSION_MASK) == MBNET_VERSION_SEQUENCED ? MBNET_HEADER_SIZE : 0))
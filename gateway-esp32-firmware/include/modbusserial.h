@@ -20,11 +20,30 @@
 #include <stdlib.h>
 #include <string.h>
 #include "driver/uart.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 #include "uartmanager.h"
 
 // Timeout duration for inter-symbol in milliseconds
 extern uint16_t interSymbolTimeout_ms;
 
+// Transmission time of a single character in microseconds
+extern uint32_t characterTime_us;
+
+// Timestamps of the last bus transaction, in microseconds since boot
+typedef struct {
+    int64_t requestSent_us;     ///< Request handed to the UART
+    int64_t firstByte_us;       ///< First response byte received, 0 if none
+    int64_t lastByte_us;        ///< Last response byte received, 0 if none
+} modbus_timing_t;
+
+extern modbus_timing_t modbus_lastTiming;
+
+#define MODBUS_TX_TIMEOUT_MS        1000    ///< Longest wait for a request to leave the line
+#define MODBUS_MAX_SLAVE_ID         247     ///< Highest unicast slave address
+#define MODBUS_MIN_TIMEOUT_MS       10      ///< Shortest response timeout seeded from a measured turnaround
+#define MODBUS_TIMEOUT_RTT_FACTOR   4       ///< Seeded timeout as a multiple of the measured turnaround
+
 /**
  * @brief Initialize the Modbus communication interface.
  */
@@ -46,6 +65,27 @@ void modbus_sendRequestPacket(uint8_t* request, uint16_t length);
  */
 uint16_t modbus_readResponsePacket(uint8_t* response, uint16_t length, uint16_t timeout_ms);
 
+/**
+ * @brief Response timeout of a slave, the configured default unless seeded by a discovery scan.
+ * @param id Slave address.
+ * @return Timeout for the first response byte in milliseconds.
+ */
+uint16_t modbus_getSlaveTimeout(uint8_t id);
+
+/**
+ * @brief Turnaround time of a slave measured by the last discovery scan.
+ * @param id Slave address.
+ * @return Turnaround in microseconds, 0 if the slave was never measured.
+ */
+uint32_t modbus_getSlaveTurnaround(uint8_t id);
+
+/**
+ * @brief Seed the response timeout of a slave from a measured turnaround time.
+ * @param id Slave address.
+ * @param turnaround_us Time between the end of the request and the first response byte.
+ */
+void modbus_seedSlaveTimeout(uint8_t id, uint32_t turnaround_us);
+
 /**
  * @brief Calculate inter-symbol timeout based on UART configuration.
  * @param uart_config UART configuration parameters.
@@ -53,6 +93,13 @@ uint16_t modbus_readResponsePacket(uint8_t* response, uint16_t length, uint16_t
  */
 uint16_t modbus_calculateIntersymbolTimeout(const uart_config_t* uart_config);
 
+/**
+ * @brief Calculate the transmission time of a single character based on UART configuration.
+ * @param uart_config UART configuration parameters.
+ * @return Character time in microseconds.
+ */
+uint32_t modbus_calculateCharacterTime(const uart_config_t* uart_config);
+
 /**
  * @brief Evaluate the CRC of a Modbus message.
  * @param data Pointer to data buffer.
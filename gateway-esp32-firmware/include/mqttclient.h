@@ -29,6 +29,8 @@
 #include "lwip/netdb.h"
 #include "esp_log.h"
 #include "mqtt_client.h"
+#include "esp_random.h"
+#include "tlstransport.h"
 
 // Device ID and topic for MQTT communications
 extern const char mqtt_deviceID[];
@@ -38,13 +40,21 @@ extern char mqtt_topic[];
 extern esp_mqtt_client_handle_t mqtt_client;
 extern esp_mqtt_client_config_t mqtt_configure;
 
+// Publish path counters
+typedef struct {
+    uint32_t enqueued;      ///< Messages handed to the outbox
+    uint32_t dropped;       ///< Messages refused by a full outbox
+} mqtt_publishStats_t;
+
+extern mqtt_publishStats_t mqtt_publishStats;
+
 /**
  * @brief Start the MQTT client and establish a connection with the broker.
  */
 void mqtt_clientStart();
 
 /**
- * @brief Publish a message to an MQTT topic.
+ * @brief Queue a message for publishing without waiting on the network.
  * @param topic MQTT topic to publish the message.
  * @param topic_len Length of the topic string.
  * @param payload Message payload to publish.
@@ -52,12 +62,32 @@ void mqtt_clientStart();
  */
 void mqtt_publishMessage(char* topic, uint16_t topic_len, char* payload, uint16_t payload_len);
 
+/**
+ * @brief Queue a retained message, kept by the broker for clients subscribing later.
+ * @param topic Null-terminated MQTT topic.
+ * @param payload Message payload to publish.
+ * @param payload_len Length of the payload.
+ */
+void mqtt_publishRetained(const char* topic, const char* payload, uint32_t payload_len);
+
+/**
+ * @brief Number of bytes waiting in the MQTT outbox.
+ * @return Outbox size in bytes.
+ */
+uint32_t mqtt_outboxSize();
+
 /**
  * @brief Set a data event handler for MQTT messages.
  * @param handler Event handler function pointer.
  */
 void mqtt_setDataEventHandler(esp_event_handler_t handler);
 
+/**
+ * @brief Set a handler called every time the client connects to the broker.
+ * @param handler Event handler function pointer.
+ */
+void mqtt_setConnectedEventHandler(esp_event_handler_t handler);
+
 /**
  * @brief Control the MQTT events, handling connection and message events.
  * @param arg Optional argument for the handler.
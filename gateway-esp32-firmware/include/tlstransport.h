@@ -0,0 +1,33 @@
+/**
+ * @file tlstransport.h
+ * @brief TLS transport for the MQTT client that resumes the previous session on reconnect.
+ *
+ * The stock esp-mqtt TLS transport starts every connection with a full handshake. This transport
+ * wraps esp-tls instead and keeps the client session (ticket or session ID) of the last
+ * connection, offering it on the next one. A broker accepting it answers with an abbreviated
+ * handshake: no certificate chain, no key exchange, one round trip less. A session the broker
+ * does not accept only costs a full handshake, and a failed connection drops it.
+ *
+ * External Dependencies:
+ * - ESP-IDF esp-tls and tcp_transport components
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/select.h>
+#include "esp_tls.h"
+#include "esp_transport.h"
+#include "esp_crt_bundle.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+/**
+ * @brief Create the TLS transport to be handed to the MQTT client configuration.
+ * @return Transport handle, owned and destroyed by the MQTT client.
+ */
+esp_transport_handle_t tls_transportInit();
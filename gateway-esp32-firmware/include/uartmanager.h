@@ -25,9 +25,15 @@
 #define RTS_PIN 4         ///< Request to Send pin (Driver Enable for RS485)
 #define CTS_PIN UART_PIN_NO_CHANGE ///< Clear to Send pin (unused)
 
+#define UART_SNIFFER_BUFFER_SIZE 1024   ///< RX buffer size in listen-only mode
+#define UART_EVENT_QUEUE_SIZE 32        ///< Driver event queue depth in listen-only mode
+
 // UART configuration structure
 extern uart_config_t uart_configure;
 
+// UART driver event queue, only created in listen-only mode
+extern QueueHandle_t uart_eventQueue;
+
 /**
  * @brief Initialize UART with predefined configurations.
  */
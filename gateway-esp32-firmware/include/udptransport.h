@@ -0,0 +1,63 @@
+/**
+ * @file udptransport.h
+ * @brief Datagram transport for Modbus frames exchanged with a broker on the same LAN.
+ *
+ * MQTT remains the control plane: the broker learns the UDP port from the capability record and
+ * hands the device a session token with CONTROL_CMD_UDP_SESSION. Frames are then exchanged as
+ * single datagrams, skipping TCP and the QoS 2 handshake:
+ *
+ *   version (u8) | type (u8) | token (4 bytes) | sequence (u16, big-endian) | mbnet tag | ADU
+ *
+ * Datagrams carrying another token are dropped. Retransmission is left to the broker: a request
+ * whose sequence is already queued is ignored, and one that was already answered gets the cached
+ * response again, so a retransmitted write is never executed twice.
+ *
+ * External Dependencies:
+ * - <stdint.h>
+ * - lwIP sockets
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "busscheduler.h"
+#include "mbnet.h"
+#include "modbusserial.h"
+
+#define UDP_VERSION             1       ///< Datagram layout version
+#define UDP_TYPE_REQUEST        0x01    ///< Frame sent by the broker
+#define UDP_TYPE_RESPONSE       0x02    ///< Frame answered by the device
+#define UDP_TOKEN_SIZE          4       ///< Bytes of the session token
+#define UDP_HEADER_SIZE         9       ///< Bytes before the ADU, tag included
+#define UDP_CACHE_DEPTH         4       ///< Answered sequences kept for retransmitted requests
+#define UDP_STACK_SIZE          4096    ///< Stack depth of the receiving task
+#define UDP_TASK_PRIORITY       9       ///< Below the bus worker
+
+/**
+ * @brief Open the socket and start the receiving task.
+ * @param submit Function queuing a received frame, returns false if the queue is full.
+ */
+void udp_initialize(bool (*submit)(const scheduler_job_t* job));
+
+/**
+ * @brief Accept datagrams carrying a new session token, dropping the answers cached for the old one.
+ * @param token Session token handed by the broker.
+ */
+void udp_setSession(const uint8_t token[UDP_TOKEN_SIZE]);
+
+/**
+ * @brief Send the response to a frame received as a datagram, and cache it for retransmissions.
+ * @param sequence Sequence number of the request.
+ * @param response Modbus response without CRC, or the "Null" error payload.
+ * @param responseLen Length of the response.
+ */
+void udp_sendResponse(uint16_t sequence, const uint8_t* response, uint16_t responseLen);
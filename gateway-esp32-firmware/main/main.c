@@ -7,6 +7,14 @@
 #include "mqttclient.h"
 #include "uartmanager.h"
 #include "modbusserial.h"
+#include "busscheduler.h"
+#include "bustrace.h"
+#include "gatewaycontrol.h"
+#include "mbnet.h"
+#include "bussniffer.h"
+#include "gatewaycapability.h"
+#include "udptransport.h"
+#include "gatewaycodec.h"
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -14,7 +22,10 @@
 
 // Forward declarations for event handling functions
 void mqtt_dataEventHandler(void*, esp_event_base_t, int32_t, void*);
-void gatewayHandler(esp_mqtt_event_handle_t event);
+void mqtt_connectedEventHandler(void*, esp_event_base_t, int32_t, void*);
+void gateway_jobHandler(scheduler_job_t* job);
+void gatewayHandler(scheduler_job_t* job);
+void gateway_publishResponse(scheduler_job_t* job, uint8_t* response, uint16_t responseLen);
 
 // Global variable to hold the MQTT event data
 esp_mqtt_event_handle_t mqttEventData;
@@ -30,13 +41,35 @@ void app_main(void) {
 
     mqtt_clientStart();
     mqtt_setDataEventHandler(mqtt_dataEventHandler);
+    mqtt_setConnectedEventHandler(mqtt_connectedEventHandler);
 
     modbus_initialize();
+    scheduler_initialize(gateway_jobHandler);
+
+#if CONFIG_GATEWAY_BUS_LISTEN_ONLY
+    sniffer_initialize();
+#endif
+
+#if CONFIG_GATEWAY_UDP_TRANSPORT
+    udp_initialize(scheduler_submit);
+#endif
+}
+
+/**
+ * @brief Event handler for broker connections. Announces the device capabilities, so the broker
+ *        sizes its requests to this device.
+ * @param handlerArgs User data provided during registration.
+ * @param base Event base for the handler (e.g., MQTT event base).
+ * @param eventId Specific event ID.
+ * @param eventData Data associated with the event, esp_mqtt_event_handle_t.
+ */
+void mqtt_connectedEventHandler(void *handlerArgs, esp_event_base_t base, int32_t eventId, void *eventData) {
+    capability_publish();
 }
 
 /**
- * @brief Event handler for incoming MQTT messages. Processes the message, interacts with Modbus,
- *        and publishes the Modbus response back to MQTT.
+ * @brief Event handler for incoming MQTT messages. Queues the carried Modbus frame or control
+ *        command on the bus scheduler according to the priority class set by the broker.
  * @param handlerArgs User data provided during registration.
  * @param base Event base for the handler (e.g., MQTT event base).
  * @param eventId Specific event ID.
@@ -44,87 +77,168 @@ void app_main(void) {
  */
 void mqtt_dataEventHandler(void *handlerArgs, esp_event_base_t base, int32_t eventId, void *eventData) {   
     mqttEventData = eventData;
+    static scheduler_job_t job;
+
+#if CONFIG_GATEWAY_EDGE_CODEC
+    // Requests handed over by the broker carry JSON without a tag, and are answered here whatever happens.
+    // Only the first fragment of a message carries its topic, the request is then refused without echo.
+    if (codec_isEdgeTopic(mqttEventData->topic, mqttEventData->topic_len)) {
+        bool whole = mqttEventData->data_len == mqttEventData->total_data_len;
+        if (!whole || mqttEventData->topic_len > CODEC_MAX_TOPIC || mqttEventData->data_len > CODEC_MAX_REQUEST) {
+            codec_refuseRequest(mqttEventData->topic, mqttEventData->topic_len, mqttEventData->data,
+                                whole ? mqttEventData->data_len : 0, "Request Too Large");
+            return;
+        }
+
+        job.kind = SCHEDULER_JOB_EDGE;
+        job.origin = SCHEDULER_ORIGIN_MQTT;
+        job.priority = codec_requestPriority(mqttEventData->data, mqttEventData->data_len);
+        job.topicLen = mqttEventData->topic_len;
+        memcpy(job.topic, mqttEventData->topic, job.topicLen);
+        job.frameLen = mqttEventData->data_len;
+        memcpy(job.frame, mqttEventData->data, job.frameLen);
+
+        if (!scheduler_submit(&job))
+            codec_refuseRequest(job.topic, job.topicLen, (const char*)job.frame, job.frameLen, "Bus Saturated");
+        return;
+    }
+#endif
 
-    // Ignore messages originating from this device
-    if (mqttEventData->data[0] == 0xFF)
+    // Ignore empty and fragmented messages, frames never span more than one event
+    if (mqttEventData->data_len < 1 || mqttEventData->data_len != mqttEventData->total_data_len)
         return;
 
-    // Process the incoming message
-    gatewayHandler(eventData);
+    uint8_t tag = (uint8_t)mqttEventData->data[0];
+    uint8_t headerLen = mbnet_headerLength(tag);
+
+    // Ignore messages flagged to be skipped, the ones originating from this device and unknown header versions
+    if (tag == MBNET_TAG_IGNORE || mbnet_tagOrigin(tag) != MBNET_ORIGIN_BROKER || headerLen == 0 || mqttEventData->data_len < headerLen)
+        return;
+
+    if (mqttEventData->topic_len >= SCHEDULER_TOPIC_SIZE || mqttEventData->data_len - headerLen > SCHEDULER_FRAME_SIZE - 2) {
+        ESP_LOGW("MQTTHANDLER", "Discarding oversized message");
+        return;
+    }
+
+    // Copy the message so the bus worker owns it after this handler returns
+    job.kind = control_isControlTopic(mqttEventData->topic, mqttEventData->topic_len) ? SCHEDULER_JOB_CONTROL : SCHEDULER_JOB_MODBUS;
+    job.origin = SCHEDULER_ORIGIN_MQTT;
+    job.priority = job.kind == SCHEDULER_JOB_CONTROL ? SCHEDULER_CLASS_CONTROL : (scheduler_class_t)mbnet_tagClass(tag);
+    job.topicLen = mqttEventData->topic_len;
+    memcpy(job.topic, mqttEventData->topic, job.topicLen);
+    job.headerLen = headerLen;
+    memcpy(job.header, mqttEventData->data, headerLen);
+    job.frameLen = mqttEventData->data_len - headerLen;
+    memcpy(job.frame, (uint8_t*)(mqttEventData->data + headerLen), job.frameLen);
+
+    // Answer right away when the bus is saturated, so the broker does not wait for a timeout
+    if (!scheduler_submit(&job) && job.kind == SCHEDULER_JOB_MODBUS) {
+        if (headerLen == MBNET_HEADER_SIZE)
+            job.header[4] |= MBNET_FLAG_REFUSED;
+
+        uint8_t response[6];
+        memcpy(response, "Null", 4);
+        gateway_publishResponse(&job, response, 6);
+    }
 }
 
 /**
- * @brief Handles the Modbus communication logic by parsing the MQTT payload, sending a request to Modbus,
- *        and publishing the response back to MQTT.
- * @param event MQTT event data handle containing the message and topic information.
+ * @brief Dispatches a job dequeued by the bus scheduler to the matching handler.
+ * @param job Queued job.
  */
-void gatewayHandler(esp_mqtt_event_handle_t event) {
-    ESP_LOGI("MQTTHANDLER", "Handling incoming MQTT message");
+void gateway_jobHandler(scheduler_job_t* job) {
+    if (job->kind == SCHEDULER_JOB_CONTROL)
+        control_handleCommand(job);
+#if CONFIG_GATEWAY_EDGE_CODEC
+    else if (job->kind == SCHEDULER_JOB_EDGE)
+        codec_handleRequest(job);
+#endif
+    else
+        gatewayHandler(job);
+}
 
-    // Ignore messages with a specific starting byte (e.g., 0x01)
-    if (event->data[0] == 0x01)
-        return;
+/**
+ * @brief Handles the Modbus communication logic for a queued job, sending the request to Modbus
+ *        and publishing the response back to MQTT. Runs on the bus scheduler worker task.
+ * @param job Queued job holding the Modbus frame and the topic to answer on.
+ */
+void gatewayHandler(scheduler_job_t* job) {
+    ESP_LOGD("MQTTHANDLER", "Handling queued job of class %d", job->priority);
 
-    // Parse the payload and prepare for Modbus
-    ESP_LOGI("MQTTHANDLER", "Parsing payload");
-    uint8_t payload[event->data_len + 1]; // Additional byte for CRC
-    uint16_t payloadLen = event->data_len + 1;
-    memcpy(payload, (uint8_t*)(event->data + 1), event->data_len);
+    // Prepare the payload for Modbus, with an additional two bytes for CRC
+    uint8_t payload[job->frameLen + 2];
+    uint16_t payloadLen = job->frameLen + 2;
+    memcpy(payload, job->frame, job->frameLen);
 
     // Calculate CRC for payload and append it
-    ESP_LOGI("MQTTHANDLER", "Encoding CRC");
     uint16_t crc = modbus_evaluateCRC(payload, payloadLen - 2);
     payload[payloadLen - 2] = lowByte(crc);
     payload[payloadLen - 1] = highByte(crc);
 
-    // Display the parsed payload for debugging
-    ESP_LOGI("MQTTHANDLER", "Payload:");
-    for (unsigned char k = 0; k < payloadLen; k++) {
-        printf("%02x ", payload[k]);
-    }
-    printf("\n");
+    ESP_LOG_BUFFER_HEXDUMP("MQTTHANDLER", payload, payloadLen, ESP_LOG_DEBUG);
+
+#if CONFIG_GATEWAY_BUS_LISTEN_ONLY
+    // The bus belongs to another master, requests are answered without transmitting
+    uint8_t refusal[6];
+    memcpy(refusal, "Null", 4);
+    gateway_publishResponse(job, refusal, 6);
+    return;
+#endif
 
     // Send the prepared payload over UART and await a Modbus response
-    ESP_LOGI("MQTTHANDLER", "Sending to Modbus slave");
     uint8_t response[265];
     uint16_t responseLen = 0;
+    trace_outcome_t outcome = TRACE_OUTCOME_TIMEOUT;
 
     // Attempt to send the payload and read a response
     for (uint8_t attempts = 0; attempts < 1; attempts++) {
-        ESP_LOGI("MQTTHANDLER", "Attempting to send");
-
         modbus_sendRequestPacket(payload, payloadLen);
-        responseLen = modbus_readResponsePacket(response, 265, 500); // 500ms timeout
+        responseLen = modbus_readResponsePacket(response, 265, modbus_getSlaveTimeout(payload[0]));
 
         // Check for valid response and CRC verification
         if (responseLen > 0 && !modbus_evaluateCRC(response, responseLen)) {
-            ESP_LOGI("MQTTHANDLER", "Received valid response");
+            outcome = (responseLen > 1 && (response[1] & 0x80)) ? TRACE_OUTCOME_EXCEPTION : TRACE_OUTCOME_OK;
             break;
         }
+        outcome = responseLen > 0 ? TRACE_OUTCOME_CRC_ERROR : TRACE_OUTCOME_TIMEOUT;
     }
 
+    trace_record(job->priority, payload, payloadLen, response, responseLen, &modbus_lastTiming, outcome);
+    ESP_LOG_BUFFER_HEXDUMP("MQTTHANDLER", response, responseLen, ESP_LOG_DEBUG);
+
     // Handle cases where no response is received from Modbus
     if (responseLen < 1) {
         ESP_LOGI("MQTTHANDLER", "No response received, handling error");
         memcpy(response, "Null", 4); // Send "Null" as error response
         responseLen = 6;
-        printf("Error\n");
     }
 
-    // Prepare and publish the Modbus response back to MQTT
-    ESP_LOGI("MQTTHANDLER", "Publishing response to MQTT broker");
+    // Publish the Modbus response back to the original MQTT topic
+    gateway_publishResponse(job, response, responseLen);
+}
 
-    uint8_t taggedResponse[266];
-    taggedResponse[0] = 0x01; // Adds a tag saying the data comes from the esp32
-    memcpy((char*)(taggedResponse + 1), response, responseLen - 2);
+/**
+ * @brief Tags a Modbus response as coming from this device and publishes it to the job's topic,
+ *        or sends it back as a datagram if the request came over UDP.
+ * @param job Job the response belongs to.
+ * @param response Modbus response, including the two CRC bytes which are not published.
+ * @param responseLen Length of the response.
+ */
+void gateway_publishResponse(scheduler_job_t* job, uint8_t* response, uint16_t responseLen) {
+#if CONFIG_GATEWAY_UDP_TRANSPORT
+    if (job->origin == SCHEDULER_ORIGIN_UDP) {
+        udp_sendResponse(job->sequence, response, responseLen - 2);
+        return;
+    }
+#endif
 
-    // Publish the message to the original MQTT topic
-    mqtt_publishMessage((char*)(event->topic), event->topic_len, (char*)taggedResponse, responseLen - 1);
+    ESP_LOGD("MQTTHANDLER", "Publishing response to MQTT broker");
 
-    // Display the response payload for debugging
-    ESP_LOGI("MQTTHANDLER", "Response Payload:");
-    for (uint8_t k = 0; k < responseLen; k++) {
-        printf("%02x ", response[k]);
-    }
-    printf("\n");
+    // Echoes the request header, tagged as coming from the esp32
+    uint8_t taggedResponse[MBNET_HEADER_SIZE + 264];
+    memcpy(taggedResponse, job->header, job->headerLen);
+    taggedResponse[0] = (taggedResponse[0] & ~MBNET_ORIGIN_MASK) | MBNET_ORIGIN_DEVICE;
+    memcpy((char*)(taggedResponse + job->headerLen), response, responseLen - 2);
+
+    mqtt_publishMessage(job->topic, job->topicLen, (char*)taggedResponse, job->headerLen + responseLen - 2);
 }
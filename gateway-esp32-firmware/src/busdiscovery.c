@@ -0,0 +1,139 @@
+#include "busdiscovery.h"
+
+static const char* TAG = "DISCOVERY";
+
+// Result of probing a single address
+typedef enum {
+    DISCOVERY_SILENT = 0,           ///< Nothing received before the timeout
+    DISCOVERY_ALIVE,                ///< Valid response or exception from the probed address
+    DISCOVERY_BORDERLINE,           ///< Partial, corrupted or foreign response
+} discovery_outcome_t;
+
+/**
+ * @brief Send a probe to an address and classify the answer.
+ * @param id Address to probe.
+ * @param probe Request used as probe.
+ * @param timeout_ms Timeout for the first response byte.
+ * @param turnaround_us Set to the slave turnaround time when the address is alive.
+ * @param answeredBy Set to the address found in the response, if any.
+ * @return Outcome of the probe.
+ */
+static discovery_outcome_t discovery_probe(uint8_t id, discovery_probe_t probe, uint16_t timeout_ms, uint32_t* turnaround_us, uint8_t* answeredBy) {
+    uint8_t request[DISCOVERY_PROBE_LENGTH] = { id, 0x03, 0x00, 0x00, 0x00, 0x01 };
+    if (probe == DISCOVERY_PROBE_ECHO) {
+        request[1] = 0x08;
+        request[4] = 0xA5; // Arbitrary query data echoed back by the slave
+        request[5] = 0x37;
+    }
+
+    uint16_t crc = modbus_evaluateCRC(request, DISCOVERY_PROBE_LENGTH - 2);
+    request[DISCOVERY_PROBE_LENGTH - 2] = lowByte(crc);
+    request[DISCOVERY_PROBE_LENGTH - 1] = highByte(crc);
+
+    uint8_t response[16];
+    modbus_sendRequestPacket(request, DISCOVERY_PROBE_LENGTH);
+    uint16_t responseLen = modbus_readResponsePacket(response, sizeof(response), timeout_ms);
+
+    if (responseLen == 0)
+        return DISCOVERY_SILENT;
+
+    *answeredBy = response[0];
+
+    bool valid = responseLen >= 5 && !modbus_evaluateCRC(response, responseLen) && response[0] == id;
+    trace_record(SCHEDULER_CLASS_CONTROL, request, DISCOVERY_PROBE_LENGTH, response, responseLen, &modbus_lastTiming,
+                 valid ? ((response[1] & 0x80) ? TRACE_OUTCOME_EXCEPTION : TRACE_OUTCOME_OK) : TRACE_OUTCOME_CRC_ERROR);
+
+    if (!valid)
+        return DISCOVERY_BORDERLINE;
+
+    // Time spent on the line by the request is not part of the slave's turnaround
+    int64_t elapsed_us = modbus_lastTiming.firstByte_us - modbus_lastTiming.requestSent_us;
+    int64_t transmission_us = (int64_t)DISCOVERY_PROBE_LENGTH * characterTime_us;
+    *turnaround_us = elapsed_us > transmission_us ? (uint32_t)(elapsed_us - transmission_us) : 0;
+
+    return DISCOVERY_ALIVE;
+}
+
+/**
+ * @brief Probe a range of addresses and report the responding slaves. Runs on the bus worker task.
+ * @param first First address to probe.
+ * @param last Last address to probe.
+ * @param probe Request used as probe.
+ * @param results Buffer for at least MODBUS_MAX_SLAVE_ID results.
+ * @return Number of responding slaves.
+ */
+uint16_t discovery_scan(uint8_t first, uint8_t last, discovery_probe_t probe, discovery_result_t* results) {
+    static bool borderline[MODBUS_MAX_SLAVE_ID + 1];
+    static bool alive[MODBUS_MAX_SLAVE_ID + 1];     // Addresses already in the results
+    memset(borderline, 0, sizeof(borderline));
+    memset(alive, 0, sizeof(alive));
+
+    if (first < 1) first = 1;
+    if (last > MODBUS_MAX_SLAVE_ID) last = MODBUS_MAX_SLAVE_ID;
+
+    uint16_t timeout_ms = CONFIG_GATEWAY_DISCOVERY_TIMEOUT_MS;
+    uint32_t slowest_us = 0;
+    uint16_t found = 0;
+    uint16_t retried = 0;
+    int64_t start_us = esp_timer_get_time();
+
+    for (uint16_t id = first; id <= last; id++) {
+        uint32_t turnaround_us = 0;
+        uint8_t answeredBy = id;
+        discovery_outcome_t outcome = discovery_probe(id, probe, timeout_ms, &turnaround_us, &answeredBy);
+
+        // Bytes arriving after a silent probe are a late answer from that address
+        size_t lateBytes = 0;
+        uart_get_buffered_data_len(UART_ID, &lateBytes);
+
+        if (outcome == DISCOVERY_ALIVE) {
+            results[found++] = (discovery_result_t){ .id = id, .rtt_us = (uint32_t)(modbus_lastTiming.firstByte_us - modbus_lastTiming.requestSent_us) };
+            modbus_seedSlaveTimeout(id, turnaround_us);
+            alive[id] = true;
+
+            // The probe timeout follows the slowest slave seen, with the same margin as seeded timeouts
+            if (turnaround_us > slowest_us) {
+                slowest_us = turnaround_us;
+                uint32_t adapted_ms = (slowest_us * MODBUS_TIMEOUT_RTT_FACTOR + 999) / 1000;
+                timeout_ms = adapted_ms < DISCOVERY_MIN_TIMEOUT_MS ? DISCOVERY_MIN_TIMEOUT_MS
+                           : adapted_ms > CONFIG_GATEWAY_BUS_DEFAULT_TIMEOUT_MS ? CONFIG_GATEWAY_BUS_DEFAULT_TIMEOUT_MS
+                           : adapted_ms;
+            }
+        }
+        else if (outcome == DISCOVERY_BORDERLINE || lateBytes > 0) {
+            borderline[id] = true;
+
+            // A late answer from an earlier address can land in this probe's window, unless that
+            // address already answered in time and is listed
+            if (answeredBy >= first && answeredBy < id && !alive[answeredBy])
+                borderline[answeredBy] = true;
+        }
+    }
+
+    // Borderline addresses get the full timeout, a silent address is never retried
+    for (uint8_t attempt = 0; attempt < CONFIG_GATEWAY_DISCOVERY_RETRIES; attempt++) {
+        for (uint16_t id = first; id <= last; id++) {
+            if (!borderline[id] || alive[id])
+                continue;
+
+            uint32_t turnaround_us = 0;
+            uint8_t answeredBy = id;
+            discovery_outcome_t outcome = discovery_probe(id, probe, CONFIG_GATEWAY_BUS_DEFAULT_TIMEOUT_MS, &turnaround_us, &answeredBy);
+            retried++;
+
+            if (outcome == DISCOVERY_ALIVE) {
+                results[found++] = (discovery_result_t){ .id = id, .rtt_us = (uint32_t)(modbus_lastTiming.firstByte_us - modbus_lastTiming.requestSent_us) };
+                modbus_seedSlaveTimeout(id, turnaround_us);
+                alive[id] = true;
+                borderline[id] = false;
+            }
+            else if (outcome == DISCOVERY_SILENT) {
+                borderline[id] = false;
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "Scanned %u-%u in %" PRIu32 " ms, %u slaves found, %u probes retried",
+             first, last, (uint32_t)((esp_timer_get_time() - start_us) / 1000), found, retried);
+    return found;
+}
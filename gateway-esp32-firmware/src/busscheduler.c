@@ -0,0 +1,124 @@
+#include "busscheduler.h"
+
+static const char* TAG = "SCHEDULER";
+
+static QueueHandle_t scheduler_queues[SCHEDULER_CLASS_COUNT];     // One queue per priority class
+static SemaphoreHandle_t scheduler_pending;                         // Counts jobs across all classes
+static scheduler_handler_t scheduler_handler;                       // Executes a job on the bus
+scheduler_stats_t scheduler_stats;                                  // Per-class counters
+
+// Consecutive times a waiting class was passed over, and how many times it may be
+static uint8_t scheduler_skipped[SCHEDULER_CLASS_COUNT];
+static const uint8_t scheduler_guard[SCHEDULER_CLASS_COUNT] = {
+    0, // Control is never passed over
+    CONFIG_GATEWAY_SCHEDULER_INTERACTIVE_GUARD,
+    CONFIG_GATEWAY_SCHEDULER_BACKGROUND_GUARD,
+};
+static const uint8_t scheduler_depth[SCHEDULER_CLASS_COUNT] = {
+    CONFIG_GATEWAY_SCHEDULER_CONTROL_DEPTH,
+    CONFIG_GATEWAY_SCHEDULER_INTERACTIVE_DEPTH,
+    CONFIG_GATEWAY_SCHEDULER_BACKGROUND_DEPTH,
+};
+
+/**
+ * @brief Choose the class to be served next.
+ *
+ * The most urgent class with pending jobs wins, unless a less urgent class has already been
+ * passed over as many times as its guard allows, in which case that class is served instead.
+ * This bounds the wait of every class to a fixed number of transactions.
+ *
+ * @return Class to be served, or SCHEDULER_CLASS_COUNT if every queue is empty.
+ */
+static scheduler_class_t scheduler_pickClass() {
+    scheduler_class_t selected = SCHEDULER_CLASS_COUNT;
+
+    for (uint8_t c = 0; c < SCHEDULER_CLASS_COUNT; c++) {
+        if (uxQueueMessagesWaiting(scheduler_queues[c]) == 0)
+            continue;
+
+        if (selected == SCHEDULER_CLASS_COUNT)
+            selected = c; // Most urgent waiting class
+
+        if (scheduler_guard[c] && scheduler_skipped[c] >= scheduler_guard[c]) {
+            selected = c; // Starving class takes the turn
+            break;
+        }
+    }
+
+    // Every other waiting class is passed over once more
+    for (uint8_t c = 0; c < SCHEDULER_CLASS_COUNT; c++) {
+        if (c == selected)
+            scheduler_skipped[c] = 0;
+        else if (uxQueueMessagesWaiting(scheduler_queues[c]) > 0 && scheduler_skipped[c] < UINT8_MAX)
+            scheduler_skipped[c]++;
+    }
+
+    return selected;
+}
+
+/**
+ * @brief Worker task executing queued jobs one at a time.
+ * @param args Unused.
+ */
+static void scheduler_workerTask(void* args) {
+    static scheduler_job_t job; // Kept off the task stack
+
+    while (true) {
+        xSemaphoreTake(scheduler_pending, portMAX_DELAY);
+
+        scheduler_class_t priority = scheduler_pickClass();
+        if (priority == SCHEDULER_CLASS_COUNT)
+            continue;
+
+        if (xQueueReceive(scheduler_queues[priority], &job, 0) == pdTRUE) {
+            scheduler_stats.executed[priority]++;
+            scheduler_handler(&job);
+        }
+    }
+}
+
+/**
+ * @brief Create the class queues and start the bus worker task.
+ * @param handler Function called by the worker for every dequeued job.
+ */
+void scheduler_initialize(scheduler_handler_t handler) {
+    uint16_t totalDepth = 0;
+
+    for (uint8_t c = 0; c < SCHEDULER_CLASS_COUNT; c++) {
+        scheduler_queues[c] = xQueueCreate(scheduler_depth[c], sizeof(scheduler_job_t));
+        totalDepth += scheduler_depth[c];
+    }
+
+    scheduler_pending = xSemaphoreCreateCounting(totalDepth, 0);
+    scheduler_handler = handler;
+
+    xTaskCreate(scheduler_workerTask, "busScheduler", SCHEDULER_STACK_SIZE, NULL, SCHEDULER_TASK_PRIORITY, NULL);
+    ESP_LOGI(TAG, "Bus scheduler started");
+}
+
+/**
+ * @brief Queue a job for execution according to its priority class.
+ * @param job Job to be copied into the class queue.
+ * @return True if the job was queued, false if its class queue is full.
+ */
+bool scheduler_submit(const scheduler_job_t* job) {
+    scheduler_class_t priority = job->priority < SCHEDULER_CLASS_COUNT ? job->priority : SCHEDULER_CLASS_BACKGROUND;
+
+    if (xQueueSend(scheduler_queues[priority], job, 0) != pdTRUE) {
+        scheduler_stats.dropped[priority]++;
+        ESP_LOGW(TAG, "Class %d queue full, dropping job", priority);
+        return false;
+    }
+
+    xSemaphoreGive(scheduler_pending);
+    return true;
+}
+
+/**
+ * @brief Number of jobs waiting in a priority class.
+ * @param priority Priority class to inspect.
+ * @return Number of queued jobs.
+ */
+uint16_t scheduler_pendingJobs(scheduler_class_t priority) {
+    return (uint16_t)uxQueueMessagesWaiting(scheduler_queues[priority]);
+}
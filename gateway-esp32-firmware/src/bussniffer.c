@@ -0,0 +1,313 @@
+#include "bussniffer.h"
+
+#if CONFIG_GATEWAY_BUS_LISTEN_ONLY
+
+static const char* TAG = "SNIFFER";
+
+#define SNIFFER_FRAME_SIZE 264          // Largest RTU frame plus some slack for noise
+
+// Data types as named in the terse request format
+typedef enum {
+    SNIFFER_BOOLEAN_OUTPUT = 0,
+    SNIFFER_BOOLEAN_INPUT,
+    SNIFFER_NUMERIC_OUTPUT,
+    SNIFFER_NUMERIC_INPUT,
+} sniffer_datatype_t;
+
+static const char* sniffer_datatypeNames[] = { "bo", "bi", "no", "ni" };
+
+// Last published value of a register or coil
+typedef struct {
+    uint32_t key;       ///< Slave ID, data type and address
+    uint16_t value;     ///< Last published value
+    bool used;          ///< Slot holds an entry
+} sniffer_entry_t;
+
+static sniffer_entry_t sniffer_table[CONFIG_GATEWAY_SNIFFER_TABLE_SIZE];
+
+// Request waiting for its response
+static uint8_t sniffer_request[SNIFFER_FRAME_SIZE];
+static uint16_t sniffer_requestLen = 0;
+static int64_t sniffer_requestEnd_us = 0;
+static bool sniffer_requestPending = false;
+
+// Changed values waiting to be published
+static uint16_t sniffer_addresses[SNIFFER_VALUES_PER_MESSAGE];
+static uint16_t sniffer_values[SNIFFER_VALUES_PER_MESSAGE];
+static uint16_t sniffer_batchLen = 0;
+
+static char sniffer_topic[sizeof(CONFIG_MQTT_DEVICE_NAME) + 16];
+static uint32_t sniffer_silentInterval_us;
+
+/**
+ * @brief Store a harvested value, telling whether it differs enough from the last published one.
+ * @return True if the value must be published.
+ */
+static bool sniffer_updateValue(uint8_t id, sniffer_datatype_t datatype, uint16_t address, uint16_t value) {
+    uint32_t key = ((uint32_t)id << 18) | ((uint32_t)datatype << 16) | address;
+    uint32_t slot = (key * 2654435761u) % CONFIG_GATEWAY_SNIFFER_TABLE_SIZE;
+
+    for (uint32_t probe = 0; probe < CONFIG_GATEWAY_SNIFFER_TABLE_SIZE; probe++) {
+        sniffer_entry_t* entry = &sniffer_table[slot];
+
+        if (!entry->used) {
+            *entry = (sniffer_entry_t){ .key = key, .value = value, .used = true };
+            return true;
+        }
+
+        if (entry->key == key) {
+            uint16_t change = value > entry->value ? value - entry->value : entry->value - value;
+            bool numeric = datatype == SNIFFER_NUMERIC_OUTPUT || datatype == SNIFFER_NUMERIC_INPUT;
+
+            if (change == 0 || (numeric && change <= CONFIG_GATEWAY_SNIFFER_DEADBAND))
+                return false;
+
+            entry->value = value;
+            return true;
+        }
+
+        slot = (slot + 1) % CONFIG_GATEWAY_SNIFFER_TABLE_SIZE;
+    }
+
+    return true; // Table full, publish every value of untracked addresses
+}
+
+/**
+ * @brief Publish the batch of changed values as terse JSON and empty it.
+ */
+static void sniffer_flush(uint8_t id, sniffer_datatype_t datatype) {
+    static char message[64 + SNIFFER_VALUES_PER_MESSAGE * 14];
+
+    if (sniffer_batchLen == 0)
+        return;
+
+    int length = snprintf(message, sizeof(message), "{\"id\":%u,\"dt\":\"%s\",\"ls\":[", id, sniffer_datatypeNames[datatype]);
+    for (uint16_t i = 0; i < sniffer_batchLen; i++)
+        length += snprintf(message + length, sizeof(message) - length, i ? ",%u" : "%u", sniffer_addresses[i]);
+
+    length += snprintf(message + length, sizeof(message) - length, "],\"fd\":[");
+    for (uint16_t i = 0; i < sniffer_batchLen; i++)
+        length += snprintf(message + length, sizeof(message) - length, i ? ",%u" : "%u", sniffer_values[i]);
+
+    length += snprintf(message + length, sizeof(message) - length, "]}");
+
+    mqtt_publishMessage(sniffer_topic, strlen(sniffer_topic), message, length);
+    sniffer_batchLen = 0;
+}
+
+/**
+ * @brief Feed a block of consecutive values through the deadband and publish the changes.
+ * @param data Packed coil bits, or big-endian registers.
+ */
+static void sniffer_harvest(uint8_t id, sniffer_datatype_t datatype, uint16_t start, uint16_t count, const uint8_t* data) {
+    bool packedBits = datatype == SNIFFER_BOOLEAN_OUTPUT || datatype == SNIFFER_BOOLEAN_INPUT;
+
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t value = packedBits
+            ? (data[i / 8] >> (i % 8)) & 0x01
+            : (uint16_t)((data[2 * i] << 8) | data[2 * i + 1]);
+
+        if (!sniffer_updateValue(id, datatype, start + i, value))
+            continue;
+
+        sniffer_addresses[sniffer_batchLen] = start + i;
+        sniffer_values[sniffer_batchLen] = value;
+        if (++sniffer_batchLen == SNIFFER_VALUES_PER_MESSAGE)
+            sniffer_flush(id, datatype);
+    }
+
+    sniffer_flush(id, datatype);
+}
+
+/**
+ * @brief Expected length of a request frame, judged from its function code.
+ * @return Frame length, or 0 if the function is not decoded.
+ */
+static uint16_t sniffer_requestLength(const uint8_t* frame, uint16_t length) {
+    switch (frame[1]) {
+        case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06:
+            return 8;
+        case 0x0F: case 0x10:
+            return length > 6 ? 9 + frame[6] : 0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Check whether a frame answers the pending request.
+ */
+static bool sniffer_isResponse(const uint8_t* frame, uint16_t length) {
+    const uint8_t* request = sniffer_request;
+    uint16_t quantity = (request[4] << 8) | request[5];
+
+    if (frame[0] != request[0])
+        return false;
+
+    if (frame[1] == (request[1] | 0x80))
+        return length == 5; // Exception response
+
+    if (frame[1] != request[1])
+        return false;
+
+    switch (request[1]) {
+        case 0x01: case 0x02:
+            return frame[2] == (quantity + 7) / 8 && length == 5 + frame[2];
+        case 0x03: case 0x04:
+            return frame[2] == 2 * quantity && length == 5 + frame[2];
+        case 0x05: case 0x06:
+            return length == 8 && !memcmp(frame, request, 6);
+        case 0x0F: case 0x10:
+            return length == 8 && !memcmp(frame + 2, request + 2, 4);
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Harvest the values carried by a request and its response.
+ */
+static void sniffer_handleTransaction(const uint8_t* response) {
+    const uint8_t* request = sniffer_request;
+    uint8_t id = request[0];
+    uint16_t address = (request[2] << 8) | request[3];
+    uint16_t quantity = (request[4] << 8) | request[5];
+
+    switch (request[1]) {
+        case 0x01: sniffer_harvest(id, SNIFFER_BOOLEAN_OUTPUT, address, quantity, response + 3); break;
+        case 0x02: sniffer_harvest(id, SNIFFER_BOOLEAN_INPUT,  address, quantity, response + 3); break;
+        case 0x03: sniffer_harvest(id, SNIFFER_NUMERIC_OUTPUT, address, quantity, response + 3); break;
+        case 0x04: sniffer_harvest(id, SNIFFER_NUMERIC_INPUT,  address, quantity, response + 3); break;
+        case 0x05: {
+            uint8_t coil = request[4] == 0xFF;
+            sniffer_harvest(id, SNIFFER_BOOLEAN_OUTPUT, address, 1, &coil);
+            break;
+        }
+        case 0x06: sniffer_harvest(id, SNIFFER_NUMERIC_OUTPUT, address, 1, request + 4); break;
+        case 0x0F: sniffer_harvest(id, SNIFFER_BOOLEAN_OUTPUT, address, quantity, request + 7); break;
+        case 0x10: sniffer_harvest(id, SNIFFER_NUMERIC_OUTPUT, address, quantity, request + 7); break;
+    }
+}
+
+/**
+ * @brief Record the pending request in the transaction trace, with its response if any.
+ */
+static void sniffer_trace(const uint8_t* response, uint16_t responseLen, int64_t responseEnd_us, trace_outcome_t outcome) {
+    modbus_timing_t timing = {
+        .requestSent_us = sniffer_requestEnd_us - (int64_t)sniffer_requestLen * characterTime_us,
+        .firstByte_us = responseLen ? responseEnd_us - (int64_t)responseLen * characterTime_us : 0,
+        .lastByte_us = responseLen ? responseEnd_us : 0,
+    };
+    trace_record(TRACE_PRIORITY_SNIFFED, sniffer_request, sniffer_requestLen, response, responseLen, &timing, outcome);
+}
+
+/**
+ * @brief Pair a complete frame with the pending request, or keep it as the new pending request.
+ * @param frame Frame delimited by a silent interval, including CRC.
+ * @param length Length of the frame.
+ * @param end_us Time the last byte of the frame was received.
+ */
+static void sniffer_processFrame(const uint8_t* frame, uint16_t length, int64_t end_us) {
+    // Noise, collisions and truncated frames are dropped along with any pending request
+    if (length < 5 || modbus_evaluateCRC((uint8_t*)frame, length)) {
+        sniffer_requestPending = false;
+        return;
+    }
+
+    if (sniffer_requestPending && sniffer_isResponse(frame, length)) {
+        bool exception = frame[1] & 0x80;
+        if (!exception)
+            sniffer_handleTransaction(frame);
+
+        sniffer_trace(frame, length, end_us, exception ? TRACE_OUTCOME_EXCEPTION : TRACE_OUTCOME_OK);
+        sniffer_requestPending = false;
+        return;
+    }
+
+    // A pending unicast request overtaken by a new frame was never answered
+    if (sniffer_requestPending && sniffer_request[0] != 0x00)
+        sniffer_trace(NULL, 0, 0, TRACE_OUTCOME_TIMEOUT);
+
+    sniffer_requestPending = sniffer_requestLength(frame, length) == length;
+    if (sniffer_requestPending) {
+        memcpy(sniffer_request, frame, length);
+        sniffer_requestLen = length;
+        sniffer_requestEnd_us = end_us;
+    }
+}
+
+/**
+ * @brief Task assembling frames from the UART driver events.
+ * @param args Unused.
+ */
+static void sniffer_task(void* args) {
+    static uint8_t frame[SNIFFER_FRAME_SIZE];
+    uint16_t length = 0;
+    bool overflow = false;
+    uart_event_t event;
+
+    while (true) {
+        if (xQueueReceive(uart_eventQueue, &event, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        switch (event.type) {
+            case UART_DATA: {
+                size_t room = sizeof(frame) - length;
+                size_t chunk = event.size < room ? event.size : room;
+                length += uart_read_bytes(UART_ID, frame + length, chunk, 0);
+
+                // Bytes beyond the largest frame are drained and the frame discarded
+                for (size_t left = event.size - chunk; left > 0; ) {
+                    uint8_t discard[32];
+                    int read = uart_read_bytes(UART_ID, discard, left < sizeof(discard) ? left : sizeof(discard), 0);
+                    if (read <= 0)
+                        break;
+                    left -= read;
+                    overflow = true;
+                }
+
+                // The driver flags the event raised by the idle-line timeout, i.e. the end of a frame
+                if (event.timeout_flag) {
+                    if (!overflow)
+                        sniffer_processFrame(frame, length, esp_timer_get_time() - sniffer_silentInterval_us);
+                    length = 0;
+                    overflow = false;
+                }
+                break;
+            }
+
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                ESP_LOGW(TAG, "RX overflow, resynchronizing");
+                uart_flush_input(UART_ID);
+                xQueueReset(uart_eventQueue);
+                length = 0;
+                overflow = false;
+                sniffer_requestPending = false;
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Configure the idle-line detection and start the sniffer task.
+ */
+void sniffer_initialize() {
+    snprintf(sniffer_topic, sizeof(sniffer_topic), SNIFFER_TOPIC_FORMAT, CONFIG_MQTT_DEVICE_NAME);
+
+    // t3.5 is 3.5 character times, but never less than 1750us above 19200 baud
+    sniffer_silentInterval_us = characterTime_us * 7 / 2;
+    if (sniffer_silentInterval_us < SNIFFER_SILENT_INTERVAL_US)
+        sniffer_silentInterval_us = SNIFFER_SILENT_INTERVAL_US;
+
+    uint32_t symbols = (sniffer_silentInterval_us + characterTime_us - 1) / characterTime_us;
+    uart_set_rx_timeout(UART_ID, symbols > SNIFFER_RX_TIMEOUT_MAX ? SNIFFER_RX_TIMEOUT_MAX : symbols);
+
+    xTaskCreate(sniffer_task, "busSniffer", SNIFFER_STACK_SIZE, NULL, SNIFFER_TASK_PRIORITY, NULL);
+    ESP_LOGI(TAG, "Listening on the bus, silent interval %" PRIu32 "us", sniffer_silentInterval_us);
+}
+
+#endif // CONFIG_GATEWAY_BUS_LISTEN_ONLY
@@ -0,0 +1,76 @@
+#include "bustrace.h"
+
+static trace_record_t trace_ring[TRACE_DEPTH];  // Recorded transactions
+static uint32_t trace_sequence = 0;             // Number of transactions recorded since boot
+static uint32_t trace_firstSequence = 0;        // Sequence of the oldest record kept after a clear
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;  // Guards the ring and sequences
+
+/**
+ * @brief Record a transaction in the ring, overwriting the oldest entry when full.
+ * @param priority Scheduler class of the transaction.
+ * @param tx Request sent on the bus, including CRC.
+ * @param txLen Length of the request.
+ * @param rx Response read from the bus, including CRC.
+ * @param rxLen Length of the response, 0 if none.
+ * @param timing Timestamps of the transaction.
+ * @param outcome Outcome of the transaction.
+ */
+void trace_record(uint8_t priority, const uint8_t* tx, uint16_t txLen, const uint8_t* rx, uint16_t rxLen,
+                  const modbus_timing_t* timing, trace_outcome_t outcome) {
+    taskENTER_CRITICAL(&trace_lock);
+    trace_record_t* record = &trace_ring[trace_sequence % TRACE_DEPTH];
+
+    record->sequence = trace_sequence++;
+    record->requestSent_us = timing->requestSent_us;
+    record->firstByte_us = timing->firstByte_us;
+    record->lastByte_us = timing->lastByte_us;
+    record->outcome = outcome;
+    record->priority = priority;
+    record->txLen = txLen;
+    record->rxLen = rxLen;
+
+    // Only the head of long frames is kept, the lengths still tell the full size
+    memcpy(record->tx, tx, txLen < TRACE_FRAME_BYTES ? txLen : TRACE_FRAME_BYTES);
+    memcpy(record->rx, rx, rxLen < TRACE_FRAME_BYTES ? rxLen : TRACE_FRAME_BYTES);
+    taskEXIT_CRITICAL(&trace_lock);
+}
+
+/**
+ * @brief Copy the ring, oldest record first, into a dump buffer.
+ * @param buffer Destination buffer, at least TRACE_DUMP_SIZE bytes long.
+ * @return Number of bytes written.
+ */
+uint32_t trace_dump(uint8_t* buffer) {
+    // The range and the records are copied together, so recorders cannot overwrite them meanwhile
+    taskENTER_CRITICAL(&trace_lock);
+    uint32_t last = trace_sequence;
+    uint32_t kept = last - trace_firstSequence;
+    uint16_t count = kept < TRACE_DEPTH ? kept : TRACE_DEPTH;
+
+    trace_header_t header = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .frameBytes = TRACE_FRAME_BYTES,
+        .count = count,
+        .recordSize = sizeof(trace_record_t),
+    };
+    memcpy(buffer, &header, sizeof(header));
+
+    uint8_t* cursor = buffer + sizeof(header);
+    for (uint32_t sequence = last - count; sequence != last; sequence++) {
+        memcpy(cursor, &trace_ring[sequence % TRACE_DEPTH], sizeof(trace_record_t));
+        cursor += sizeof(trace_record_t);
+    }
+    taskEXIT_CRITICAL(&trace_lock);
+
+    return cursor - buffer;
+}
+
+/**
+ * @brief Discard every recorded transaction.
+ */
+void trace_clear() {
+    taskENTER_CRITICAL(&trace_lock);
+    trace_firstSequence = trace_sequence;
+    taskEXIT_CRITICAL(&trace_lock);
+}
@@ -0,0 +1,78 @@
+#include "gatewaycapability.h"
+
+static const char* TAG = "CAPABILITY";
+
+// Functions the broker may relay through this device
+static const uint8_t capability_functions[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x0F, 0x10 };
+
+#if CONFIG_GATEWAY_BUS_LISTEN_ONLY
+static const char* capability_listenOnly = "true";
+#else
+static const char* capability_listenOnly = "false";
+#endif
+
+#if CONFIG_GATEWAY_EDGE_CODEC
+static const int capability_codecPoints = CONFIG_GATEWAY_EDGE_MAX_POINTS;
+#else
+static const int capability_codecPoints = 0;
+#endif
+
+#if CONFIG_GATEWAY_UDP_TRANSPORT
+static const int capability_udpPort = CONFIG_GATEWAY_UDP_PORT;
+#else
+static const int capability_udpPort = 0;
+#endif
+
+/**
+ * @brief Build the capability record and publish it, retained.
+ */
+void capability_publish() {
+    const uint32_t size = CAPABILITY_BASE_SIZE + CAPABILITY_SLAVE_SIZE * MODBUS_MAX_SLAVE_ID;
+    char* record = malloc(size);
+    if (!record) {
+        ESP_LOGE(TAG, "Not enough memory to build the capability record");
+        return;
+    }
+
+    const esp_app_desc_t* app = esp_app_get_description();
+    const char* parity = uart_configure.parity == UART_PARITY_EVEN ? "even"
+                       : uart_configure.parity == UART_PARITY_ODD ? "odd" : "none";
+
+    int length = snprintf(record, size,
+        "{\"firmware\":{\"version\":\"%s\",\"idf\":\"%s\",\"built\":\"%s %s\"},"
+        "\"buses\":[{\"id\":0,\"baud\":%d,\"parity\":\"%s\",\"stopBits\":%d,\"listenOnly\":%s}],"
+        "\"maxFrame\":%d,\"maxBundle\":%d,\"functions\":[",
+        app->version, app->idf_ver, app->date, app->time,
+        uart_configure.baud_rate, parity, uart_configure.stop_bits == UART_STOP_BITS_2 ? 2 : 1,
+        capability_listenOnly,
+        SCHEDULER_FRAME_SIZE, SCHEDULER_FRAME_SIZE - 2);
+
+    for (uint8_t i = 0; i < sizeof(capability_functions); i++)
+        length += snprintf(record + length, size - length, i ? ",%u" : "%u", capability_functions[i]);
+
+    length += snprintf(record + length, size - length, "],\"queueDepth\":[%d,%d,%d],\"timeout\":%d,\"udp\":%d,\"mbnet\":%d,"
+                       "\"codec\":{\"maxPoints\":%d,\"maxRequest\":%d,\"maxTopic\":%d},\"slaves\":[",
+                       CONFIG_GATEWAY_SCHEDULER_CONTROL_DEPTH, CONFIG_GATEWAY_SCHEDULER_INTERACTIVE_DEPTH,
+                       CONFIG_GATEWAY_SCHEDULER_BACKGROUND_DEPTH, CONFIG_GATEWAY_BUS_DEFAULT_TIMEOUT_MS,
+                       capability_udpPort, MBNET_VERSION_CURRENT, capability_codecPoints, capability_codecPoints ? CODEC_MAX_REQUEST : 0,
+                       capability_codecPoints ? CODEC_MAX_TOPIC : 0);
+
+    bool first = true;
+    for (uint16_t id = 1; id <= MODBUS_MAX_SLAVE_ID; id++) {
+        uint32_t turnaround_us = modbus_getSlaveTurnaround(id);
+        if (turnaround_us == 0)
+            continue;
+
+        length += snprintf(record + length, size - length, "%s{\"id\":%u,\"turnaround\":%" PRIu32 ",\"timeout\":%u}",
+                           first ? "" : ",", id, turnaround_us, modbus_getSlaveTimeout(id));
+        first = false;
+    }
+
+    length += snprintf(record + length, size - length, "]}");
+
+    char topic[sizeof(CONFIG_MQTT_DEVICE_NAME) + sizeof(CAPABILITY_TOPIC_FORMAT)];
+    snprintf(topic, sizeof(topic), CAPABILITY_TOPIC_FORMAT, CONFIG_MQTT_DEVICE_NAME);
+
+    mqtt_publishRetained(topic, record, length);
+    free(record);
+}
@@ -0,0 +1,389 @@
+#include "gatewaycodec.h"
+
+#if CONFIG_GATEWAY_EDGE_CODEC
+
+static const char* TAG = "CODEC";
+
+// An address of the request, with its position in the request's address list
+typedef struct {
+    uint16_t address;
+    uint16_t index;
+} codec_point_t;
+
+// A validated request
+typedef struct {
+    uint8_t id;                 // Slave address
+    uint8_t function;           // Modbus function code
+    bool write;                 // True for writes
+    uint16_t limit;             // Points a single transaction may carry
+    codec_point_t* points;      // Addresses, sorted
+    uint16_t count;             // Number of addresses
+    int* values;                // Written or fetched values, in request order
+} codec_request_t;
+
+/**
+ * @brief Check whether a topic is an edge topic, carrying a request handed over by the broker.
+ * @param topic Topic of the incoming message, not null-terminated.
+ * @param topicLen Length of the topic.
+ * @return True if the topic ends with the edge operator.
+ */
+bool codec_isEdgeTopic(const char* topic, uint16_t topicLen) {
+    const uint16_t suffixLen = sizeof(CODEC_TOPIC_SUFFIX) - 1;
+    return topicLen > suffixLen && !memcmp(topic + topicLen - suffixLen, CODEC_TOPIC_SUFFIX, suffixLen);
+}
+
+/**
+ * @brief Find the value of a top-level key in a JSON object without parsing it.
+ * @param json JSON object, not null-terminated.
+ * @param length Length of the object.
+ * @param key Quoted key to look for.
+ * @return First character of the value, or NULL if the key is absent.
+ */
+static const char* codec_findValue(const char* json, uint16_t length, const char* key) {
+    const uint16_t keyLen = strlen(key);
+    const char* end = json + length;
+
+    for (const char* cursor = json; cursor + keyLen <= end; cursor++) {
+        if (memcmp(cursor, key, keyLen))
+            continue;
+
+        cursor += keyLen;
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n' || *cursor == ':'))
+            cursor++;
+        return cursor < end ? cursor : NULL;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Tell the scheduler class of a request without parsing it: writes are control traffic.
+ *        The broker already chose the request, the codec validates it when it runs.
+ * @param request Request payload, not null-terminated.
+ * @param requestLen Length of the request.
+ * @return Scheduler class of the request.
+ */
+scheduler_class_t codec_requestPriority(const char* request, uint16_t requestLen) {
+    const char* function = codec_findValue(request, requestLen, "\"fn\"");
+    bool write = function && function + 3 <= request + requestLen && !memcmp(function, "\"w\"", 3);
+    return write ? SCHEDULER_CLASS_CONTROL : SCHEDULER_CLASS_INTERACTIVE;
+}
+
+/**
+ * @brief Read an integer property within bounds.
+ * @return True if the item is an integer between minimum and maximum.
+ */
+static bool codec_getInteger(const cJSON* item, int minimum, int maximum, int* value) {
+    if (!cJSON_IsNumber(item) || item->valuedouble != (double)item->valueint)
+        return false;
+    if (item->valueint < minimum || item->valueint > maximum)
+        return false;
+    *value = item->valueint;
+    return true;
+}
+
+/**
+ * @brief Order points by address.
+ */
+static int codec_comparePoints(const void* a, const void* b) {
+    return (int)((const codec_point_t*)a)->address - (int)((const codec_point_t*)b)->address;
+}
+
+/**
+ * @brief Validate a terse request and collect its addresses and values.
+ * @param json Parsed request.
+ * @param request Filled with the validated request, its buffers must be freed by the caller.
+ * @return NULL if the request is valid, the message to answer with otherwise.
+ */
+static const char* codec_parseRequest(const cJSON* json, codec_request_t* request) {
+    const cJSON* function = cJSON_GetObjectItemCaseSensitive(json, "fn");
+    const cJSON* datatype = cJSON_GetObjectItemCaseSensitive(json, "dt");
+    const cJSON* range = cJSON_GetObjectItemCaseSensitive(json, "rg");
+    const cJSON* list = cJSON_GetObjectItemCaseSensitive(json, "ls");
+    const cJSON* values = cJSON_GetObjectItemCaseSensitive(json, "dv");
+    int integer;
+
+    if (!codec_getInteger(cJSON_GetObjectItemCaseSensitive(json, "id"), 1, MODBUS_MAX_SLAVE_ID, &integer))
+        return "id must be an integer between 1 and 247";
+    request->id = integer;
+    request->write = !strcmp(function->valuestring, "w");
+
+    if (!cJSON_IsString(datatype))
+        return "\"dt\" property must be present";
+
+    const char* dt = datatype->valuestring;
+    if (request->write) {
+        if (!strcmp(dt, "bo"))
+            request->function = 0x0F, request->limit = CODEC_WRITE_BITS_LIMIT;
+        else if (!strcmp(dt, "no"))
+            request->function = 0x10, request->limit = CODEC_WRITE_REGISTERS_LIMIT;
+        else
+            return "\"dt\" must be either \"bo\" or \"no\"";
+    }
+    else {
+        if (!strcmp(dt, "bo"))
+            request->function = 0x01, request->limit = CODEC_READ_BITS_LIMIT;
+        else if (!strcmp(dt, "bi"))
+            request->function = 0x02, request->limit = CODEC_READ_BITS_LIMIT;
+        else if (!strcmp(dt, "no"))
+            request->function = 0x03, request->limit = CODEC_READ_REGISTERS_LIMIT;
+        else if (!strcmp(dt, "ni"))
+            request->function = 0x04, request->limit = CODEC_READ_REGISTERS_LIMIT;
+        else
+            return "dt must be equal to one of the allowed values";
+    }
+
+    if ((range != NULL) == (list != NULL))
+        return "Either \"ls\" or \"rg\" must be present, but not both or neither";
+
+    int start = 0, end = 0;
+    if (range) {
+        if (!cJSON_IsArray(range) || cJSON_GetArraySize(range) != 2
+            || !codec_getInteger(cJSON_GetArrayItem(range, 0), 0, 0xFFFF, &start)
+            || !codec_getInteger(cJSON_GetArrayItem(range, 1), start, 0xFFFF, &end))
+            return "rg must hold two ascending addresses";
+        request->count = end - start + 1 > CONFIG_GATEWAY_EDGE_MAX_POINTS ? 0 : end - start + 1;
+    }
+    else {
+        if (!cJSON_IsArray(list) || cJSON_GetArraySize(list) < 1)
+            return "ls must hold at least one address";
+        request->count = cJSON_GetArraySize(list) > CONFIG_GATEWAY_EDGE_MAX_POINTS ? 0 : cJSON_GetArraySize(list);
+    }
+
+    if (request->count == 0)
+        return "Too many addresses";
+
+    if (request->write) {
+        if (!values)
+            return "\"dv\" property must be present";
+        if (!cJSON_IsArray(values) || cJSON_GetArraySize(values) != request->count)
+            return range ? "Size of \"dv\" does not match \"rg\"" : "Size of \"dv\" does not match \"ls\"";
+    }
+    else if (values) {
+        return "\"dv\" property should not be present";
+    }
+
+    request->points = malloc(request->count * sizeof(codec_point_t));
+    request->values = calloc(request->count, sizeof(int));
+    if (!request->points || !request->values)
+        return "Not enough memory";
+
+    for (uint16_t i = 0; i < request->count; i++) {
+        request->points[i].index = i;
+        if (range)
+            request->points[i].address = start + i;
+        else if (codec_getInteger(cJSON_GetArrayItem(list, i), 0, 0xFFFF, &integer))
+            request->points[i].address = integer;
+        else
+            return "ls items must be addresses";
+
+        if (request->write && !codec_getInteger(cJSON_GetArrayItem(values, i), INT16_MIN, 0xFFFF, &request->values[i]))
+            return "dv items must be 16-bit integers";
+    }
+
+    if (list) {
+        qsort(request->points, request->count, sizeof(codec_point_t), codec_comparePoints);
+        for (uint16_t i = 1; i < request->count; i++)
+            if (request->points[i].address == request->points[i - 1].address)
+                return "ls must NOT have duplicate items";
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Exchange one transaction covering consecutive points of a request.
+ * @param request Validated request.
+ * @param priority Scheduler class of the request, recorded in the trace.
+ * @param first First point of the transaction.
+ * @param length Number of consecutive points carried.
+ * @return True if the slave answered as expected, fetched values are stored in the request.
+ */
+static bool codec_exchange(codec_request_t* request, uint8_t priority, uint16_t first, uint16_t length) {
+    uint8_t frame[265];
+    uint16_t frameLen = 6;
+    const codec_point_t* points = request->points + first;
+    const bool registers = request->function == 0x03 || request->function == 0x04 || request->function == 0x10;
+
+    frame[0] = request->id;
+    frame[1] = request->function;
+    frame[2] = highByte(points[0].address);
+    frame[3] = lowByte(points[0].address);
+    frame[4] = highByte(length);
+    frame[5] = lowByte(length);
+
+    if (request->write) {
+        uint8_t byteCount = registers ? 2 * length : (length + 7) / 8;
+        frame[frameLen++] = byteCount;
+        memset(frame + frameLen, 0, byteCount);
+
+        for (uint16_t i = 0; i < length; i++) {
+            int value = request->values[points[i].index];
+            if (registers) {
+                frame[frameLen + 2 * i] = highByte(value);
+                frame[frameLen + 2 * i + 1] = lowByte(value);
+            }
+            else if (value) {
+                frame[frameLen + i / 8] |= 1 << (i % 8);
+            }
+        }
+        frameLen += byteCount;
+    }
+
+    uint16_t crc = modbus_evaluateCRC(frame, frameLen);
+    frame[frameLen++] = lowByte(crc);
+    frame[frameLen++] = highByte(crc);
+
+    uint8_t response[265];
+    modbus_sendRequestPacket(frame, frameLen);
+    uint16_t responseLen = modbus_readResponsePacket(response, sizeof(response), modbus_getSlaveTimeout(request->id));
+
+    trace_outcome_t outcome = TRACE_OUTCOME_TIMEOUT;
+    if (responseLen > 0)
+        outcome = modbus_evaluateCRC(response, responseLen) ? TRACE_OUTCOME_CRC_ERROR
+                : (response[1] & 0x80) ? TRACE_OUTCOME_EXCEPTION : TRACE_OUTCOME_OK;
+    trace_record(priority, frame, frameLen, response, responseLen, &modbus_lastTiming, outcome);
+
+    if (outcome != TRACE_OUTCOME_OK || response[0] != request->id || response[1] != request->function)
+        return false;
+
+    // Writes echo the starting address and quantity
+    if (request->write)
+        return responseLen == 8 && !memcmp(response + 2, frame + 2, 4);
+
+    uint8_t byteCount = registers ? 2 * length : (length + 7) / 8;
+    if (response[2] != byteCount || responseLen != 5 + byteCount)
+        return false;
+
+    for (uint16_t i = 0; i < length; i++)
+        request->values[points[i].index] = registers
+            ? (response[3 + 2 * i] << 8) | response[4 + 2 * i]
+            : (response[3 + i / 8] >> (i % 8)) & 1;
+
+    return true;
+}
+
+/**
+ * @brief Execute a request in the fewest transactions the protocol limits allow.
+ * @param request Validated request.
+ * @param priority Scheduler class of the request.
+ * @return NULL on success, the message to answer with otherwise.
+ */
+static const char* codec_execute(codec_request_t* request, uint8_t priority) {
+#if CONFIG_GATEWAY_BUS_LISTEN_ONLY
+    return "Device is listen-only";
+#endif
+
+    uint16_t first = 0;
+    while (first < request->count) {
+        uint16_t length = 1;
+        while (first + length < request->count && length < request->limit
+               && request->points[first + length].address == request->points[first].address + length)
+            length++;
+
+        if (!codec_exchange(request, priority, first, length))
+            return "Error Retrieving Data";
+        first += length;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Publish a response on the response operator of an edge topic.
+ * @param requestTopic Edge topic, not null-terminated.
+ * @param topicLen Length of the topic.
+ * @param response JSON response.
+ * @param responseLen Length of the response.
+ */
+static void codec_publishResponse(const char* requestTopic, uint16_t topicLen, char* response, uint16_t responseLen) {
+    char topic[topicLen + sizeof(CODEC_RESPONSE_OPERATOR)];
+    uint16_t prefixLen = topicLen - (sizeof(CODEC_TOPIC_SUFFIX) - 2);
+
+    memcpy(topic, requestTopic, prefixLen);
+    memcpy(topic + prefixLen, CODEC_RESPONSE_OPERATOR, sizeof(CODEC_RESPONSE_OPERATOR) - 1);
+    mqtt_publishMessage(topic, prefixLen + sizeof(CODEC_RESPONSE_OPERATOR) - 1, response, responseLen);
+}
+
+/**
+ * @brief Execute a terse request on the bus and publish its response. Runs on the bus worker task.
+ * @param job Job holding the request topic and the JSON request.
+ */
+void codec_handleRequest(scheduler_job_t* job) {
+    cJSON* json = cJSON_ParseWithLength((const char*)job->frame, job->frameLen);
+    const cJSON* function = cJSON_GetObjectItemCaseSensitive(json, "fn");
+
+    // The broker hands over terse reads and writes only, anything else is still answered
+    if (!cJSON_IsObject(json) || !cJSON_IsString(function) || (strcmp(function->valuestring, "r") && strcmp(function->valuestring, "w"))) {
+        cJSON_Delete(json);
+        codec_refuseRequest(job->topic, job->topicLen, (const char*)job->frame, job->frameLen, "Request Not Encoded");
+        return;
+    }
+
+    codec_request_t request = { 0 };
+    const char* error = codec_parseRequest(json, &request);
+    if (!error)
+        error = codec_execute(&request, job->priority);
+
+    if (!error && !request.write)
+        cJSON_AddItemToObject(json, "fd", cJSON_CreateIntArray(request.values, request.count));
+    cJSON_AddBoolToObject(json, "st", error == NULL);
+    if (error)
+        cJSON_AddStringToObject(json, "mg", error);
+
+    free(request.points);
+    free(request.values);
+
+    char* response = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    if (!response) {
+        ESP_LOGE(TAG, "Not enough memory to build the response");
+        return;
+    }
+
+    codec_publishResponse(job->topic, job->topicLen, response, strlen(response));
+    cJSON_free(response);
+}
+
+/**
+ * @brief Answer a request that is not executed, echoing it with a failed status.
+ * @param topic Edge topic, not null-terminated.
+ * @param topicLen Length of the topic.
+ * @param request JSON request, not null-terminated.
+ * @param requestLen Length of the request.
+ * @param message Reason reported to the client.
+ */
+void codec_refuseRequest(const char* topic, uint16_t topicLen, const char* request, uint16_t requestLen, const char* message) {
+    char status[64];
+    int statusLen = snprintf(status, sizeof(status), "\"st\":false,\"mg\":\"%s\"}", message);
+
+    // Replace the closing brace of the request object with the status, or answer the status alone
+    uint16_t length = requestLen;
+    while (length > 0 && request[length - 1] != '}')
+        length--;
+
+    char* response = malloc(length + statusLen + 1);
+    if (!response) {
+        ESP_LOGE(TAG, "Not enough memory to refuse the request");
+        return;
+    }
+
+    uint16_t responseLen = 0;
+    if (length > 1) {
+        memcpy(response, request, length - 1);
+        responseLen = length - 1;
+        while (responseLen > 0 && (response[responseLen - 1] == ' ' || response[responseLen - 1] == '\t'
+               || response[responseLen - 1] == '\r' || response[responseLen - 1] == '\n'))
+            responseLen--;
+        if (responseLen > 0 && response[responseLen - 1] != '{')
+            response[responseLen++] = ',';
+    }
+    else {
+        response[responseLen++] = '{';
+    }
+    memcpy(response + responseLen, status, statusLen);
+
+    codec_publishResponse(topic, topicLen, response, responseLen + statusLen);
+    free(response);
+}
+
+#endif // CONFIG_GATEWAY_EDGE_CODEC
@@ -0,0 +1,118 @@
+#include "gatewaycontrol.h"
+
+static const char* TAG = "CONTROL";
+
+/**
+ * @brief Publish the result of a control command on the job's topic.
+ * @param job Job the result belongs to.
+ * @param reply Buffer whose first two bytes are reserved for the origin tag and command.
+ * @param replyLen Length of the reply, including the two reserved bytes.
+ */
+static void control_publishReply(scheduler_job_t* job, uint8_t* reply, uint32_t replyLen) {
+    reply[0] = MBNET_ORIGIN_DEVICE;
+    reply[1] = job->frame[0];
+    mqtt_publishMessage(job->topic, job->topicLen, (char*)reply, replyLen);
+}
+
+/**
+ * @brief Check whether a topic is a control topic.
+ * @param topic Topic of the incoming message, not null-terminated.
+ * @param topicLen Length of the topic.
+ * @return True if the topic ends with the control operator.
+ */
+bool control_isControlTopic(const char* topic, uint16_t topicLen) {
+    const uint16_t suffixLen = sizeof(CONTROL_TOPIC_SUFFIX) - 1;
+    return topicLen > suffixLen && !memcmp(topic + topicLen - suffixLen, CONTROL_TOPIC_SUFFIX, suffixLen);
+}
+
+/**
+ * @brief Execute a control command and publish its result. Runs on the bus worker task.
+ * @param job Job holding the command byte and its arguments.
+ */
+void control_handleCommand(scheduler_job_t* job) {
+    if (job->frameLen < 1)
+        return;
+
+    switch ((control_command_t)job->frame[0]) {
+        case CONTROL_CMD_TRACE_DUMP: {
+            uint8_t* reply = malloc(2 + TRACE_DUMP_SIZE);
+            if (!reply) {
+                ESP_LOGE(TAG, "Not enough memory to dump the trace");
+                break;
+            }
+            uint32_t dumpLen = trace_dump(reply + 2);
+            control_publishReply(job, reply, 2 + dumpLen);
+            free(reply);
+            break;
+        }
+
+        case CONTROL_CMD_TRACE_CLEAR: {
+            uint8_t reply[2];
+            trace_clear();
+            control_publishReply(job, reply, sizeof(reply));
+            break;
+        }
+
+        case CONTROL_CMD_STATS: {
+            uint8_t reply[2 + sizeof(control_stats_t)];
+            control_stats_t stats = {
+                .outboxBytes = mqtt_outboxSize(),
+                .published = mqtt_publishStats.enqueued,
+                .publishDropped = mqtt_publishStats.dropped,
+            };
+            for (uint8_t c = 0; c < SCHEDULER_CLASS_COUNT; c++) {
+                stats.pending[c] = scheduler_pendingJobs(c);
+                stats.executed[c] = scheduler_stats.executed[c];
+                stats.dropped[c] = scheduler_stats.dropped[c];
+            }
+            memcpy(reply + 2, &stats, sizeof(stats));
+            control_publishReply(job, reply, sizeof(reply));
+            break;
+        }
+
+        case CONTROL_CMD_DISCOVER: {
+            uint8_t* reply = malloc(3 + MODBUS_MAX_SLAVE_ID * sizeof(discovery_result_t));
+            if (!reply) {
+                ESP_LOGE(TAG, "Not enough memory to scan the bus");
+                break;
+            }
+            uint8_t first = job->frameLen > 1 ? job->frame[1] : 1;
+            uint8_t last = job->frameLen > 2 ? job->frame[2] : MODBUS_MAX_SLAVE_ID;
+            discovery_probe_t probe = job->frameLen > 3 ? job->frame[3] : DISCOVERY_PROBE_READ;
+
+#if CONFIG_GATEWAY_BUS_LISTEN_ONLY
+            uint16_t found = 0; // Probing would transmit on a bus owned by another master
+#else
+            uint16_t found = discovery_scan(first, last, probe, (discovery_result_t*)(reply + 3));
+#endif
+            reply[2] = (uint8_t)found;
+            control_publishReply(job, reply, 3 + found * sizeof(discovery_result_t));
+            free(reply);
+
+            // Measured turnarounds changed, let the broker know
+            capability_publish();
+            break;
+        }
+
+#if CONFIG_GATEWAY_UDP_TRANSPORT
+        case CONTROL_CMD_UDP_SESSION: {
+            uint8_t reply[2];
+            if (job->frameLen < 1 + UDP_TOKEN_SIZE)
+                break;
+            // Only the broker hands out session tokens, never a command relayed for a user
+            if (job->topicLen < sizeof(CONTROL_BROKER_PREFIX) - 1
+                || memcmp(job->topic, CONTROL_BROKER_PREFIX, sizeof(CONTROL_BROKER_PREFIX) - 1)) {
+                ESP_LOGW(TAG, "UDP session token not from the broker, ignored");
+                break;
+            }
+            udp_setSession(job->frame + 1);
+            control_publishReply(job, reply, sizeof(reply));
+            break;
+        }
+#endif
+
+        default:
+            ESP_LOGW(TAG, "Unknown control command 0x%02x", job->frame[0]);
+            break;
+    }
+}
@@ -1,5 +1,13 @@
 #include "modbusserial.h"
 
+modbus_timing_t modbus_lastTiming; // Timestamps of the last transaction
+
+// Response timeout per slave address in milliseconds, 0 until seeded
+static uint16_t modbus_slaveTimeouts[MODBUS_MAX_SLAVE_ID + 1];
+
+// Turnaround time per slave address in microseconds, 0 until measured
+static uint32_t modbus_slaveTurnarounds[MODBUS_MAX_SLAVE_ID + 1];
+
 /**
  * @brief Initialize Modbus communication by setting up UART.
  */
@@ -14,8 +22,9 @@ void modbus_initialize() {
  */
 void modbus_sendRequestPacket(uint8_t* data, uint16_t length) {
     uart_flush(UART_ID); // Clear UART buffer to prevent residual data interference
+    modbus_lastTiming = (modbus_timing_t){ .requestSent_us = esp_timer_get_time() };
     uart_write_bytes(UART_ID, data, length); // Send Modbus packet over UART
-    vTaskDelay(5); // Short delay to ensure packet transmission
+    uart_wait_tx_done(UART_ID, pdMS_TO_TICKS(MODBUS_TX_TIMEOUT_MS)); // Wait for the last bit to leave the line
     uart_flush_input(UART_ID); // Clear UART input buffer after sending packet
 }
 
@@ -32,13 +41,18 @@ uint16_t modbus_readResponsePacket(uint8_t* buffer, uint16_t bufferSize, uint16_
     if (len == 0) 
         return 0; // If no data is read, return immediately
 
+    modbus_lastTiming.firstByte_us = esp_timer_get_time();
+    modbus_lastTiming.lastByte_us = modbus_lastTiming.firstByte_us;
+
     uint16_t bytesRead = 1;
     while (bytesRead < bufferSize) {
         // Read subsequent bytes with inter-symbol timeout
         len = uart_read_bytes(UART_ID, &buffer[bytesRead], 1, interSymbolTimeout_ms / portTICK_PERIOD_MS);
         
-        if (len > 0) 
+        if (len > 0) {
             bytesRead++; // Increment byte count if data is received
+            modbus_lastTiming.lastByte_us = esp_timer_get_time();
+        }
         else
             break; // Exit loop if timeout occurs (end of frame)
     }
@@ -46,6 +60,45 @@ uint16_t modbus_readResponsePacket(uint8_t* buffer, uint16_t bufferSize, uint16_
     return bytesRead; // Total bytes read
 }
 
+/**
+ * @brief Response timeout of a slave, the configured default unless seeded by a discovery scan.
+ * @param id Slave address.
+ * @return Timeout for the first response byte in milliseconds.
+ */
+uint16_t modbus_getSlaveTimeout(uint8_t id) {
+    if (id > MODBUS_MAX_SLAVE_ID || modbus_slaveTimeouts[id] == 0)
+        return CONFIG_GATEWAY_BUS_DEFAULT_TIMEOUT_MS;
+    return modbus_slaveTimeouts[id];
+}
+
+/**
+ * @brief Turnaround time of a slave measured by the last discovery scan.
+ * @param id Slave address.
+ * @return Turnaround in microseconds, 0 if the slave was never measured.
+ */
+uint32_t modbus_getSlaveTurnaround(uint8_t id) {
+    return id <= MODBUS_MAX_SLAVE_ID ? modbus_slaveTurnarounds[id] : 0;
+}
+
+/**
+ * @brief Seed the response timeout of a slave from a measured turnaround time.
+ * @param id Slave address.
+ * @param turnaround_us Time between the end of the request and the first response byte.
+ */
+void modbus_seedSlaveTimeout(uint8_t id, uint32_t turnaround_us) {
+    if (id == 0 || id > MODBUS_MAX_SLAVE_ID)
+        return;
+
+    uint32_t timeout_ms = (turnaround_us * MODBUS_TIMEOUT_RTT_FACTOR + 999) / 1000;
+    if (timeout_ms < MODBUS_MIN_TIMEOUT_MS)
+        timeout_ms = MODBUS_MIN_TIMEOUT_MS;
+    if (timeout_ms > CONFIG_GATEWAY_BUS_DEFAULT_TIMEOUT_MS)
+        timeout_ms = CONFIG_GATEWAY_BUS_DEFAULT_TIMEOUT_MS;
+
+    modbus_slaveTimeouts[id] = (uint16_t)timeout_ms;
+    modbus_slaveTurnarounds[id] = turnaround_us > 0 ? turnaround_us : 1; // Non-zero marks the slave as measured
+}
+
 /**
  * @brief Evaluate CRC for Modbus packet data.
  * @param data Pointer to data buffer.
@@ -105,3 +158,17 @@ uint16_t modbus_calculateIntersymbolTimeout(const uart_config_t* config) {
     timeout_ms = (uint16_t)((double)1500.0 * (data_bits + parity_bits + stop_bits) / config->baud_rate);
     return (timeout_ms == 0) ? 1 : timeout_ms; // Ensure timeout is non-zero
 }
+
+/**
+ * @brief Calculate the transmission time of a single character based on UART configuration.
+ * @param config UART configuration struct.
+ * @return Character time in microseconds.
+ */
+uint32_t modbus_calculateCharacterTime(const uart_config_t* config) {
+    uint8_t start_bits = 1, data_bits = 8, parity_bits = 0, stop_bits = 1;
+
+    if (config->parity != UART_PARITY_DISABLE) parity_bits = 1;
+    if (config->stop_bits == UART_STOP_BITS_2) stop_bits = 2;
+
+    return (uint32_t)(1000000ULL * (start_bits + data_bits + parity_bits + stop_bits) / config->baud_rate);
+}
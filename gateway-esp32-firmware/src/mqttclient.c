@@ -7,11 +7,13 @@ static const char *TAG = "MQTT";
 esp_mqtt_client_handle_t mqtt_client;
 esp_mqtt_client_config_t mqtt_configure = {
     .broker.address.uri = CONFIG_MQTT_BROKER_URI,
-    .broker.address.port = 1883,
+    .broker.address.port = CONFIG_MQTT_BROKER_PORT,
     .credentials.username = CONFIG_MQTT_DEVICE_NAME,
-    .credentials.authentication.password = CONFIG_MQTT_PASSWORD
+    .credentials.authentication.password = CONFIG_MQTT_PASSWORD,
+    .outbox.limit = CONFIG_MQTT_PUBLISH_OUTBOX_LIMIT
 };
-char mqtt_topic[sizeof(CONFIG_MQTT_DEVICE_NAME) + 8];  // Holds the device topic for subscriptions
+mqtt_publishStats_t mqtt_publishStats;
+char mqtt_topic[sizeof(CONFIG_MQTT_DEVICE_NAME) + 16];  // Holds the device topic for subscriptions
 
 /**
  * @brief Event handler for MQTT events such as connection, disconnection, and message reception.
@@ -30,6 +32,18 @@ void mqtt_controlEventsHandler(void *handlerArgs, esp_event_base_t base, int32_t
             snprintf(mqtt_topic, sizeof(mqtt_topic), "+/%s/mbnet", CONFIG_MQTT_DEVICE_NAME);
             ESP_LOGI(TAG, "Subscribing to topic: %s", mqtt_topic);
             esp_mqtt_client_subscribe(event->client, mqtt_topic, 2);  // QoS level 2
+
+            // Subscribe to the control topic used for diagnostics
+            snprintf(mqtt_topic, sizeof(mqtt_topic), "+/%s/control", CONFIG_MQTT_DEVICE_NAME);
+            ESP_LOGI(TAG, "Subscribing to topic: %s", mqtt_topic);
+            esp_mqtt_client_subscribe(event->client, mqtt_topic, 2);  // QoS level 2
+
+#if CONFIG_GATEWAY_EDGE_CODEC
+            // Subscribe to the requests the broker hands over, once it has the capability record
+            snprintf(mqtt_topic, sizeof(mqtt_topic), "+/%s/edge", CONFIG_MQTT_DEVICE_NAME);
+            ESP_LOGI(TAG, "Subscribing to topic: %s", mqtt_topic);
+            esp_mqtt_client_subscribe(event->client, mqtt_topic, 2);  // QoS level 2
+#endif
             break;
 
         case MQTT_EVENT_DISCONNECTED:
@@ -74,6 +88,13 @@ void mqtt_controlEventsHandler(void *handlerArgs, esp_event_base_t base, int32_t
  * @brief Start the MQTT client and initialize it with the configured broker settings.
  */
 void mqtt_clientStart() {
+#if CONFIG_MQTT_TLS
+    mqtt_configure.network.transport = tls_transportInit();
+#endif
+
+    // Devices powered up together spread their reconnections instead of hitting the broker at once
+    mqtt_configure.network.reconnect_timeout_ms = CONFIG_MQTT_RECONNECT_TIMEOUT_MS + esp_random() % (CONFIG_MQTT_RECONNECT_JITTER_MS + 1);
+
     mqtt_client = esp_mqtt_client_init(&mqtt_configure);
 
     // Register handler for all required MQTT events
@@ -89,7 +110,8 @@ void mqtt_clientStart() {
 }
 
 /**
- * @brief Publish a message to a specified MQTT topic.
+ * @brief Queue a message for publishing to a specified MQTT topic. The message is copied into the
+ *        outbox and sent by the MQTT task, so the caller never waits on the network.
  * @param topic Topic name.
  * @param topicLen Length of the topic string.
  * @param payload Message payload.
@@ -101,8 +123,37 @@ void mqtt_publishMessage(char* topic, uint16_t topicLen, char* payload, uint16_t
     memcpy(topicStr, topic, topicLen);
     topicStr[topicLen] = '\0';
 
-    // Publish the payload to the specified topic with QoS level 2, non-retained
-    esp_mqtt_client_publish(mqtt_client, topicStr, (const char*)payload, payloadLen, 2, false);
+    // Queue the payload to the specified topic with QoS level 2, non-retained
+    if (esp_mqtt_client_enqueue(mqtt_client, topicStr, (const char*)payload, payloadLen, 2, false, true) < 0) {
+        mqtt_publishStats.dropped++;
+        ESP_LOGW(TAG, "Outbox full, dropping message to %s", topicStr);
+        return;
+    }
+    mqtt_publishStats.enqueued++;
+}
+
+/**
+ * @brief Queue a retained message, kept by the broker for clients subscribing later.
+ * @param topic Null-terminated MQTT topic.
+ * @param payload Message payload.
+ * @param payloadLen Length of the payload.
+ */
+void mqtt_publishRetained(const char* topic, const char* payload, uint32_t payloadLen) {
+    if (esp_mqtt_client_enqueue(mqtt_client, topic, payload, payloadLen, 2, true, true) < 0) {
+        mqtt_publishStats.dropped++;
+        ESP_LOGW(TAG, "Outbox full, dropping message to %s", topic);
+        return;
+    }
+    mqtt_publishStats.enqueued++;
+}
+
+/**
+ * @brief Number of bytes waiting in the MQTT outbox.
+ * @return Outbox size in bytes.
+ */
+uint32_t mqtt_outboxSize() {
+    int size = esp_mqtt_client_get_outbox_size(mqtt_client);
+    return size > 0 ? (uint32_t)size : 0;
 }
 
 /**
@@ -113,6 +164,14 @@ void mqtt_setDataEventHandler(esp_event_handler_t handler) {
     esp_mqtt_client_register_event(mqtt_client, MQTT_EVENT_DATA, handler, NULL);
 }
 
+/**
+ * @brief Set a handler called every time the client connects to the broker.
+ * @param handler Handler function pointer to manage connection events.
+ */
+void mqtt_setConnectedEventHandler(esp_event_handler_t handler) {
+    esp_mqtt_client_register_event(mqtt_client, MQTT_EVENT_CONNECTED, handler, NULL);
+}
+
 /**
  * @brief Log errors if the provided error code is non-zero.
  * @param message Error message to log.
@@ -0,0 +1,183 @@
+#include "tlstransport.h"
+
+#if CONFIG_MQTT_TLS
+
+static const char* TAG = "TLS";
+
+static esp_tls_t* tls_connection = NULL;                // Current connection, NULL when closed
+static esp_tls_client_session_t* tls_session = NULL;    // Session offered on the next connection
+
+#if CONFIG_MQTT_TLS_CUSTOM_CA
+// Broker CA embedded from main/certs/broker_ca.pem
+extern const char tls_brokerCaStart[] asm("_binary_broker_ca_pem_start");
+extern const char tls_brokerCaEnd[] asm("_binary_broker_ca_pem_end");
+#endif
+
+/**
+ * @brief Keep the session of the current connection to be resumed by the next one.
+ */
+static void tls_storeSession() {
+    esp_tls_client_session_t* session = esp_tls_get_client_session(tls_connection);
+    if (!session)
+        return;
+
+    if (tls_session)
+        esp_tls_free_client_session(tls_session);
+    tls_session = session;
+}
+
+/**
+ * @brief Forget the stored session, so the next connection performs a full handshake.
+ */
+static void tls_dropSession() {
+    if (tls_session)
+        esp_tls_free_client_session(tls_session);
+    tls_session = NULL;
+}
+
+/**
+ * @brief Wait until the connection socket is readable or writable.
+ * @param timeout_ms Time to wait, negative to wait forever.
+ * @param write True to wait for writability, false for readability.
+ * @return Positive if ready, 0 on timeout, negative on error.
+ */
+static int tls_pollSocket(int timeout_ms, bool write) {
+    int socket;
+    if (!tls_connection || esp_tls_get_conn_sockfd(tls_connection, &socket) != ESP_OK)
+        return -1;
+
+    fd_set ready, errors;
+    FD_ZERO(&ready);
+    FD_ZERO(&errors);
+    FD_SET(socket, &ready);
+    FD_SET(socket, &errors);
+
+    struct timeval timeout = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    int ret = select(socket + 1, write ? NULL : &ready, write ? &ready : NULL, &errors, timeout_ms < 0 ? NULL : &timeout);
+
+    if (ret > 0 && FD_ISSET(socket, &errors))
+        return -1;
+    return ret;
+}
+
+/**
+ * @brief Transport poll for incoming data.
+ */
+static int tls_pollRead(esp_transport_handle_t transport, int timeout_ms) {
+    // Records already decrypted by mbedTLS do not show on the socket
+    if (tls_connection && esp_tls_get_bytes_avail(tls_connection) > 0)
+        return 1;
+    return tls_pollSocket(timeout_ms, false);
+}
+
+/**
+ * @brief Transport poll for room to send data.
+ */
+static int tls_pollWrite(esp_transport_handle_t transport, int timeout_ms) {
+    return tls_pollSocket(timeout_ms, true);
+}
+
+/**
+ * @brief Open a TLS connection, offering the session of the previous connection if any.
+ */
+static int tls_connect(esp_transport_handle_t transport, const char* host, int port, int timeout_ms) {
+    tls_connection = esp_tls_init();
+    if (!tls_connection)
+        return -1;
+
+    esp_tls_cfg_t config = {
+        .timeout_ms = timeout_ms,
+        .client_session = tls_session,
+#if CONFIG_MQTT_TLS_CUSTOM_CA
+        .cacert_buf = (const unsigned char*)tls_brokerCaStart,
+        .cacert_bytes = tls_brokerCaEnd - tls_brokerCaStart,
+#else
+        .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
+    };
+
+    bool resuming = tls_session != NULL;
+    int64_t start_us = esp_timer_get_time();
+
+    if (esp_tls_conn_new_sync(host, strlen(host), port, &config, tls_connection) != 1) {
+        ESP_LOGE(TAG, "Connection to %s:%d failed", host, port);
+        esp_tls_conn_destroy(tls_connection);
+        tls_connection = NULL;
+        tls_dropSession();
+        return -1;
+    }
+
+    ESP_LOGI(TAG, "Connected to %s:%d in %" PRIu32 " ms%s", host, port,
+             (uint32_t)((esp_timer_get_time() - start_us) / 1000), resuming ? ", session offered" : "");
+    tls_storeSession();
+    return 0;
+}
+
+/**
+ * @brief Transport read, waiting at most timeout_ms for data.
+ */
+static int tls_read(esp_transport_handle_t transport, char* buffer, int len, int timeout_ms) {
+    int poll = tls_pollRead(transport, timeout_ms);
+    if (poll <= 0)
+        return poll < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+
+    ssize_t ret = esp_tls_conn_read(tls_connection, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE)
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT; // Only a handshake record, such as a new ticket
+    if (ret == 0)
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : (int)ret;
+}
+
+/**
+ * @brief Transport write, waiting at most timeout_ms for room to send.
+ */
+static int tls_write(esp_transport_handle_t transport, const char* buffer, int len, int timeout_ms) {
+    int poll = tls_pollWrite(transport, timeout_ms);
+    if (poll <= 0)
+        return poll < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+
+    ssize_t ret = esp_tls_conn_write(tls_connection, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE)
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : (int)ret;
+}
+
+/**
+ * @brief Close the connection, keeping its session for the next one.
+ */
+static int tls_close(esp_transport_handle_t transport) {
+    if (!tls_connection)
+        return 0;
+
+    // Tickets may have been issued after the handshake, keep the latest one
+    tls_storeSession();
+    esp_tls_conn_destroy(tls_connection);
+    tls_connection = NULL;
+    return 0;
+}
+
+/**
+ * @brief Release the connection and the stored session when the MQTT client is destroyed.
+ */
+static int tls_destroy(esp_transport_handle_t transport) {
+    tls_close(transport);
+    tls_dropSession();
+    return 0;
+}
+
+/**
+ * @brief Create the TLS transport to be handed to the MQTT client configuration.
+ * @return Transport handle, owned and destroyed by the MQTT client.
+ */
+esp_transport_handle_t tls_transportInit() {
+    esp_transport_handle_t transport = esp_transport_init();
+    if (!transport)
+        return NULL;
+
+    esp_transport_set_func(transport, tls_connect, tls_read, tls_write, tls_close, tls_pollRead, tls_pollWrite, tls_destroy);
+    esp_transport_set_default_port(transport, CONFIG_MQTT_BROKER_PORT);
+    return transport;
+}
+
+#endif // CONFIG_MQTT_TLS
@@ -0,0 +1,202 @@
+#include "udptransport.h"
+
+#if CONFIG_GATEWAY_UDP_TRANSPORT
+
+static const char* TAG = "UDP";
+
+// Answer to a request, kept until UDP_CACHE_DEPTH newer ones were sent
+typedef struct {
+    uint16_t sequence;
+    uint16_t length;
+    uint8_t datagram[UDP_HEADER_SIZE + SCHEDULER_FRAME_SIZE];
+    bool used;
+} udp_cachedResponse_t;
+
+static int udp_socket = -1;
+static struct sockaddr_in udp_peer;                         // Broker the responses are sent to
+static uint8_t udp_token[UDP_TOKEN_SIZE];
+static bool udp_sessionOpen = false;
+static bool (*udp_submit)(const scheduler_job_t* job);
+
+static udp_cachedResponse_t udp_cache[UDP_CACHE_DEPTH];
+static uint8_t udp_cacheNext = 0;
+static uint16_t udp_pendingSequence;                        // Request queued and not answered yet
+static bool udp_pending = false;
+static SemaphoreHandle_t udp_lock;                          // Guards the session, cache and peer
+
+/**
+ * @brief Write the datagram header.
+ */
+static void udp_writeHeader(uint8_t* datagram, uint8_t type, uint16_t sequence, uint8_t tag) {
+    datagram[0] = UDP_VERSION;
+    datagram[1] = type;
+    memcpy(datagram + 2, udp_token, UDP_TOKEN_SIZE);
+    datagram[6] = highByte(sequence);
+    datagram[7] = lowByte(sequence);
+    datagram[8] = tag;
+}
+
+/**
+ * @brief Find the cached response to a sequence.
+ * @return Cached response, or NULL if the sequence was never answered.
+ */
+static udp_cachedResponse_t* udp_findCached(uint16_t sequence) {
+    for (uint8_t i = 0; i < UDP_CACHE_DEPTH; i++)
+        if (udp_cache[i].used && udp_cache[i].sequence == sequence)
+            return &udp_cache[i];
+    return NULL;
+}
+
+/**
+ * @brief Validate a datagram and queue its frame, or answer it from the cache.
+ * @param datagram Received datagram.
+ * @param length Length of the datagram.
+ * @param sender Address the datagram came from.
+ */
+static void udp_handleDatagram(const uint8_t* datagram, int length, const struct sockaddr_in* sender) {
+    static scheduler_job_t job;
+
+    if (length < UDP_HEADER_SIZE + 1 || length > UDP_HEADER_SIZE + SCHEDULER_FRAME_SIZE - 2)
+        return;
+    if (datagram[0] != UDP_VERSION || datagram[1] != UDP_TYPE_REQUEST)
+        return;
+
+    uint8_t tag = datagram[8];
+    if (tag == MBNET_TAG_IGNORE || mbnet_tagOrigin(tag) != MBNET_ORIGIN_BROKER)
+        return;
+
+    uint16_t sequence = (datagram[6] << 8) | datagram[7];
+
+    xSemaphoreTake(udp_lock, portMAX_DELAY);
+
+    if (!udp_sessionOpen || memcmp(datagram + 2, udp_token, UDP_TOKEN_SIZE)) {
+        xSemaphoreGive(udp_lock);
+        return;
+    }
+
+    udp_peer = *sender;
+
+    // A retransmitted request is answered again but never executed twice
+    udp_cachedResponse_t* cached = udp_findCached(sequence);
+    if (cached) {
+        sendto(udp_socket, cached->datagram, cached->length, 0, (struct sockaddr*)&udp_peer, sizeof(udp_peer));
+        xSemaphoreGive(udp_lock);
+        return;
+    }
+
+    if (udp_pending && udp_pendingSequence == sequence) {
+        xSemaphoreGive(udp_lock);
+        return;
+    }
+
+    udp_pending = true;
+    udp_pendingSequence = sequence;
+    xSemaphoreGive(udp_lock);
+
+    job.kind = SCHEDULER_JOB_MODBUS;
+    job.origin = SCHEDULER_ORIGIN_UDP;
+    job.priority = (scheduler_class_t)mbnet_tagClass(tag);
+    job.sequence = sequence;
+    job.topicLen = 0;
+    job.frameLen = length - UDP_HEADER_SIZE;
+    memcpy(job.frame, datagram + UDP_HEADER_SIZE, job.frameLen);
+
+    // Answer right away when the bus is saturated, so the broker does not wait for a timeout
+    if (!udp_submit(&job))
+        udp_sendResponse(sequence, (const uint8_t*)"Null", 4);
+}
+
+/**
+ * @brief Task receiving datagrams from the broker.
+ * @param args Unused.
+ */
+static void udp_receiveTask(void* args) {
+    static uint8_t datagram[UDP_HEADER_SIZE + SCHEDULER_FRAME_SIZE];
+    struct sockaddr_in sender;
+    socklen_t senderLen;
+
+    while (true) {
+        senderLen = sizeof(sender);
+        int length = recvfrom(udp_socket, datagram, sizeof(datagram), 0, (struct sockaddr*)&sender, &senderLen);
+        if (length < 0) {
+            ESP_LOGW(TAG, "Receive failed, errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        udp_handleDatagram(datagram, length, &sender);
+    }
+}
+
+/**
+ * @brief Open the socket and start the receiving task.
+ * @param submit Function queuing a received frame, returns false if the queue is full.
+ */
+void udp_initialize(bool (*submit)(const scheduler_job_t* job)) {
+    udp_submit = submit;
+    udp_lock = xSemaphoreCreateMutex();
+
+    udp_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (udp_socket < 0) {
+        ESP_LOGE(TAG, "Unable to create socket, errno %d", errno);
+        return;
+    }
+
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_GATEWAY_UDP_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(udp_socket, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        ESP_LOGE(TAG, "Unable to bind port %d, errno %d", CONFIG_GATEWAY_UDP_PORT, errno);
+        close(udp_socket);
+        udp_socket = -1;
+        return;
+    }
+
+    xTaskCreate(udp_receiveTask, "udpTransport", UDP_STACK_SIZE, NULL, UDP_TASK_PRIORITY, NULL);
+    ESP_LOGI(TAG, "Listening on port %d", CONFIG_GATEWAY_UDP_PORT);
+}
+
+/**
+ * @brief Accept datagrams carrying a new session token, dropping the answers cached for the old one.
+ * @param token Session token handed by the broker.
+ */
+void udp_setSession(const uint8_t token[UDP_TOKEN_SIZE]) {
+    xSemaphoreTake(udp_lock, portMAX_DELAY);
+    memcpy(udp_token, token, UDP_TOKEN_SIZE);
+    memset(udp_cache, 0, sizeof(udp_cache));
+    udp_pending = false;
+    udp_sessionOpen = true;
+    xSemaphoreGive(udp_lock);
+}
+
+/**
+ * @brief Send the response to a frame received as a datagram, and cache it for retransmissions.
+ * @param sequence Sequence number of the request.
+ * @param response Modbus response without CRC, or the "Null" error payload.
+ * @param responseLen Length of the response.
+ */
+void udp_sendResponse(uint16_t sequence, const uint8_t* response, uint16_t responseLen) {
+    if (responseLen > SCHEDULER_FRAME_SIZE)
+        responseLen = SCHEDULER_FRAME_SIZE;
+
+    xSemaphoreTake(udp_lock, portMAX_DELAY);
+
+    udp_cachedResponse_t* entry = &udp_cache[udp_cacheNext];
+    udp_cacheNext = (udp_cacheNext + 1) % UDP_CACHE_DEPTH;
+
+    udp_writeHeader(entry->datagram, UDP_TYPE_RESPONSE, sequence, MBNET_ORIGIN_DEVICE);
+    memcpy(entry->datagram + UDP_HEADER_SIZE, response, responseLen);
+    entry->length = UDP_HEADER_SIZE + responseLen;
+    entry->sequence = sequence;
+    entry->used = true;
+
+    if (udp_pending && udp_pendingSequence == sequence)
+        udp_pending = false;
+
+    sendto(udp_socket, entry->datagram, entry->length, 0, (struct sockaddr*)&udp_peer, sizeof(udp_peer));
+    xSemaphoreGive(udp_lock);
+}
+
+#endif // CONFIG_GATEWAY_UDP_TRANSPORT
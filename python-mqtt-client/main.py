@@ -60,6 +60,9 @@ def main(client):
     for msg in msgs:
         client.publish_message(msg)
 
+    # Same read as the second message, in the binary format
+    client.publish_message({'id': 7, 'fn': 'r', 'dt': 'ni', 'rg': [16, 25]}, binary=True)
+
 
 if __name__ == "__main__":
 
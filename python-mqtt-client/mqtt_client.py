@@ -1,9 +1,98 @@
 import json
+import struct
 import paho.mqtt.client as mqtt
 import logging
 import time
 from icecream import ic
 
+# Control topic framing shared with the firmware (see gatewaycontrol.h)
+ORIGIN_CLIENT = 0x00
+ORIGIN_DEVICE = 0x01
+CONTROL_TRACE_DUMP = 0x01
+CONTROL_TRACE_CLEAR = 0x02
+CONTROL_STATS = 0x03
+CONTROL_DISCOVER = 0x04
+STATS_FORMAT = '<3H3I3I3I'
+DISCOVERY_FORMAT = '<BI'
+PROBE_READ = 0
+PROBE_ECHO = 1
+
+# Binary client format shared with the broker (see binaryFormat.js): marker byte, then fields of
+# tag, LEB128 length and value. Multi-byte values are big-endian.
+BINARY_MARKER = 0xB1
+FUNCTION_CODES = {'w': 1, 'r': 2, 'd': 3, 'mb': 4, 's': 5}
+DATATYPE_CODES = {'bi': 1, 'bo': 2, 'ni': 3, 'no': 4}
+SUBFUNCTION_CODES = {
+    'rqdt': 0, 'rcop': 1, 'rdrg': 2, 'caid': 3, 'flom': 4, 'ccdr': 10, 'rbmc': 11, 'rbce': 12, 'rbee': 13,
+    'rsmc': 14, 'rsrc': 15, 'rnak': 16, 'rsbc': 17, 'rbso': 18, 'riop': 19, 'cocf': 20, 'gcms': 21,
+}
+BINARY_FIELDS = {
+    'id': (0x01, 'u8'), 'fn': (0x02, FUNCTION_CODES), 'dt': (0x03, DATATYPE_CODES),
+    'rg': (0x04, 'words'), 'ls': (0x05, 'words'), 'dv': (0x06, 'words'), 'sf': (0x07, SUBFUNCTION_CODES),
+    'pk': (0x08, 'bytes'), 'ma': (0x09, 'u32'), 'pe': (0x0A, 'u32'), 'db': (0x0B, 'f64'), 'ex': (0x0C, 'u32'),
+    'st': (0x10, 'bool'), 'fd': (0x11, 'words'), 'mg': (0x12, 'text'),
+}
+BINARY_TAGS = {tag: (keyword, encoding) for keyword, (tag, encoding) in BINARY_FIELDS.items()}
+
+# Encode a terse request in the binary format
+def encode_binary(message):
+    payload = bytearray([BINARY_MARKER])
+    for keyword, value in message.items():
+        tag, encoding = BINARY_FIELDS[keyword]
+        if isinstance(encoding, dict):
+            data = struct.pack('>H' if keyword == 'sf' else '>B', encoding[value])
+        elif encoding == 'words':
+            data = struct.pack(f'>{len(value)}H', *value)
+        elif encoding == 'bytes':
+            data = bytes(value)
+        elif encoding == 'text':
+            data = str(value).encode()
+        else:
+            data = struct.pack({'u8': '>B', 'bool': '>B', 'u32': '>I', 'f64': '>d'}[encoding], value)
+
+        payload.append(tag)
+        length = len(data)
+        while length >= 0x80:
+            payload.append((length & 0x7F) | 0x80)
+            length >>= 7
+        payload.append(length)
+        payload += data
+    return bytes(payload)
+
+# Decode a binary response or stream message to the terse format
+def decode_binary(payload):
+    message = {}
+    offset = 1
+    while offset < len(payload):
+        tag = payload[offset]
+        offset += 1
+        length, shift = 0, 0
+        while True:
+            byte = payload[offset]
+            offset += 1
+            length |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        data = payload[offset:offset + length]
+        offset += length
+
+        keyword, encoding = BINARY_TAGS[tag]
+        if isinstance(encoding, dict):
+            code = struct.unpack('>H' if keyword == 'sf' else '>B', data)[0]
+            message[keyword] = next((name for name, value in encoding.items() if value == code), code)
+        elif encoding == 'words':
+            message[keyword] = list(struct.unpack(f'>{length // 2}H', data))
+        elif encoding == 'bytes':
+            message[keyword] = list(data)
+        elif encoding == 'text':
+            message[keyword] = data.decode()
+        elif encoding == 'bool':
+            message[keyword] = data[0] != 0
+        else:
+            message[keyword] = struct.unpack({'u8': '>B', 'u32': '>I', 'f64': '>d'}[encoding], data)[0]
+    return message
+
 logging.basicConfig(level=logging.DEBUG, format='%(asctime)s - %(levelname)s - %(message)s')
 
 class MQTTClient:
@@ -17,6 +106,7 @@ class MQTTClient:
         - password: The password for authentication
         - request_topic: The topic to publish requests to
         - response_topic: The topic to subscribe for responses
+        - tls_ca (optional): CA certificate file, connects over TLS when given
         """
         self.broker = config.get('broker')
         self.port = config.get('port')
@@ -25,6 +115,11 @@ class MQTTClient:
         self.device = config.get('device')
         self.request_topic = f'{self.username}/{self.device}/request'
         self.response_topic = f'{self.username}/{self.device}/response'
+        self.stream_topic = f'{self.username}/{self.device}/stream'
+        self.control_topic = f'{self.username}/{self.device}/diagnostics'
+        self.data_topic = f'gateway/{self.device}/data'
+        self.capability_topic = f'gateway/{self.device}/capability'
+        self.trace_path = config.get('trace_path', 'trace.bin')
         self.is_connected = False  # Flag to check connection status
 
         # Initialize the MQTT client
@@ -33,6 +128,10 @@ class MQTTClient:
         # Set the username and password for authentication
         self.client.username_pw_set(self.username, self.password)
 
+        # Verify the broker against the given CA when it listens over TLS
+        if config.get('tls_ca'):
+            self.client.tls_set(ca_certs=config.get('tls_ca'))
+
         # Assign callback functions
         self.client.on_connect = self.on_connect
         self.client.on_publish = self.on_publish
@@ -47,6 +146,10 @@ class MQTTClient:
             # Subscribe to both request and response topics with QoS 2 after successful connection
             self.subscribe(self.request_topic)
             self.subscribe(self.response_topic)
+            self.subscribe(self.stream_topic)
+            self.subscribe(self.control_topic)
+            self.subscribe(self.data_topic)
+            self.subscribe(self.capability_topic)
         else:
             logging.error(f"Connection failed with code {rc}: {mqtt.error_string(rc)}")
 
@@ -69,17 +172,84 @@ class MQTTClient:
 
     # Message received callback function
     def on_message(self, client, userdata, msg):
+        if msg.topic == self.control_topic:
+            self.on_control_message(msg.payload)
+            return
+
         try:
-            # Parse the JSON message payload
-            message = json.loads(msg.payload.decode())
+            # Parse the binary or JSON message payload
+            if msg.payload[:1] == bytes([BINARY_MARKER]):
+                message = decode_binary(msg.payload)
+            else:
+                message = json.loads(msg.payload.decode())
             logging.info(f"Received message on {msg.topic}: {message}")
             if msg.topic == self.response_topic:
                 logging.info(f"Response received: ")
                 ic(message)
+            elif msg.topic == self.stream_topic:
+                logging.info(f"Stream update: ")
+                ic(message)
+            elif msg.topic == self.capability_topic:
+                logging.info(f"Device capability: ")
+                ic(message)
+            elif msg.topic == self.data_topic:
+                logging.info(f"Sniffed values: ")
+                ic(message)
                 
         except json.JSONDecodeError as e:
             logging.error(f"Failed to decode message: {e}")
 
+    # Control reply handler, stores trace dumps for trace_decoder.py
+    def on_control_message(self, payload):
+        if len(payload) < 2 or payload[0] != ORIGIN_DEVICE:
+            return
+
+        if payload[1] == CONTROL_TRACE_DUMP:
+            with open(self.trace_path, 'wb') as trace:
+                trace.write(payload[2:])
+            logging.info(f"Trace dump saved to {self.trace_path}, decode it with trace_decoder.py")
+        elif payload[1] == CONTROL_TRACE_CLEAR:
+            logging.info("Trace cleared")
+        elif payload[1] == CONTROL_STATS:
+            fields = struct.unpack(STATS_FORMAT, payload[2:2 + struct.calcsize(STATS_FORMAT)])
+            stats = {
+                'pending': fields[0:3],
+                'executed': fields[3:6],
+                'dropped': fields[6:9],
+                'outbox_bytes': fields[9],
+                'published': fields[10],
+                'publish_dropped': fields[11],
+            }
+            logging.info(f"Device stats: {stats}")
+        elif payload[1] == CONTROL_DISCOVER:
+            size = struct.calcsize(DISCOVERY_FORMAT)
+            slaves = {}
+            for index in range(payload[2]):
+                slave, rtt = struct.unpack_from(DISCOVERY_FORMAT, payload, 3 + index * size)
+                slaves[slave] = rtt
+            logging.info(f"Discovered slaves (id: rtt in us): {dict(sorted(slaves.items()))}")
+
+    # Method to send a command to the device, relayed by the broker to its control topic
+    def send_control(self, command, arguments=b''):
+        try:
+            result = self.client.publish(self.control_topic, bytes([ORIGIN_CLIENT, command]) + arguments, qos=2)
+            result.wait_for_publish()
+            logging.debug(f"Control command 0x{command:02x} sent")
+        except Exception as e:
+            logging.error(f"Error while sending control command: {e}")
+
+    # Method to request the device's bus transaction trace
+    def request_trace(self):
+        self.send_control(CONTROL_TRACE_DUMP)
+
+    # Method to request the device's scheduler and publish counters
+    def request_stats(self):
+        self.send_control(CONTROL_STATS)
+
+    # Method to scan the device's bus for responding slaves
+    def request_discovery(self, first=1, last=247, probe=PROBE_READ):
+        self.send_control(CONTROL_DISCOVER, bytes([first, last, probe]))
+
     # Method to connect to the broker
     def connect(self):
         try:
@@ -88,14 +258,14 @@ class MQTTClient:
         except Exception as e:
             logging.error(f"Error during connection: {e}")
 
-    # Method to publish a message
-    def publish_message(self, message):
+    # Method to publish a message, in the binary format if asked (terse keywords only)
+    def publish_message(self, message, binary=False):
         try:
             if self.is_connected:  # Only publish if connected and subscribed
-                message_json = json.dumps(message)
-                result = self.client.publish(self.request_topic, message_json, qos=2)  # Ensure QoS 2
+                payload = encode_binary(message) if binary else json.dumps(message)
+                result = self.client.publish(self.request_topic, payload, qos=2)  # Ensure QoS 2
                 result.wait_for_publish()  # Block until the message is published
-                logging.debug(f"Message sent: {message_json} with QoS 2")
+                logging.debug(f"Message sent: {payload} with QoS 2")
             else:
                 logging.warning("Cannot publish message: not connected or subscribed yet.")
         except Exception as e:
@@ -0,0 +1,102 @@
+import argparse
+import struct
+import sys
+
+# Layout of the dump produced by the firmware's bustrace module (little-endian)
+HEADER_FORMAT = '<4sBBHH'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+RECORD_PREFIX_FORMAT = '<IqqqBBHH'
+RECORD_PREFIX_SIZE = struct.calcsize(RECORD_PREFIX_FORMAT)
+
+OUTCOMES = ['ok', 'timeout', 'crc-error', 'exception']
+CLASSES = ['control', 'interactive', 'background', 'sniffed']
+
+# pcap link type reserved for private use, decode it as Modbus RTU in Wireshark
+PCAP_LINKTYPE_USER0 = 147
+
+
+def decode_dump(data):
+    """
+    Decode a binary trace dump into a list of transaction dictionaries, oldest first.
+    """
+    magic, version, frame_bytes, count, record_size = struct.unpack_from(HEADER_FORMAT, data, 0)
+    if magic != b'MBTR' or version != 1:
+        raise ValueError(f'Not a version 1 trace dump (magic={magic}, version={version})')
+
+    records = []
+    for index in range(count):
+        offset = HEADER_SIZE + index * record_size
+        sequence, sent, first, last, outcome, priority, tx_len, rx_len = struct.unpack_from(RECORD_PREFIX_FORMAT, data, offset)
+        frames = offset + RECORD_PREFIX_SIZE
+
+        records.append({
+            'sequence': sequence,
+            'sent_us': sent,
+            'first_byte_us': first,
+            'last_byte_us': last,
+            'outcome': OUTCOMES[outcome] if outcome < len(OUTCOMES) else f'unknown({outcome})',
+            'priority': CLASSES[priority] if priority < len(CLASSES) else f'unknown({priority})',
+            'tx_len': tx_len,
+            'rx_len': rx_len,
+            'tx': data[frames:frames + min(tx_len, frame_bytes)],
+            'rx': data[frames + frame_bytes:frames + frame_bytes + min(rx_len, frame_bytes)],
+        })
+
+    return records
+
+
+def print_timeline(records, out=sys.stdout):
+    """
+    Print one line per transaction with times relative to the oldest request.
+    """
+    if not records:
+        out.write('Trace is empty\n')
+        return
+
+    origin = records[0]['sent_us']
+    for record in records:
+        turnaround = record['first_byte_us'] - record['sent_us'] if record['first_byte_us'] else None
+        reception = record['last_byte_us'] - record['first_byte_us'] if record['first_byte_us'] else None
+        tx_cut = '...' if record['tx_len'] > len(record['tx']) else ''
+        rx_cut = '...' if record['rx_len'] > len(record['rx']) else ''
+
+        out.write(
+            f"#{record['sequence']:<6} +{(record['sent_us'] - origin) / 1000:10.3f} ms "
+            f"{record['priority']:<11} {record['outcome']:<9} "
+            f"turnaround={'-' if turnaround is None else f'{turnaround} us':<10} "
+            f"rx={'-' if reception is None else f'{reception} us':<10}\n"
+            f"    TX[{record['tx_len']:3}] {record['tx'].hex(' ')}{tx_cut}\n"
+            f"    RX[{record['rx_len']:3}] {record['rx'].hex(' ')}{rx_cut}\n"
+        )
+
+
+def write_pcap(records, path):
+    """
+    Write requests and responses as separate packets of a pcap file, timestamped with the
+    request send time and the response first byte time respectively.
+    """
+    with open(path, 'wb') as pcap:
+        pcap.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, PCAP_LINKTYPE_USER0))
+
+        for record in records:
+            packets = [(record['sent_us'], record['tx'], record['tx_len'])]
+            if record['first_byte_us']:
+                packets.append((record['first_byte_us'], record['rx'], record['rx_len']))
+
+            for timestamp, frame, length in packets:
+                pcap.write(struct.pack('<IIII', timestamp // 1000000, timestamp % 1000000, len(frame), length))
+                pcap.write(frame)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Decode a gateway bus transaction trace dump')
+    parser.add_argument('dump', help='binary dump received on the control topic')
+    parser.add_argument('--pcap', help='also write the transactions to this pcap file')
+    args = parser.parse_args()
+
+    with open(args.dump, 'rb') as dump:
+        records = decode_dump(dump.read())
+
+    print_timeline(records)
+    if args.pcap:
+        write_pcap(records, args.pcap)